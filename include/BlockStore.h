@@ -0,0 +1,97 @@
+#ifndef BLOCKSTORE_H
+#define BLOCKSTORE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Optional content-addressed store for encoded extent payloads. Identical
+// payloads are kept once, keyed by their SHA-256 digest, and shared by every
+// extent that references them. Reference counting rides on shared_ptr: when
+// the last reference to a block goes away the block is freed and dropped
+// from the index. Interning and garbage collection share a mutex, so
+// blocks may be added and released from several threads.
+//
+// The store also decides what content costs its volume: every distinct
+// payload buffer the volume's files reference is charged once, on its
+// first reference, and the charge goes away with the last one. Interned
+// blocks and the buffers copies share are thereby only paid for once. The
+// charge table is sharded by buffer address, so writers of different
+// files rarely meet on a lock.
+class BlockStore {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    struct Stats {
+        size_t blocks = 0;
+        size_t uniqueBytes = 0;
+        size_t lookups = 0;
+        size_t hits = 0;
+        size_t chargedBytes = 0; // Bytes of the distinct buffers referenced
+    };
+
+    BlockStore();
+
+    BlockStore(const BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool enable) { enabled = enable; }
+
+    // Returns the stored block with this payload, adding it if it is new
+    std::shared_ptr<const std::string> intern(std::string payload);
+
+    Stats getStats() const;
+
+    // A file started or stopped referencing payload; each returns the bytes
+    // this changes the volume's charge by, the payload's size for its first
+    // reference or last release and 0 otherwise
+    size_t reference(const std::string* payload);
+    size_t release(const std::string* payload);
+
+    // Content-defined chunking: returns chunk lengths for data, with cut
+    // points picked by a gear hash so an edit only moves nearby boundaries
+    static std::vector<size_t> chunkLengths(std::string_view data, size_t maxChunk);
+
+    static Digest sha256(std::string_view data);
+
+private:
+    static constexpr size_t kMinChunk = 2 * 1024;
+    static constexpr uint64_t kBoundaryMask = (1u << 13) - 1; // ~8 KiB average
+
+    struct DigestHash {
+        size_t operator()(const Digest& digest) const;
+    };
+
+    struct Index {
+        std::unordered_map<Digest, std::weak_ptr<const std::string>, DigestHash> blocks;
+        size_t uniqueBytes = 0;
+        size_t lookups = 0;
+        size_t hits = 0;
+        std::mutex mutex;
+    };
+
+    static constexpr size_t kChargeShards = 16;
+
+    struct alignas(64) ChargeShard {
+        std::unordered_map<const std::string*, size_t> references;
+        std::mutex mutex;
+    };
+
+    // Block deleters hold a weak reference, so blocks may outlive the store
+    std::shared_ptr<Index> index;
+    std::array<ChargeShard, kChargeShards> charges;
+    std::atomic<size_t> chargedBytes;
+    bool enabled;
+
+    ChargeShard& shardOf(const std::string* payload);
+};
+
+#endif // BLOCKSTORE_H
@@ -0,0 +1,81 @@
+#ifndef CHILDINDEX_H
+#define CHILDINDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "NameTable.h"
+
+class FileNode;
+
+// Open-addressing hash index over a directory's children that readers can
+// probe and walk without the directory's lock. Entries are appended in
+// creation order and never move or get reused, and a removed child leaves
+// its entry behind with a null node, so a concurrent reader never sees a
+// half-written slot and a walk neither skips nor repeats a child that stays
+// put. An index has a fixed capacity: when it is full, or mostly removed
+// entries, the directory builds a compacted copy, publishes it and retires
+// the old one through Epoch.
+//
+// Slots hold the entry number of a child with its cached name hash, so
+// lookups only touch the name string when the hashes already match. Each
+// entry also records the child's position in the directory's children
+// vector, which only writers use.
+//
+// Small directories, the large majority, get no slots at all: up to
+// kFlatLimit entries are scanned comparing cached hashes, which costs
+// about as much as probing and saves the slot array. The entry array is
+// the flat list rather than the children vector, since readers without
+// the lock can't follow the vector while it grows.
+class ChildIndex {
+public:
+    using Children = std::vector<std::unique_ptr<FileNode>>;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t kMinCapacity = 2;
+    static constexpr size_t kFlatLimit = 16;
+
+    explicit ChildIndex(size_t capacity);
+    // The children of other, in its order, taken from children by their
+    // recorded positions so relocated nodes are picked up
+    ChildIndex(const ChildIndex& other, const Children& children, size_t capacity);
+
+    // Readers; any thread, inside an Epoch::Guard or holding the directory
+    FileNode* find(std::string_view name, size_t hash, const NameTable& names) const;
+    size_t end() const { return used.load(std::memory_order_acquire); }
+    FileNode* child(size_t entry) const { return entries[entry].node.load(std::memory_order_acquire); }
+    NameTable::NameId name(size_t entry) const { return entries[entry].name; }
+    size_t hash(size_t entry) const { return entries[entry].hash; }
+
+    // Writers, holding the directory's lock exclusively
+    bool insert(FileNode* child, NameTable::NameId name, size_t hash, size_t position); // False when full
+    size_t erase(const FileNode* child, size_t hash); // Returns the child's position
+    void relocate(const FileNode* child, size_t hash, size_t position);
+    size_t size() const { return live; }
+    size_t capacity() const { return entryCapacity; }
+    bool isHashed() const { return slots != nullptr; }
+
+private:
+    struct Entry {
+        std::atomic<FileNode*> node; // Null once the child is removed
+        size_t hash;
+        NameTable::NameId name;
+        uint32_t position;
+    };
+
+    static constexpr uint32_t kEmpty = 0; // Slots hold entry number + 1
+
+    std::unique_ptr<Entry[]> entries;
+    std::unique_ptr<std::atomic<uint32_t>[]> slots; // Null up to kFlatLimit entries
+    size_t entryCapacity;
+    size_t slotMask;
+    std::atomic<size_t> used;
+    size_t live;
+
+    size_t locate(const FileNode* child, size_t hash) const; // Entry number, or npos
+};
+
+#endif // CHILDINDEX_H
@@ -21,6 +21,10 @@ public:
     std::string compress(const std::string& input) const override;
     std::string decompress(const std::string& input) const override;
     std::string getName() const override { return "RLE"; }
+    
+private:
+    static constexpr char kStored = 0; // Header of input kept as is
+    static constexpr char kRuns = 1;   // Header of (count, byte) pairs
 };
 
 // Huffman compression algorithm
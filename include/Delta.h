@@ -0,0 +1,28 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary delta between two byte strings. A delta is a sequence of copy
+// operations (ranges of the base) and literal inserts, serialized into a
+// compact string so it can be stored like any other payload.
+class DeltaCodec {
+public:
+    // Builds a delta that turns base into target
+    static std::string encode(const std::string& base, const std::string& target);
+
+    // Reconstructs the target from the base and a delta made by encode()
+    static std::string apply(const std::string& base, const std::string& delta);
+
+private:
+    static constexpr size_t kBlockSize = 32;
+
+    static void writeCopy(std::string& out, size_t offset, size_t length);
+    static void writeInsert(std::string& out, const char* data, size_t length);
+    static void writeVarint(std::string& out, uint64_t value);
+    static uint64_t readVarint(const std::string& in, size_t& pos);
+};
+
+#endif // DELTA_H
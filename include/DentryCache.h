@@ -0,0 +1,72 @@
+#ifndef DENTRYCACHE_H
+#define DENTRYCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class FileNode;
+
+// Bounded LRU cache of directory entries: (parent, name) -> child, where a
+// null child records that the name was looked up and not found. The cache
+// only holds raw pointers, so the owning file system has to invalidate
+// entries whenever it links, unlinks or relocates nodes.
+class DentryCache {
+public:
+    static constexpr size_t kDefaultCapacity = 4096;
+
+    struct Stats {
+        size_t entries = 0;
+        size_t capacity = 0;
+        size_t hits = 0;
+        size_t negativeHits = 0; // Hits on cached misses, included in hits
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t invalidations = 0;
+    };
+
+    explicit DentryCache(size_t capacity = kDefaultCapacity);
+
+    // True on a hit, with node set to the cached child (nullptr if absent)
+    bool lookup(const FileNode* parent, std::string_view name, size_t hash, FileNode*& node);
+    void insert(const FileNode* parent, std::string_view name, size_t hash, FileNode* node);
+
+    void invalidate(const FileNode* parent, std::string_view name, size_t hash);
+    void invalidateChildren(const FileNode* parent);
+    void clear();
+
+    void setCapacity(size_t capacity);
+    Stats getStats() const;
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Entry {
+        const FileNode* parent;
+        size_t hash;
+        std::string name;
+        FileNode* node;
+        uint32_t prev; // LRU links, most recently used at head
+        uint32_t next;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    uint32_t head;
+    uint32_t tail;
+    std::unordered_multimap<size_t, uint32_t> byKey;
+    std::unordered_multimap<const FileNode*, uint32_t> byParent;
+    size_t capacity;
+    Stats stats;
+
+    static size_t keyOf(const FileNode* parent, size_t hash);
+    uint32_t find(const FileNode* parent, std::string_view name, size_t hash) const;
+    void link(uint32_t slot);
+    void unlink(uint32_t slot);
+    void erase(uint32_t slot);
+};
+
+#endif // DENTRYCACHE_H
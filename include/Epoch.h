@@ -0,0 +1,46 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <functional>
+
+// Epoch-based reclamation for data that readers use without taking a lock.
+// A reader brackets its accesses with a Guard; a writer that unlinks
+// something such a reader may still be looking at hands it to retire()
+// instead of freeing it, and it is freed once every guard that was open at
+// that point has been left.
+//
+// Guards and retired data belong to a domain, an address picked by the
+// caller; a volume uses its node arena, so one volume's writers never wait
+// for another volume's readers. A reader must only reach data of the
+// domains it holds guards for. Guards nest, also across domains.
+//
+// Entering and leaving a guard only writes to a slot owned by the calling
+// thread, and retired data collects in that slot too, so readers and
+// writers on different cores do not share any written cache line. The
+// shared epoch only moves once per batch of retirements. A thread must not
+// wait for a lock while inside a guard if the holder of that lock may be
+// waiting in synchronize() for the same domain.
+class Epoch {
+public:
+    using Domain = const void*;
+
+    class Guard {
+    public:
+        explicit Guard(Domain domain);
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // Runs reclaim once no guard that is open now is still open; retired
+    // data is collected in batches, so possibly a while after that
+    static void retire(Domain domain, std::function<void()> reclaim);
+
+    // Waits until every guard of domain that is open now has been left,
+    // then runs everything retired in domain so far. Not to be called
+    // inside a guard of domain
+    static void synchronize(Domain domain);
+};
+
+#endif // EPOCH_H
@@ -0,0 +1,79 @@
+#ifndef EXTENTLIST_H
+#define EXTENTLIST_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A file's extents, in order, stored in chunks of kChunkExtents that copies
+// of the list share. Copying a list copies one pointer per chunk, and
+// changing it copies only the chunk the change lands in, so a file's
+// content snapshots share everything a write leaves alone: a write to a
+// large file costs time in its chunk count, not its extent count, and two
+// snapshots can be compared chunk by chunk. Chunks are never modified once
+// shared, which makes a list safe to read from any thread while a copy of
+// it is being edited.
+class ExtentList {
+public:
+    // Payloads are immutable and may be shared between files; a write
+    // replaces an extent's buffer instead of modifying it
+    struct Extent {
+        std::shared_ptr<const std::string> payload;
+        size_t offset; // Logical position of the extent's first byte
+        size_t length;
+    };
+
+    // 8 MiB of content at the largest extent size
+    static constexpr size_t kChunkExtents = 128;
+
+    class const_iterator {
+    public:
+        const_iterator(const ExtentList* list, size_t index) : list(list), index(index) {}
+
+        const Extent& operator*() const { return (*list)[index]; }
+        const Extent* operator->() const { return &(*list)[index]; }
+        const_iterator& operator++() { ++index; return *this; }
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const ExtentList* list;
+        size_t index;
+    };
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const Extent& operator[](size_t index) const { return (*chunks[index / kChunkExtents])[index % kChunkExtents]; }
+    const Extent& front() const { return (*this)[0]; }
+    const Extent& back() const { return (*this)[count - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+    void set(size_t index, Extent extent);
+    void push_back(Extent extent);
+    void truncate(size_t newCount); // Keeps the first newCount extents
+    void clear();
+
+    // Index of the last extent starting at or before position; the list
+    // must not be empty and its first extent must start at 0
+    size_t find(size_t position) const;
+
+    // Calls visit with every index below the longer list's size whose
+    // extent may differ between the two lists, skipping the chunks they
+    // share
+    static void forEachDifference(const ExtentList& a, const ExtentList& b, const std::function<void(size_t)>& visit);
+
+private:
+    using Chunk = std::vector<Extent>;
+
+    std::vector<std::shared_ptr<Chunk>> chunks;
+    size_t count = 0;
+
+    Chunk& writable(size_t chunk); // Copies the chunk first if another list shares it
+};
+
+#endif // EXTENTLIST_H
@@ -0,0 +1,67 @@
+#ifndef FILEHANDLE_H
+#define FILEHANDLE_H
+
+#include <cstddef>
+#include <string>
+
+class FileNode;
+class VirtualFileSystem;
+
+// An open file, pinned to its node and the volume that owns it, so I/O
+// through the handle never resolves paths again and keeps working when the
+// file or one of its parents is renamed or moved. Handles are created by
+// VirtualFileSystem::open(); if the file is removed, or its volume goes
+// away, the handle is closed and further calls fail. Each call locks the
+// file's node, shared for reads and exclusively for writes, so handles on
+// different files don't contend; a handle itself is meant for one thread
+// at a time.
+class FileHandle {
+public:
+    // Open flags, combined with |
+    static constexpr unsigned Read = 1;
+    static constexpr unsigned Write = 2;
+    static constexpr unsigned Create = 4;   // Create the file if it is missing
+    static constexpr unsigned Truncate = 8; // Empty the file on open
+    static constexpr unsigned Append = 16;  // Every write goes to the end
+
+    // Seek origins
+    static constexpr int SeekSet = 0;
+    static constexpr int SeekCur = 1;
+    static constexpr int SeekEnd = 2;
+
+    ~FileHandle();
+
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+
+    bool isOpen() const;
+    void close();
+
+    // Sequential I/O at the current position, which advances by the
+    // number of bytes transferred
+    size_t read(char* buffer, size_t count);
+    size_t write(const char* data, size_t count);
+    size_t write(const std::string& data);
+
+    // Positional I/O; the current position is left alone
+    size_t pread(char* buffer, size_t count, size_t offset) const;
+    size_t pwrite(const char* data, size_t count, size_t offset);
+
+    // Returns false, leaving the position unchanged, if it would go negative
+    bool seek(long long offset, int whence = SeekSet);
+    size_t tell() const;
+    size_t size() const;
+
+private:
+    friend class VirtualFileSystem;
+
+    FileHandle(FileNode* node, VirtualFileSystem* volume, unsigned flags);
+    size_t writeAt(FileNode* target, const char* data, size_t count, size_t offset); // With target locked
+
+    FileNode* node; // Guarded by the volume's handlesLock
+    VirtualFileSystem* volume;
+    unsigned flags;
+    size_t position;
+};
+
+#endif // FILEHANDLE_H
@@ -1,7 +1,10 @@
 #ifndef FILENODE_H
 #define FILENODE_H
 
+#include <atomic>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <iostream>
@@ -9,30 +12,114 @@
 #include <ctime>
 #include <algorithm>
 #include <stdexcept>
+#include <unordered_set>
 #include "Compression.h"
 #include "Encryption.h"
+#include "ChildIndex.h"
+#include "ExtentList.h"
+#include "NameTable.h"
+#include "NodeLock.h"
 
 class FileNodeVersion;
+class NodeArena;
+class NodePath;
+class ContentView;
 
 class FileNode {
 public:
-    FileNode(const std::string& name, bool isDirectory, FileNode* parent = nullptr);
+    // Rolled-up totals for the subtree rooted at a node, the node included
+    struct Totals {
+        size_t logicalBytes = 0;
+        size_t storedBytes = 0;
+        size_t files = 0;
+        size_t directories = 0;
+    };
+
+    // A node belongs to the arena it is constructed with: its name is
+    // interned there, its used space is accounted there and the snapshots
+    // it retires use the arena as their Epoch domain. Copies take the
+    // arena of the node they are copied into, so copying between volumes
+    // is explicit; a move keeps the arena of the node it moves from
+    FileNode(NodeArena& arena, const std::string& name, bool isDirectory, FileNode* parent = nullptr);
     ~FileNode();
-    FileNode(const FileNode& other);
+    FileNode(NodeArena& arena, const FileNode& other);
+    FileNode(NodeArena& arena, const FileNode& other, const std::string& name); // Copy under another name
+    FileNode(const FileNode&) = delete;
+    FileNode(FileNode&& other) noexcept;
+
+    // Heap nodes live in the slabs of a NodeArena, normally the one they
+    // are constructed with; plain new uses the shared arena
+    static void* operator new(size_t size);
+    static void* operator new(size_t size, NodeArena& arena);
+    static void operator delete(void* ptr);
+    static void operator delete(void* ptr, NodeArena& arena);
 
-    std::string getName() const;
+    const std::string& getName() const;
+    size_t getNameHash() const;
     bool isDirectory() const;
     FileNode* getParent() const;
+    // Owned children, in no particular order; for writers and walks that
+    // hold the directory's lock
     std::vector<std::unique_ptr<FileNode>>& getChildren();
+    const std::vector<std::unique_ptr<FileNode>>& getChildren() const;
+    // Calls visit with every child, its name and its name hash, in the
+    // order the children were added. Needs no lock inside an Epoch::Guard
+    // for the node's arena, the Epoch domain of everything a node retires;
+    // children added or removed meanwhile may or may not be visited
+    void forEachChild(const std::function<void(FileNode*, const std::string&, size_t)>& visit) const;
+    // Rebuilds the child index after entries of getChildren() were
+    // replaced by relocated nodes
+    void refreshChildIndex();
     std::string getContent() const;
-    size_t getSize() const;
+    // Borrows the content instead of copying it when the file is plain
+    // (neither compressed nor encrypted) and fits in a single extent;
+    // anything larger is joined into one buffer
+    ContentView getContentView() const;
+    // The content as one view per extent, in order. Plain files of any
+    // size are borrowed without a copy; other files decode each extent
+    // into a buffer of its own, so no view is larger than kExtentSize
+    std::vector<ContentView> getContentViews() const;
+    // Content accessors read one immutable snapshot of the content, which
+    // writers replace as a whole, so they need no lock inside an
+    // Epoch::Guard
+    size_t getSize() const;       // Logical size
+    size_t getStoredSize() const; // Bytes actually held after compression/encryption
     std::string getPath() const;
+    NodePath getPathHandle() const; // For comparing or printing without building the string
+
+    // Largest number of logical bytes held by one extent
+    static constexpr size_t kExtentSize = 64 * 1024;
 
     void setContent(const std::string& content);
+    // Takes over source's content, snapshotting a version like setContent.
+    // Payloads are shared when both nodes encode them the same way and are
+    // re-encoded one extent at a time otherwise
+    void adoptContent(const FileNode& source);
+
+    // Partial updates only re-encode the extents they touch and do not
+    // snapshot a version; writing past the end zero-fills the gap
+    void writeAt(size_t offset, const std::string& data);
+    void append(const std::string& data);
+    void truncate(size_t newSize);
+    std::string readAt(size_t offset, size_t length) const;
     void addChild(std::unique_ptr<FileNode> child);
+    // Makes room for additional more children up front, so adding them
+    // doesn't grow the child index step by step
+    void reserveChildren(size_t additional);
     
-    FileNode* findChild(const std::string& name) const;
-    void removeChild(const std::string& name);
+    // Lookups take no lock inside an Epoch::Guard
+    FileNode* findChild(std::string_view name) const;
+    FileNode* findChild(std::string_view name, size_t nameHash) const;
+    // The child is destroyed through Epoch::retire(), once lock-free
+    // readers that may have found it are done; the used space its subtree
+    // accounts for is given back right away
+    void removeChild(std::string_view name);
+    // Unlinks a child without destroying it, e.g. to link it elsewhere
+    std::unique_ptr<FileNode> detachChild(std::string_view name);
+    // Renames a node that is not linked into a directory
+    void setName(const std::string& newName);
+
+    static size_t hashName(std::string_view name);
 
     void setCompressed(bool compressed, const std::string& algorithmName = "");
     bool isCompressed() const;
@@ -49,61 +136,208 @@ public:
     // Versioning
     void saveVersion();
     bool restoreVersion(size_t versionIndex);
+    std::string getVersionContent(size_t versionIndex) const;
     size_t getVersionCount() const;
+    size_t getVersionStoredSize() const;
     std::vector<std::time_t> getVersionTimestamps() const;
 
+    // What a listing shows for a file, read from a single snapshot so the
+    // fields agree with each other; needs no lock inside an Epoch::Guard
+    struct Attributes {
+        size_t size = 0;
+        size_t storedSize = 0;
+        bool compressed = false;
+        std::string compressionAlgorithm;
+        bool encrypted = false;
+        std::string encryptionAlgorithm;
+        size_t versions = 0;
+        std::time_t modified = 0; // As getNodeModificationTime()
+    };
+    Attributes getAttributes() const;
+
+    // Re-encodes the content with the volume's current extent layout
+    void repack();
+
+    // Adds the size of each payload buffer not yet in seen to uniqueBytes
+    void countUniquePayloads(std::unordered_set<const std::string*>& seen, size_t& uniqueBytes) const;
+
+    // Bytes this node accounts for in its volume's used space, besides its
+    // payloads, which the block store charges once per volume
+    size_t getFootprint() const;
+
+    // Kept up to date on every mutation, so reading them is O(1). Returned
+    // by value, since mutations anywhere below keep changing them; each
+    // field is read atomically without a lock, so while the subtree changes
+    // some fields may already include a change that others don't yet
+    Totals getTotals() const;
+
+    // Per-node lock for VirtualFileSystem's path locking. Not copied or
+    // moved with the node, and not used by FileNode itself
+    NodeLock& getLock() const { return lock; }
+
 private:
-    std::string name;
+    // Totals are added to concurrently by writers in different subtrees
+    struct SharedTotals {
+        std::atomic<size_t> logicalBytes{0};
+        std::atomic<size_t> storedBytes{0};
+        std::atomic<size_t> files{0};
+        std::atomic<size_t> directories{0};
+    };
+
+    NodeArena* arena;
+    NameTable::NameId nameId; // Interned in the arena's name table
+    size_t nameHash;
     bool isDir;
     FileNode* parent;
+    bool attached; // Linked into parent's children, so totals propagate up
+    bool charged; // Footprint and payloads count toward the arena's used space
+    SharedTotals totals;
+    mutable NodeLock lock;
     std::vector<std::unique_ptr<FileNode>> children;
-    std::string content;
-    size_t size;
+    // Published for lock-free lookups; null until the first child is added
+    std::atomic<ChildIndex*> childIndex;
+    // Content is split into extents of at most kExtentSize logical bytes;
+    // each one is compressed, then encrypted, on its own. Extents are fixed
+    // size unless the volume deduplicates, in which case boundaries are
+    // content-defined and payloads come from the arena's block store.
+    // Payloads are immutable and shared between copies of a node
+    using Extent = ExtentList::Extent;
+    // Everything about a file's content, as one immutable snapshot. A
+    // writer, holding the node's lock, builds the next snapshot from the
+    // current one and swaps it in; the old one is retired through Epoch so
+    // that readers who picked it up without a lock can finish with it.
+    // Consecutive snapshots share the extent chunks a write left alone
+    struct Content {
+        ExtentList extents;
+        size_t size = 0;
+        size_t storedSize = 0; // Sum of the extent payload sizes
 
-    bool compressed;
-    std::string compressedContent;
-    std::string compressionAlgorithm;
-    
-    bool encrypted;
-    std::string encryptionKey;
-    std::string encryptionAlgorithm;
+        bool compressed = false;
+        std::string compressionAlgorithm;
+
+        bool encrypted = false;
+        std::string encryptionKey;
+        std::string encryptionAlgorithm;
+
+        // Mirrors of versions below, for readers without the lock
+        size_t versionCount = 0;
+        std::time_t oldestVersion = 0;
+    };
+    std::atomic<const Content*> content; // Null for directories and files never written
     
+    // Newest first. versions[0] is always a keyframe; older versions are
+    // usually deltas against their newer neighbour, with a keyframe at least
+    // every kKeyframeInterval entries so reconstruction chains stay short
     std::deque<std::unique_ptr<FileNodeVersion>> versions;
     size_t maxVersions = 10; // Keep at most 10 versions by default
+    static constexpr size_t kKeyframeInterval = 8;
     
-    std::string compressContent(const std::string& content) const;
-    std::string decompressContent(const std::string& compressedContent) const;
-    std::string encryptContent(const std::string& content, const std::string& key) const;
-    std::string decryptContent(const std::string& encryptedContent, const std::string& key) const;
+    const Content& current() const;
+    void swapContent(Content next); // Publishes next, retiring the current snapshot
+    void contentChanged(Content next);
+    // Moves the volume's payload charges from previous's extents to next's,
+    // looking only at the chunks the two don't share
+    void chargePayloads(const Content& previous, const Content& next);
+    void uncharge(); // Gives back the node's own charges, once
+    void unchargeSubtree();
+    void recordVersion();
+
+    static std::string compressContent(const Content& state, const std::string& content);
+    static std::string decompressContent(const Content& state, const std::string& compressedContent);
+    static std::string encryptContent(const Content& state, const std::string& content, const std::string& key);
+    static std::string decryptContent(const Content& state, const std::string& encryptedContent, const std::string& key);
+    static std::string encodeContent(const Content& state, const std::string& raw);
+    static std::string decodeContent(const Content& state, const std::string& payload);
+    static std::string readContent(const Content& state);
+    Extent encodeExtent(const Content& state, const std::string& raw, size_t offset) const;
+    void assignContent(Content& state, const std::string& raw) const;
+    static size_t findExtent(const Content& state, size_t position);
+    static void storeExtent(Content& state, size_t index, Extent extent);
+    void writeExtents(Content& state, size_t offset, std::string_view data) const;
+
+    void indexChild(FileNode* child); // children.back(), just added
+    void replaceChildIndex(size_t capacity);
+    Totals ownTotals() const;
+    void propagateTotals(const Totals& added, const Totals& removed);
+};
+
+// Lazily materialized absolute path of a node. Comparing walks the parent
+// chain directly, and str() builds the string only when asked, so the
+// handle always reflects where the node currently is. It must not outlive
+// the node.
+class NodePath {
+public:
+    explicit NodePath(const FileNode* node) : node(node) {}
+
+    std::string str() const;
+    size_t length() const;
+
+    // Same ordering as comparing str() with other
+    int compare(std::string_view other) const;
+
+    bool operator==(std::string_view other) const { return compare(other) == 0; }
+    bool operator!=(std::string_view other) const { return compare(other) != 0; }
+
+    // Heterogeneous lookups in maps keyed by path strings (std::less<>)
+    friend bool operator<(const NodePath& path, const std::string& other) { return path.compare(other) < 0; }
+    friend bool operator<(const std::string& other, const NodePath& path) { return path.compare(other) > 0; }
+
+    friend std::ostream& operator<<(std::ostream& out, const NodePath& path);
+
+private:
+    const FileNode* node;
 };
 
-// Class to store versions of file content
+// Read-only view of a file's content that keeps the buffer it points into
+// alive, so it stays valid even if the file is written to or removed
+// meanwhile. Content that can't be borrowed is decoded into a buffer the
+// view owns.
+class ContentView {
+public:
+    ContentView() = default;
+    ContentView(std::shared_ptr<const std::string> buffer, std::string_view content)
+        : buffer(std::move(buffer)), content(content) {}
+
+    std::string_view view() const { return content; }
+    const char* data() const { return content.data(); }
+    size_t size() const { return content.size(); }
+    bool empty() const { return content.empty(); }
+
+    operator std::string_view() const { return content; }
+
+private:
+    std::shared_ptr<const std::string> buffer;
+    std::string_view content;
+};
+
+// Class to store versions of file content. A version is either a keyframe
+// holding the full content or a delta against the next newer version.
 class FileNodeVersion {
 public:
     FileNodeVersion(const std::string& content);
     
     FileNodeVersion(const FileNodeVersion& other);
     
-    std::string getContent() const;
+    bool isKeyframe() const;
+    const std::string& getData() const; // Full content or delta
     std::time_t getTimestamp() const;
     
+    // Turns a keyframe into a delta against newerContent if that is smaller
+    void rebaseOnto(const std::string& newerContent);
+    
 private:
-    std::string content;
+    std::shared_ptr<const std::string> data; // Shared when versions are copied
+    bool keyframe;
     std::time_t timestamp;
 };
 
 
-inline std::time_t getNodeModificationTime(FileNode* node) {
+inline std::time_t getNodeModificationTime(const FileNode* node) {
     if (!node) {
         return std::time(nullptr);
     }
     
-    auto timestamps = node->getVersionTimestamps();
-    if (!timestamps.empty()) {
-        return timestamps.back();
-    }
-    
-    return std::time(nullptr);
+    return node->getAttributes().modified;
 }
 
 #endif // FILENODE_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef FILEWRITER_H
+#define FILEWRITER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "VfsPath.h"
+
+class FileNode;
+class VirtualFileSystem;
+
+// Streams new content into a file chunk by chunk. Data is buffered one
+// extent at a time, and each full extent is compressed and encrypted as
+// soon as it fills, so memory use stays bounded by the extent size rather
+// than the file size. Nothing is visible until close(), which replaces the
+// file's content in one step; destroying an unclosed writer or calling
+// abort() discards what was written. Writers are created by
+// VirtualFileSystem::createWriter(). Chunks are encoded without holding
+// the volume's lock, so writers on different threads stream in parallel;
+// only close() and abort() lock the volume.
+class FileWriter {
+public:
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    bool isOpen() const;
+
+    bool write(const char* data, size_t count);
+    bool write(const std::string& chunk);
+
+    // Bytes written so far
+    size_t size() const;
+
+    // Commits the content; fails if the volume went away or the file's
+    // directory no longer exists
+    bool close();
+    void abort();
+
+private:
+    friend class VirtualFileSystem;
+
+    FileWriter(VirtualFileSystem* volume, const VfsPath& path, std::unique_ptr<FileNode> staged);
+
+    void flush();
+
+    VirtualFileSystem* volume;
+    VfsPath path; // Absolute within the volume
+    std::unique_ptr<FileNode> staged; // Not linked into any tree
+    std::string pending; // Tail that does not fill an extent yet
+    size_t written;
+};
+
+#endif // FILEWRITER_H
@@ -0,0 +1,65 @@
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "VfsPath.h"
+
+class VirtualFileSystem;
+
+// Component-wise trie of mount points. Each trie node is one path
+// component below its parent, so "/data" and "/database" share nothing and
+// the longest mount prefix of a path is found in one pass over its
+// components. Positions are tracked with a Cursor, which can also sit below
+// the trie (offDepth > 0) so ".." components can climb back onto it.
+class MountTable {
+public:
+    struct Cursor {
+        uint32_t node;
+        size_t offDepth; // Components walked past the last trie node
+    };
+
+    MountTable();
+
+    Cursor root() const { return Cursor{0, 0}; }
+    Cursor advance(Cursor cursor, std::string_view name, size_t hash) const;
+    Cursor up(Cursor cursor) const;
+
+    // The volume mounted exactly at the cursor, if any
+    VirtualFileSystem* volumeAt(Cursor cursor) const;
+    // True if the cursor is a mount point or has mount points below it
+    bool hasMountsAt(Cursor cursor) const;
+
+    void insert(const VfsPath& mountPoint, VirtualFileSystem* volume);
+    void erase(const VfsPath& mountPoint);
+    void clear();
+
+    bool empty() const { return mounts == 0; }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        std::string name;
+        size_t hash;
+        uint32_t parent;
+        uint32_t childCount;
+        VirtualFileSystem* volume;
+    };
+
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<uint32_t> freeNodes;
+    std::unordered_multimap<size_t, uint32_t> edges; // (parent, name hash) -> child
+    size_t mounts;
+
+    static size_t edgeKey(uint32_t parent, size_t hash);
+    uint32_t findChild(uint32_t parent, std::string_view name, size_t hash) const;
+    uint32_t addChild(uint32_t parent, std::string_view name, size_t hash);
+    void removeNode(uint32_t node);
+};
+
+#endif // MOUNTTABLE_H
@@ -0,0 +1,60 @@
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Volume-wide interning table for node names. Every distinct name is
+// stored once and referenced by a small id; entries are reference counted
+// so names disappear again when the last node using them is destroyed.
+// Safe for concurrent use: acquire/retain/release serialize on a mutex,
+// while reading a name the caller holds a reference to takes no lock,
+// since entries live in chunks that are never moved.
+class NameTable {
+public:
+    using NameId = uint32_t;
+
+    static constexpr NameId kNoName = UINT32_MAX;
+
+    NameTable();
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    NameId acquire(std::string_view name, size_t hash);
+    void retain(NameId id);
+    void release(NameId id);
+
+    const std::string& text(NameId id) const { return entry(id).text; }
+    size_t hash(NameId id) const { return entry(id).hash; }
+    size_t length(NameId id) const { return entry(id).text.size(); }
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        std::string text;
+        size_t hash;
+        uint32_t refs;
+    };
+
+    static constexpr size_t kChunkBits = 12;
+    static constexpr size_t kChunkSize = size_t(1) << kChunkBits;
+    static constexpr size_t kMaxChunks = 4096;
+
+    std::unique_ptr<std::unique_ptr<Entry[]>[]> chunks; // kMaxChunks slots, filled on demand
+    size_t entryCount;
+    std::vector<NameId> freeIds;
+    std::unordered_multimap<size_t, NameId> byHash;
+    mutable std::mutex mutex;
+
+    Entry& entry(NameId id) const { return chunks[id >> kChunkBits][id & (kChunkSize - 1)]; }
+};
+
+#endif // NAMETABLE_H
@@ -0,0 +1,111 @@
+#ifndef NODEARENA_H
+#define NODEARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "BlockStore.h"
+#include "NameTable.h"
+
+// Slab allocator for FileNode objects. Each volume owns one arena, so the
+// nodes of a tree sit next to each other in large aligned slabs instead of
+// being scattered across individual heap allocations. Freed slots go back
+// to their slab's free list, and a slab that becomes empty is released as
+// a whole. The arena also holds the volume's interned node names, its
+// deduplicating block store and the running total of bytes its nodes
+// account for. Allocation and compaction serialize on an internal mutex,
+// so nodes of one arena may be created and destroyed from several threads.
+class NodeArena {
+public:
+    static constexpr size_t kSlabSize = 64 * 1024;
+
+    struct Stats {
+        size_t slabs = 0;
+        size_t liveNodes = 0;
+        size_t capacity = 0;
+        size_t bytesReserved = 0;
+        size_t releaseLocks = 0; // Times freeing slots took the arena's lock
+    };
+
+    NodeArena();
+    ~NodeArena();
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    void* allocate();
+    static void deallocate(void* ptr);
+    // Frees many slots, taking each arena's lock once per run of slots
+    // from that arena rather than once per slot; used to free a whole
+    // subtree of nodes at once
+    static void deallocate(void* const* ptrs, size_t count);
+
+    // Arena for nodes created outside of any volume
+    static NodeArena& shared();
+
+    // Compaction: slabs below the occupancy threshold are marked for
+    // evacuation and stop serving allocations. The owner then relocates
+    // every node for which isEvacuating() is true and calls
+    // endCompaction(), which releases the slabs that were emptied. Like
+    // deallocate(), isEvacuating() only takes pointers from allocate().
+    size_t beginCompaction(double occupancyThreshold = 0.5);
+    bool isEvacuating(const void* ptr) const;
+    size_t endCompaction();
+
+    Stats getStats() const;
+
+    NameTable& names() { return nameTable; }
+    const NameTable& names() const { return nameTable; }
+
+    BlockStore& blocks() { return blockStore; }
+    const BlockStore& blocks() const { return blockStore; }
+
+    // Atomic, since the staged nodes of several writers share one arena
+    void account(std::ptrdiff_t delta) { accountedBytes.fetch_add(static_cast<size_t>(delta), std::memory_order_relaxed); }
+    size_t getAccountedBytes() const { return accountedBytes.load(std::memory_order_relaxed); }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    static constexpr uint64_t kSlabMagic = 0x4e6f6465536c6162; // "NodeSlab"
+
+    struct Slab {
+        uint64_t magic;       // kSlabMagic while the slab is live
+        NodeArena* owner;
+        Slab* prev;           // Links in the list of all slabs
+        Slab* next;
+        Slab* availablePrev;  // Links in the list of slabs with free slots
+        Slab* availableNext;
+        FreeSlot* freeList;
+        uint32_t used;
+        uint32_t bumpIndex;   // Slots past this index have never been handed out
+        bool isAvailable;
+        bool evacuating;
+    };
+
+    NameTable nameTable;
+    BlockStore blockStore;
+    Slab* slabs;
+    Slab* available;
+    size_t slabCount;
+    size_t liveNodes;
+    size_t releaseLocks;
+    std::atomic<size_t> accountedBytes;
+    mutable std::mutex slabMutex;
+
+    static size_t slotSize();
+    static size_t slotsOffset();
+    static size_t slotsPerSlab();
+    static Slab* slabOf(const void* ptr);
+
+    Slab* createSlab();
+    void destroySlab(Slab* slab);
+    void linkAvailable(Slab* slab);
+    void unlinkAvailable(Slab* slab);
+    void release(Slab* slab, void* ptr); // With slabMutex held
+};
+
+#endif // NODEARENA_H
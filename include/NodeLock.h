@@ -0,0 +1,58 @@
+#ifndef NODELOCK_H
+#define NODELOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+// Reader-writer lock embedded in every FileNode. It is a single word, so
+// it adds almost nothing to a node, and the uncontended paths are one
+// atomic operation; a thread that has to wait spins briefly and then
+// yields. A waiting writer holds off new readers. Meets the SharedMutex
+// requirements, so it works with std::shared_lock and std::unique_lock.
+class NodeLock {
+public:
+    NodeLock() : state(0) {}
+
+    NodeLock(const NodeLock&) = delete;
+    NodeLock& operator=(const NodeLock&) = delete;
+
+    void lock() {
+        uint32_t expected = 0;
+        if (!state.compare_exchange_weak(expected, kWriter, std::memory_order_acquire)) {
+            lockSlow();
+        }
+    }
+
+    bool try_lock() {
+        uint32_t current = state.load(std::memory_order_relaxed);
+        return (current & ~kWriterWaiting) == 0 &&
+               state.compare_exchange_strong(current, kWriter, std::memory_order_acquire);
+    }
+
+    void unlock() { state.fetch_and(~kWriter, std::memory_order_release); }
+
+    void lock_shared() {
+        if (!try_lock_shared()) {
+            lockSharedSlow();
+        }
+    }
+
+    bool try_lock_shared() {
+        uint32_t current = state.load(std::memory_order_relaxed);
+        return (current & (kWriter | kWriterWaiting)) == 0 &&
+               state.compare_exchange_strong(current, current + 1, std::memory_order_acquire);
+    }
+
+    void unlock_shared() { state.fetch_sub(1, std::memory_order_release); }
+
+private:
+    static constexpr uint32_t kWriter = 1u << 31;
+    static constexpr uint32_t kWriterWaiting = 1u << 30; // Low bits count readers
+
+    std::atomic<uint32_t> state;
+
+    void lockSlow();
+    void lockSharedSlow();
+};
+
+#endif // NODELOCK_H
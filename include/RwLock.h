@@ -0,0 +1,44 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Reader-writer lock where readers and writers take turns: once a writer is
+// waiting, new readers queue behind it, and the readers that queued while a
+// writer held the lock go in before the next writer. Neither a steady
+// stream of reads nor one of writes can starve the other side, which
+// std::shared_mutex does not promise. Meets the SharedMutex requirements,
+// so it works with std::shared_lock and std::unique_lock.
+class RwLock {
+public:
+    RwLock();
+
+    RwLock(const RwLock&) = delete;
+    RwLock& operator=(const RwLock&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+
+private:
+    std::mutex mutex;
+    std::condition_variable readersCanEnter;
+    std::condition_variable writerCanEnter;
+    size_t readers;        // Readers holding the lock
+    size_t waitingReaders;
+    size_t waitingWriters;
+    size_t readerBatch;    // Readers still to be let in ahead of waiting writers
+    bool writer;           // A writer holds the lock
+
+    bool readerMayEnter() const { return !writer && (waitingWriters == 0 || readerBatch > 0); }
+    bool writerMayEnter() const { return !writer && readers == 0 && readerBatch == 0; }
+    void admitReader();
+};
+
+#endif // RWLOCK_H
@@ -49,13 +49,21 @@ private:
     void cmdCd(const std::vector<std::string>& args);
     void cmdLs(const std::vector<std::string>& args);
     void cmdCat(const std::vector<std::string>& args);
+    void cmdHead(const std::vector<std::string>& args);
+    void cmdTail(const std::vector<std::string>& args);
     void cmdWrite(const std::vector<std::string>& args);
+    void cmdAppend(const std::vector<std::string>& args);
+    void cmdTruncate(const std::vector<std::string>& args);
+    void cmdImport(const std::vector<std::string>& args);
     void cmdRm(const std::vector<std::string>& args);
     void cmdHelp(const std::vector<std::string>& args);
     void cmdExit(const std::vector<std::string>& args);
     void cmdSave(const std::vector<std::string>& args);
     void cmdLoad(const std::vector<std::string>& args);
     void cmdDiskInfo(const std::vector<std::string>& args);
+    void cmdCompact(const std::vector<std::string>& args);
+    void cmdDedup(const std::vector<std::string>& args);
+    void cmdDcache(const std::vector<std::string>& args);
     void cmdPwd(const std::vector<std::string>& args);
     void cmdCp(const std::vector<std::string>& args);
     void cmdMv(const std::vector<std::string>& args);
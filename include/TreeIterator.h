@@ -0,0 +1,95 @@
+#ifndef TREEITERATOR_H
+#define TREEITERATOR_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+class FileNode;
+
+// Walks a subtree without recursion, visiting the start node first, then
+// its descendants either depth-first (pre-order, in child order) or
+// breadth-first. The traversal state lives in buffers owned by the
+// iterator that are reused from node to node, so a walk does no per-node
+// heap allocation once they have grown. Optionally the iterator keeps the
+// path of the current node up to date; depth-first walks extend and trim a
+// single buffer as they go down and up. The tree must not change while it
+// is being walked; a depth-first walk can instead be asked to hold a
+// shared lock on every directory it is inside of, which keeps out writers
+// for exactly the part of the tree being read.
+//
+//     for (TreeIterator walk(root); !walk.done(); walk.next()) {
+//         if (skip(walk.node())) walk.prune();
+//     }
+class TreeIterator {
+public:
+    static constexpr int DepthFirst = 0;
+    static constexpr int BreadthFirst = 1;
+
+    explicit TreeIterator(const FileNode* start, int order = DepthFirst);
+    ~TreeIterator();
+
+    TreeIterator(const TreeIterator&) = delete;
+    TreeIterator& operator=(const TreeIterator&) = delete;
+
+    // Nodes deeper than maxDepth are skipped; the start node is depth 0
+    void setMaxDepth(size_t maxDepth);
+    // Files are skipped, so only directories are visited
+    void setDirectoriesOnly(bool directoriesOnly);
+    // Maintain path(): the start node's own path, or startPath with child
+    // names appended to it
+    void trackPath();
+    void trackPath(const std::string& startPath);
+    // Depth-first only: lock each directory shared before reading its
+    // children and unlock it once they are done. The start node is left
+    // to the caller, who must already hold its lock. A node is visited
+    // while only its parent is locked
+    void lockDirectories();
+
+    bool done() const { return current == nullptr; }
+    const FileNode* node() const { return current; }
+    size_t depth() const { return currentDepth; }
+    const std::string& path() const { return pathBuffer; }
+
+    // Don't descend into the current node
+    void prune() { pruned = true; }
+    void next();
+
+private:
+    struct Frame {
+        const FileNode* directory;
+        size_t nextChild;
+        size_t pathLength; // Length of the directory's path in pathBuffer
+    };
+
+    struct Pending {
+        const FileNode* node;
+        size_t depth;
+    };
+
+    const FileNode* start;
+    const FileNode* current;
+    size_t currentDepth;
+    int order;
+    size_t maxDepth;
+    bool directoriesOnly;
+    bool pruned;
+    bool tracking;
+    bool locking;
+
+    std::vector<Frame> stack;    // Depth-first: directories being walked
+    std::deque<Pending> queue;   // Breadth-first: nodes still to visit
+    std::string pathBuffer;
+    size_t startPathLength;
+    std::vector<const FileNode*> chain; // Scratch for breadth-first paths
+
+    bool wanted(const FileNode* node) const;
+    void unlockDirectory(const FileNode* directory) const;
+    void nextDepthFirst();
+    void nextBreadthFirst();
+    void buildPath();
+    static void appendName(std::string& path, const std::string& name);
+};
+
+#endif // TREEITERATOR_H
@@ -0,0 +1,72 @@
+#ifndef VFSPATH_H
+#define VFSPATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A path parsed and normalized once: empty and "." components are dropped,
+// ".." is kept for the resolver. Components are string_views into the
+// path's own text, each with the same hash FileNode uses for its name, so
+// walking the tree with a VfsPath neither allocates nor rehashes. Paths of
+// up to kInlineText bytes and kInlineComponents components, which is
+// nearly all of them, are kept inside the object, so building one from a
+// string allocates nothing either. Longer paths are parsed into a heap
+// buffer that copies, parent() and suffix() share instead of reparsing.
+class VfsPath {
+public:
+    static constexpr size_t kInlineText = 96;
+    static constexpr size_t kInlineComponents = 12;
+
+    VfsPath();
+    VfsPath(const std::string& path);
+    VfsPath(const char* path);
+    VfsPath(std::string_view path);
+
+    bool isAbsolute() const { return absolute; }
+    bool empty() const { return !absolute && count == 0; } // The current directory
+    size_t size() const { return count; }
+
+    std::string_view operator[](size_t index) const;
+    size_t hash(size_t index) const;
+    bool isParentRef(size_t index) const; // ".."
+
+    // Last component, or "" for the root and the current directory
+    std::string_view name() const;
+
+    // Path without its last component
+    VfsPath parent() const;
+
+    // Absolute path made of the components after the first skip
+    VfsPath suffix(size_t skip) const;
+
+    // Normalized text, e.g. "/a/b" or "a/../c"
+    std::string str() const;
+
+private:
+    struct Component {
+        uint32_t offset;
+        uint32_t length;
+        size_t hash;
+    };
+
+    struct Parsed {
+        std::string text;
+        std::vector<Component> components;
+    };
+
+    std::shared_ptr<const Parsed> parsed; // Null while the path is inline
+    size_t first;
+    size_t count;
+    bool absolute;
+    char inlineText[kInlineText] = {};
+    Component inlineComponents[kInlineComponents] = {};
+
+    const char* text() const { return parsed ? parsed->text.data() : inlineText; }
+    const Component& component(size_t index) const;
+};
+
+#endif // VFSPATH_H
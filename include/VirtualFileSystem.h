@@ -2,12 +2,24 @@
 #define VIRTUALFILESYSTEM_H
 
 #include "FileNode.h"
+#include "FileHandle.h"
+#include "FileWriter.h"
+#include "NodeArena.h"
+#include "DentryCache.h"
+#include "MountTable.h"
+#include "VfsPath.h"
+#include "RwLock.h"
+#include "Epoch.h"
 #include <string>
 #include <memory>
 #include <vector>
 #include <fstream>
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
 #include <set>
+#include <unordered_set>
 #include <regex>
 #include <ctime>
 #include <optional>
@@ -38,72 +50,317 @@ struct SearchFilter {
     std::function<bool(const FileNode*)> customFilter;
 };
 
+// One entry of a directory listing, filled in from the child node in the
+// same pass that walks the directory. Entries own everything they hold, so
+// they stay valid whatever happens to the volume after list() returns.
+struct DirEntry {
+    std::string name;
+    bool isDirectory = false;
+    bool isMountPoint = false; // A volume is mounted on this directory
+    size_t size = 0;           // Logical bytes; 0 for directories
+    size_t storedSize = 0;
+    std::time_t modified = 0;
+    bool compressed = false;
+    bool encrypted = false;
+    size_t versions = 0;
+};
+
+// Attributes of one file or directory, gathered by a single path lookup
+struct FileStat {
+    bool exists = false;
+    bool isDirectory = false;
+    size_t size = 0;        // Logical bytes; for directories, of the whole subtree
+    size_t storedSize = 0;
+    size_t files = 0;       // Files and directories in a directory's subtree,
+    size_t directories = 0; // including itself
+    std::time_t modified = 0;
+    bool compressed = false;
+    std::string compressionAlgorithm;
+    bool encrypted = false;
+    std::string encryptionAlgorithm;
+    size_t versions = 0;
+    std::vector<std::string> tags;
+};
+
+// One step of a VirtualFileSystem::applyBatch() call
+struct BatchOp {
+    enum class Type {
+        Mkdir,
+        Touch,
+        Write,  // data is the new content
+        Remove,
+        AddTag, // data is the tag
+    };
+
+    Type type;
+    VfsPath path;
+    std::string data;
+};
+
+// Every public method can be called from any thread. Operations on paths
+// share the volume's lock and then lock the nodes they touch, so they run
+// in parallel unless they meet in the same directory or file; operations
+// on the whole volume (loading, saving, mounting, batches, compaction,
+// deduplication, verification) take the volume's lock exclusively. A call
+// routed into a mounted volume also takes that volume's lock, always after
+// this one's.
+//
+// Every node has a reader-writer lock. A directory's lock guards its list
+// of children, a file's lock guards its content and attributes. Lookups
+// couple hand over hand: the child is locked before the parent is
+// released, so a walk never sees a directory change under it, and only
+// the last node is locked exclusively when the operation modifies it
+// (the parent for mkdir, touch and remove, the file for writes). Holding
+// any node's lock pins its whole ancestor chain, because moving or
+// removing a directory locks its entire subtree exclusively first.
+//
+// Lock ordering, which every operation follows:
+//  1. This volume, then mounted volumes, then the rename lock.
+//  2. Node locks top-down: a node is only locked while holding its parent
+//     or holding no node at all. A path with ".." releases everything and
+//     starts again from the root.
+//  3. Only a move holds two branches at once. It takes the rename lock,
+//     locks the lowest common ancestor of both parent directories, and
+//     couples down each branch from there while still holding it. Then it
+//     locks the moved subtree and any file it replaces.
+//  4. A copy never holds two branches: it snapshots the source with its
+//     subtree locked shared, releases it, then links the snapshot under
+//     the exclusively locked destination directory.
+//  5. Name table, node arena, block store, dentry cache, tags, handles and
+//     cwd have mutexes of their own that are taken last and never held
+//     while waiting for a node. Code that has to reach a node while
+//     holding one of them, like a handle or a relative lookup from the
+//     cwd, only try-locks the node and backs off.
+//
+// Reads (cat, read, ls, list, stat, resolvePath) usually take no lock at
+// all. Directories publish their children in a ChildIndex and files their
+// content as immutable snapshots, which writers replace and retire through
+// Epoch instead of freeing, and removed nodes are retired the same way. A
+// lock-free read only pins the epoch in the volume's own Epoch domain, so
+// it writes nothing shared with other readers; it sees each node as of
+// some moment during the call. Taking the volume's lock exclusively waits
+// until such reads of this volume have left and keeps new ones out. Reads
+// whose path climbs with "..", leads into a mounted volume, or is relative
+// while volumes are mounted, and stat() while any file is tagged, take the
+// locked route described above.
+//
+// Node pointers handed out by resolvePath() are only safe while no other
+// thread modifies the volume. A search's customFilter
+// runs with the directories on the way to the node locked shared, so it
+// must not call back into the file system.
 class VirtualFileSystem {
+    friend class FileHandle;
+    friend class FileWriter;
+
 public:
+    struct DedupStats {
+        bool enabled = false;
+        size_t referencedBytes = 0; // Stored bytes as the files see them
+        size_t uniqueBytes = 0;     // Bytes of distinct payload buffers, as charged to used space
+        size_t blocks = 0;          // Blocks in the volume's block store
+        double ratio = 1.0;         // referencedBytes / uniqueBytes
+    };
+
     VirtualFileSystem(size_t diskSize = 10 * 1024 * 1024); // Default 10MB
     ~VirtualFileSystem();
 
     VirtualFileSystem& operator=(const VirtualFileSystem& other);
 
     // File system operations
-    bool mkdir(const std::string& path);
-    bool touch(const std::string& path);
-    bool cd(const std::string& path);
-    std::vector<std::string> ls(const std::string& path = "");
-    std::string cat(const std::string& path);
-    bool write(const std::string& path, const std::string& content);
-    bool remove(const std::string& path);
+    bool mkdir(const VfsPath& path);
+    bool touch(const VfsPath& path);
+    bool cd(const VfsPath& path);
+    std::vector<std::string> ls(const VfsPath& path = VfsPath());
+    // Typed listing; unlike ls() no names are decorated, so callers need no
+    // second lookup per entry
+    std::vector<DirEntry> list(const VfsPath& path = VfsPath());
+    std::string cat(const VfsPath& path);
+    // Reads up to length bytes at offset into out, decoding only the extents
+    // the range touches; false if the path is not a file
+    bool read(const VfsPath& path, size_t offset, size_t length, std::string& out);
+    bool write(const VfsPath& path, const std::string& content);
+    bool writeAt(const VfsPath& path, size_t offset, const std::string& data);
+    bool append(const VfsPath& path, const std::string& data);
+    bool truncate(const VfsPath& path, size_t newSize);
+    bool remove(const VfsPath& path);
+    // Copies a file or directory tree; content buffers are shared until written
+    bool copy(const VfsPath& sourcePath, const VfsPath& destPath);
+    // Relinks a node under a new parent and/or name; across volumes it
+    // falls back to copy and remove
+    bool move(const VfsPath& sourcePath, const VfsPath& destPath);
+
+    // Applies the operations in order and reports which succeeded. The
+    // operations are grouped by parent directory first: each parent is
+    // looked up once per batch and its child index grown once for all the
+    // entries the batch adds to it, so bulk creation costs time linear in
+    // the batch size
+    std::vector<bool> applyBatch(const std::vector<BatchOp>& ops);
+
+    // Opens a file for repeated I/O without further path lookups; flags are
+    // FileHandle::Read, Write, Create, Truncate and Append. Returns nullptr
+    // if the file is missing (and not created) or is a directory
+    std::unique_ptr<FileHandle> open(const VfsPath& path, unsigned flags = FileHandle::Read);
+    // Streams new content into a file, created if missing, that replaces
+    // the old content when the writer is closed; nullptr if the directory
+    // is missing or the path is a directory
+    std::unique_ptr<FileWriter> createWriter(const VfsPath& path);
 
     // Disk operations
     bool saveToDisk(const std::string& filename = "virtual_disk.bin");
     bool loadFromDisk(const std::string& filename = "virtual_disk.bin");
+    // getTotalSpace() minus getUsedSpace()
     size_t getFreeSpace() const;
     size_t getTotalSpace() const;
+    // Bytes the volume stores, not the sum of its files' sizes: every node
+    // counts sizeof(FileNode) plus its name's length, and every distinct
+    // payload buffer counts its stored length once, however many files or
+    // extents share it. A compressed or encrypted payload counts the bytes
+    // actually held, as getStoredSize() does
     size_t getUsedSpace() const;
+    // Recounts the whole tree and checks it against getUsedSpace()
+    bool verifyUsedSpace() const;
+
+    // Relocates nodes out of sparsely used slabs; returns slabs released
+    size_t compactNodes();
+    NodeArena::Stats getNodeStorageStats() const;
+
+    DentryCache::Stats getDentryCacheStats() const;
+    void setDentryCacheCapacity(size_t capacity);
 
-    FileNode* resolvePath(const std::string& path);
+    // Content-addressed deduplication of file extents, off by default.
+    // Enabling it re-chunks existing files with content-defined boundaries
+    void setDeduplication(bool enabled);
+    bool isDeduplicationEnabled() const;
+    DedupStats getDedupStats() const;
+
+    // Everything the single-attribute getters below report, in one lookup
+    FileStat stat(const VfsPath& path) const;
+
+    FileNode* resolvePath(const VfsPath& path);
     std::string getCurrentPath() const;
 
     bool createVolume(const std::string& volumeName, size_t volumeSize);
-    bool mountVolume(const std::string& diskImage, const std::string& mountPoint);
-    bool unmountVolume(const std::string& mountPoint);
+    bool mountVolume(const std::string& diskImage, const VfsPath& mountPoint);
+    bool unmountVolume(const VfsPath& mountPoint);
     std::vector<std::string> listMountedVolumes() const;
-    bool isMountPoint(const std::string& path) const;
+    bool isMountPoint(const VfsPath& path) const;
 
-    bool compressFile(const std::string& path, bool compress = true, const std::string& algorithm = "");
-    bool isFileCompressed(const std::string& path) const;
-    std::string getFileCompressionAlgorithm(const std::string& path) const;
+    bool compressFile(const VfsPath& path, bool compress = true, const std::string& algorithm = "");
+    bool isFileCompressed(const VfsPath& path) const;
+    std::string getFileCompressionAlgorithm(const VfsPath& path) const;
     std::vector<std::string> listCompressionAlgorithms() const;
 
-    bool encryptFile(const std::string& path, const std::string& key, const std::string& algorithm = "");
-    bool decryptFile(const std::string& path);
-    bool isFileEncrypted(const std::string& path) const;
-    std::string getFileEncryptionAlgorithm(const std::string& path) const;
-    bool changeEncryptionKey(const std::string& path, const std::string& newKey);
+    bool encryptFile(const VfsPath& path, const std::string& key, const std::string& algorithm = "");
+    bool decryptFile(const VfsPath& path);
+    bool isFileEncrypted(const VfsPath& path) const;
+    std::string getFileEncryptionAlgorithm(const VfsPath& path) const;
+    bool changeEncryptionKey(const VfsPath& path, const std::string& newKey);
     std::vector<std::string> listEncryptionAlgorithms() const;
 
-    bool saveFileVersion(const std::string& path);
-    bool restoreFileVersion(const std::string& path, size_t versionIndex);
-    size_t getFileVersionCount(const std::string& path) const;
-    std::vector<std::time_t> getFileVersionTimestamps(const std::string& path) const;
-
-    std::vector<std::string> search(const SearchFilter& filter, const std::string& startPath = "");
-    std::vector<std::string> searchByName(const std::string& namePattern, bool useRegex = false, const std::string& startPath = "");
-    std::vector<std::string> searchByContent(const std::string& contentPattern, bool useRegex = false, const std::string& startPath = "");
-    std::vector<std::string> searchByTag(const std::string& tag, const std::string& startPath = "");
-    std::vector<std::string> searchBySize(size_t minSize, size_t maxSize, const std::string& startPath = "");
-    std::vector<std::string> searchByDate(time_t modifiedAfter, time_t modifiedBefore, const std::string& startPath = "");
-
-    bool addTag(const std::string& path, const std::string& tag);
-    bool removeTag(const std::string& path, const std::string& tag);
-    std::vector<std::string> getFileTags(const std::string& path) const;
+    bool saveFileVersion(const VfsPath& path);
+    bool restoreFileVersion(const VfsPath& path, size_t versionIndex);
+    size_t getFileVersionCount(const VfsPath& path) const;
+    std::vector<std::time_t> getFileVersionTimestamps(const VfsPath& path) const;
+
+    std::vector<std::string> search(const SearchFilter& filter, const VfsPath& startPath = VfsPath());
+    std::vector<std::string> searchByName(const std::string& namePattern, bool useRegex = false, const VfsPath& startPath = VfsPath());
+    std::vector<std::string> searchByContent(const std::string& contentPattern, bool useRegex = false, const VfsPath& startPath = VfsPath());
+    std::vector<std::string> searchByTag(const std::string& tag, const VfsPath& startPath = VfsPath());
+    std::vector<std::string> searchBySize(size_t minSize, size_t maxSize, const VfsPath& startPath = VfsPath());
+    std::vector<std::string> searchByDate(time_t modifiedAfter, time_t modifiedBefore, const VfsPath& startPath = VfsPath());
+
+    bool addTag(const VfsPath& path, const std::string& tag);
+    bool removeTag(const VfsPath& path, const std::string& tag);
+    std::vector<std::string> getFileTags(const VfsPath& path) const;
     std::vector<std::string> getAllTags() const;
 
 private:
+    // The volume's lock. Taking it exclusively also waits for lock-free
+    // readers still inside the volume, those holding guards of its Epoch
+    // domain, and turns new ones away to the locked route until it is
+    // released
+    class TreeLock {
+    public:
+        explicit TreeLock(Epoch::Domain readers) : readers(readers), exclusive(false) {}
+
+        void lock();
+        bool try_lock();
+        void unlock();
+
+        void lock_shared() { rw.lock_shared(); }
+        bool try_lock_shared() { return rw.try_lock_shared(); }
+        void unlock_shared() { rw.unlock_shared(); }
+
+        bool isExclusive() const { return exclusive.load(); }
+
+    private:
+        RwLock rw;
+        Epoch::Domain readers;
+        std::atomic<bool> exclusive;
+
+        void excludeReaders();
+    };
+
+    using ReadLock = std::shared_lock<TreeLock>;
+    using WriteLock = std::unique_lock<TreeLock>;
+#ifdef VFS_DEBUG_ACCOUNTING
+    // Recounting the tree after every change needs the volume to itself
+    using PathLock = WriteLock;
+#else
+    using PathLock = ReadLock; // Taken by operations that modify nodes
+#endif
+
+    // Node locks taken by one operation, released together, newest first
+    class NodeLocks {
+    public:
+        NodeLocks() = default;
+        ~NodeLocks() { releaseAll(); }
+
+        NodeLocks(const NodeLocks&) = delete;
+        NodeLocks& operator=(const NodeLocks&) = delete;
+
+        void lock(const FileNode* node, bool exclusive);
+        void adopt(const FileNode* node, bool exclusive); // Already locked by the caller
+        bool holds(const FileNode* node) const;
+        void releaseAll();
+
+    private:
+        std::vector<std::pair<const FileNode*, bool>> held;
+    };
+
+    // A lock-free lookup of one path, for reads. It pins the epoch for as
+    // long as it lives, so whatever it found stays allocated. If the path
+    // has to take the locked route, or the volume is held exclusively, it
+    // leaves the epoch again and resolved() is false
+    class ReadSection {
+    public:
+        ReadSection(const VirtualFileSystem& volume, const VfsPath& path);
+
+        bool resolved() const { return guard.has_value(); }
+        FileNode* node() const { return target; } // nullptr if missing
+        MountTable::Cursor cursor() const { return position; }
+
+    private:
+        std::optional<Epoch::Guard> guard;
+        FileNode* target;
+        MountTable::Cursor position;
+    };
+
+    mutable TreeLock treeLock; // Shared by path operations, see above
+    std::mutex renameLock; // Serializes moves, the only multi-branch lockers
+    NodeArena nodeArena; // Declared before root so it outlives every node
+    NodeArena stagingArena; // Nodes of open FileWriters, outside the volume
     std::unique_ptr<FileNode> root;
-    FileNode* currentDirectory;
+    mutable DentryCache dentries; // Lookups made by resolvePath
+    mutable std::mutex dentryLock;
+    mutable std::mutex cwdLock; // Guards the cwd state below
+    std::atomic<FileNode*> currentDirectory; // Also read by lock-free lookups
+    std::string cwdPath;
+    MountTable::Cursor cwdCursor; // Mount table position of the cwd
+    mutable std::mutex tagsLock; // Guards fileTags
+    std::atomic<bool> anyTags; // False until something is tagged, for lock-free stat()
+    mutable std::mutex handlesLock; // Guards the open handles and writers, and their nodes
     size_t diskSize;
-    size_t usedSpace;
 
     struct MountInfo {
         std::string diskImage;
@@ -112,17 +369,79 @@ private:
     };
 
     std::map<std::string, MountInfo> mountedVolumes; // key: mount path
+    MountTable mountTable; // The same mount points, for prefix lookups
+    std::unordered_set<FileHandle*> openHandles; // Handles on this volume's nodes
+    std::unordered_set<FileWriter*> openWriters;
+
+    std::unique_ptr<FileNode> makeNode(const std::string& name, bool isDirectory, FileNode* parent);
+    void relocateNodes(std::unique_ptr<FileNode>& rootSlot);
+    void repackFiles(FileNode* start);
+    bool transfer(VirtualFileSystem* sourceFS, const VfsPath& sourceLocal,
+                  VirtualFileSystem* destFS, const VfsPath& destLocal, bool removeSource);
+    // The two halves of a copy: a detached deep copy of the node at path,
+    // allocated in arena, and linking it in at path in this volume
+    std::unique_ptr<FileNode> snapshotNode(const VfsPath& path, NodeArena& arena, const std::string& name);
+    bool linkCopy(std::unique_ptr<FileNode> copy, const VfsPath& path);
+    bool unlink(const VfsPath& path);
+    void checkUsedSpace() const; // Asserts verifyUsedSpace() in VFS_DEBUG_ACCOUNTING builds
+    void setCwd(FileNode* directory); // With cwdLock held
+    VirtualFileSystem* getResponsibleFS(const VfsPath& path, VfsPath& localPath);
+    VirtualFileSystem* findMount(const VfsPath& path, size_t& consumed) const;
+    MountTable::Cursor mountCursorOf(const FileNode* node) const;
+    MountTable::Cursor cwdMountCursor() const;
+    bool hasMountAt(const VfsPath& path) const;
+    bool attachVolume(const std::string& diskImage, const VfsPath& mountPoint);
+    void applyDeduplication(bool enabled);
+    bool usedSpaceMatches() const;
+    bool containsMount(const FileNode* node) const; // Node is or holds a mount point
+    FileNode* lookupChild(const FileNode* parent, std::string_view name, size_t hash) const;
+    // Walk for a ReadSection; false if the path needs the locked route
+    bool lookupUnlocked(const VfsPath& path, FileNode*& node, MountTable::Cursor& cursor) const;
+
+    // The part of a read after the lookup, shared by both routes. They need
+    // the node locked shared or an Epoch::Guard; listings enter a guard of
+    // their own for the children
+    std::vector<std::string> listNames(const FileNode* directory) const;
+    std::vector<DirEntry> listEntries(const FileNode* directory, MountTable::Cursor cursor) const;
+    FileStat statNode(const FileNode* node) const; // Without tags
+
+    // Lookups for whole-volume operations, which hold the volume exclusively
+    FileNode* resolveParent(const VfsPath& path); // Directory to hold path's last component
+    FileNode* lookupPath(const VfsPath& path) const; // resolvePath without leaving this volume's tree
+
+    // Lookups for path operations. They lock the node they return and add
+    // it to locks, or return nullptr holding nothing
+    FileNode* lockPath(const VfsPath& path, size_t depth, bool exclusive, NodeLocks& locks) const; // First depth components
+    FileNode* lockTarget(const VfsPath& path, bool exclusive, NodeLocks& locks) const;
+    FileNode* lockParent(const VfsPath& path, NodeLocks& locks) const; // Exclusively, as for resolveParent
+    FileNode* lockChild(FileNode* parent, bool parentExclusive, std::string_view name, size_t hash,
+                        bool exclusive, bool keepParent = false) const;
+    FileNode* lockRoute(const std::vector<std::string>& route, size_t depth, bool exclusive) const; // Names from the root
+    std::vector<std::string> absoluteRoute(const VfsPath& path, size_t depth) const;
+    void lockSubtree(const FileNode* node, bool exclusive, NodeLocks& locks) const; // Node itself already locked
 
-    std::vector<std::string> splitPath(const std::string& path);
-    void updateUsedSpace();
-    VirtualFileSystem* getResponsibleFS(const std::string& path, std::string& localPath);
-    std::string getVolumeForPath(const std::string& path) const;
+    // Single steps on an already resolved parent, shared with applyBatch().
+    // lockNodes is false when the caller holds the volume exclusively and
+    // true when it holds the parent exclusively under the shared lock
+    bool createChild(FileNode* parent, const VfsPath& path, bool isDirectory);
+    bool writeChild(FileNode* parent, const VfsPath& path, const std::string& content, bool lockNodes);
+    bool removeNode(FileNode* target, bool lockNodes);
+    void tagNode(const FileNode* node, const std::string& tag);
+    // Drops dentries and handles for a node about to be destroyed; subtree
+    // holds its locks, unless the volume is held exclusively
+    void forgetSubtree(const FileNode* node, const NodeLocks* subtree);
+    void closeHandles(const FileNode* node = nullptr, const NodeLocks* subtree = nullptr); // Handles under node, or all of them
+    void releaseHandle(FileHandle* handle);
+    FileNode* pinHandle(const FileHandle* handle, bool exclusive); // Locks the handle's node
+    bool commitWriter(const VfsPath& path, const FileNode& staged);
+    void releaseWriter(FileWriter* writer);
+    void retagSubtree(const std::string& oldPath, const std::string& newPath);
 
-    void searchRecursive(FileNode* node, const std::string& currentPath, const SearchFilter& filter, std::vector<std::string>& results);
-    bool matchesFilter(FileNode* node, const std::string& filePath, const SearchFilter& filter);
-    bool contentMatches(FileNode* node, const std::string& pattern, bool isRegex);
+    bool matchesFilter(const FileNode* node, const SearchFilter& filter);
+    bool contentMatches(const FileNode* node, const std::string& pattern, bool isRegex);
 
-    std::map<std::string, std::vector<std::string>> fileTags; // Maps file paths to their tags
+    // Maps file paths to their tags; std::less<> allows lookups by NodePath
+    std::map<std::string, std::vector<std::string>, std::less<>> fileTags;
 };
 
 #endif // VIRTUALFILESYSTEM_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "FileStatsPlugin.h"
+#include "../include/TreeIterator.h"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -57,25 +58,34 @@ void FileStatsPlugin::cmdFileStats(Shell* shell, const std::vector<std::string>&
     }
     
     size_t fileSize = node->getSize();
-    std::string content = vfs.cat(path);
+    // One pass over the extents as they are stored, without joining them
+    std::vector<ContentView> content = node->getContentViews();
     size_t lineCount = 0;
     size_t wordCount = 0;
-    size_t charCount = content.length();
+    size_t charCount = 0;
+    char last = '\0';
     
-    // Count lines and words
+    // Count lines, words and character frequencies
     bool inWord = false;
-    for (char c : content) {
-        if (c == '\n') {
-            lineCount++;
-        }
-        
-        if (std::isspace(c)) {
-            if (inWord) {
-                inWord = false;
-                wordCount++;
+    std::unordered_map<char, int> charFreq;
+    for (const ContentView& extent : content) {
+        charCount += extent.size();
+        for (char c : extent.view()) {
+            if (c == '\n') {
+                lineCount++;
+            }
+            
+            if (std::isspace(c)) {
+                if (inWord) {
+                    inWord = false;
+                    wordCount++;
+                }
+            } else {
+                inWord = true;
             }
-        } else {
-            inWord = true;
+            
+            charFreq[c]++;
+            last = c;
         }
     }
     
@@ -84,26 +94,22 @@ void FileStatsPlugin::cmdFileStats(Shell* shell, const std::vector<std::string>&
     }
     
     // If content doesn't end with newline, add one to line count
-    if (!content.empty() && content.back() != '\n') {
+    if (charCount > 0 && last != '\n') {
         lineCount++;
     }
     
-    // Count character frequencies
-    std::unordered_map<char, int> charFreq;
-    for (char c : content) {
-        charFreq[c]++;
-    }
-    
     std::cout << "File statistics for: " << path << std::endl;
     std::cout << "------------------------------------------------------" << std::endl;
     std::cout << "Size:           " << formatFileSize(fileSize) << " (" << fileSize << " bytes)" << std::endl;
+    std::cout << "Stored size:    " << formatFileSize(node->getStoredSize()) << " (" << node->getStoredSize() << " bytes)" << std::endl;
     std::cout << "File type:      " << getFileType(path, vfs) << std::endl;
     std::cout << "Line count:     " << lineCount << std::endl;
     std::cout << "Word count:     " << wordCount << std::endl;
     std::cout << "Character count: " << charCount << std::endl;
     std::cout << "Is compressed:  " << (node->isCompressed() ? "Yes" : "No") << std::endl;
     std::cout << "Is encrypted:   " << (node->isEncrypted() ? "Yes" : "No") << std::endl;
-    std::cout << "Versions:       " << node->getVersionCount() << std::endl;
+    std::cout << "Versions:       " << node->getVersionCount() << " ("
+              << formatFileSize(node->getVersionStoredSize()) << " stored)" << std::endl;
     
     std::cout << "\nTop 5 most frequent characters:" << std::endl;
     std::vector<std::pair<char, int>> sortedFreq(charFreq.begin(), charFreq.end());
@@ -155,30 +161,17 @@ void FileStatsPlugin::cmdDiskUsage(Shell* shell, const std::vector<std::string>&
         return;
     }
     
-    // Function to recursively calculate directory size
-    std::function<size_t(FileNode*, std::map<std::string, size_t>&, const std::string&)> calcDirSize = 
-    [&](FileNode* node, std::map<std::string, size_t>& dirSizes, const std::string& currentPath) -> size_t {
-        size_t totalSize = 0;
-        
-        if (node->isDirectory()) {
-            std::vector<std::unique_ptr<FileNode>>& children = node->getChildren();
-            
-            for (size_t i = 0; i < children.size(); ++i) {
-                std::string childName = children[i]->getName();
-                std::string childPath = currentPath.empty() ? childName : currentPath + "/" + childName;
-                totalSize += calcDirSize(children[i].get(), dirSizes, childPath);
-            }
-            
-            dirSizes[currentPath] = totalSize;
-        } else {
-            totalSize = node->getSize();
-        }
-        
-        return totalSize;
-    };
-    
+    // Directories carry rolled-up totals, so only directories are visited
+    // and no file sizes are summed here
     std::map<std::string, size_t> dirSizes;
-    size_t totalSize = calcDirSize(rootNode, dirSizes, path == "." ? "" : path);
+    TreeIterator walk(rootNode);
+    walk.setDirectoriesOnly(true);
+    walk.trackPath(path == "." ? "" : path);
+    for (; !walk.done(); walk.next()) {
+        dirSizes[walk.path()] = walk.node()->getTotals().logicalBytes;
+    }
+    const FileNode::Totals& totals = rootNode->getTotals();
+    size_t totalSize = totals.logicalBytes;
     
     // Convert to vector for sorting
     std::vector<std::pair<std::string, size_t>> sortedDirs(dirSizes.begin(), dirSizes.end());
@@ -199,7 +192,9 @@ void FileStatsPlugin::cmdDiskUsage(Shell* shell, const std::vector<std::string>&
     }
     
     std::cout << "------------------------------------------------------" << std::endl;
-    std::cout << "Total: " << formatFileSize(totalSize) << std::endl;
+    std::cout << "Total: " << formatFileSize(totalSize) << " in " << totals.files << " file(s), "
+              << (totals.directories - 1) << " subdirectory(ies)" << std::endl;
+    std::cout << "Stored: " << formatFileSize(totals.storedBytes) << std::endl;
 }
 
 void FileStatsPlugin::cmdFindDuplicates(Shell* shell, const std::vector<std::string>& args) {
@@ -207,47 +202,27 @@ void FileStatsPlugin::cmdFindDuplicates(Shell* shell, const std::vector<std::str
     VirtualFileSystem& vfs = shell->getVFS();
     
     // Group files by size first (quick filter for potential duplicates)
-    std::map<size_t, std::vector<std::string>> filesBySize;
+    std::map<size_t, std::vector<std::pair<std::string, const FileNode*>>> filesBySize;
     
-    // Function to recursively scan directories
-    std::function<void(const std::string&)> scanDir = [&](const std::string& dirPath) {
-        std::vector<std::string> entries = vfs.ls(dirPath);
-        
-        for (const auto& entry : entries) {
-            // Remove trailing / or @ if present
-            std::string entryName = entry;
-            bool isDir = false;
-            
-            if (entryName.back() == '/') {
-                isDir = true;
-                entryName.pop_back();
-            } else if (entryName.back() == '@') {
-                // Skip mount points
-                continue;
-            }
-            
-            // Build full path
-            std::string fullPath = dirPath == "." ? entryName : dirPath + "/" + entryName;
-            FileNode* node = vfs.resolvePath(fullPath);
-            
-            if (!node) {
-                continue; // Skip if not found
-            }
-            
-            if (isDir || node->isDirectory()) {
-                // Recurse into directories
-                scanDir(fullPath);
-            } else {
-                // Add file to the size map
-                size_t fileSize = node->getSize();
-                if (fileSize > 0) { // Skip empty files
-                    filesBySize[fileSize].push_back(fullPath);
-                }
+    FileNode* startNode = vfs.resolvePath(path);
+    if (!startNode || !startNode->isDirectory()) {
+        std::cout << "Directory not found: " << path << std::endl;
+        return;
+    }
+    
+    TreeIterator walk(startNode);
+    walk.trackPath(path == "." ? "" : path);
+    for (; !walk.done(); walk.next()) {
+        const FileNode* node = walk.node();
+        if (node->isDirectory()) {
+            if (node != startNode && vfs.isMountPoint(walk.path())) {
+                walk.prune(); // Skip mount points
             }
+        } else if (node->getSize() > 0) { // Skip empty files
+            // Add file to the size map
+            filesBySize[node->getSize()].emplace_back(walk.path(), node);
         }
-    };
-    
-    scanDir(path);
+    }
     
     // Check for duplicates
     std::map<std::string, std::vector<std::string>> duplicateGroups;
@@ -259,18 +234,20 @@ void FileStatsPlugin::cmdFindDuplicates(Shell* shell, const std::vector<std::str
             continue; // Skip unique file sizes
         }
         
-        // For files of the same size, compare content
-        std::map<std::string, std::vector<std::string>> contentGroups;
+        // For files of the same size, compare content; the views borrow
+        // plain files' buffers, so grouping copies nothing
+        std::vector<ContentView> contents;
+        std::map<std::string_view, std::vector<std::string>> contentGroups;
         
-        for (const auto& filePath : sizeGroup.second) {
-            std::string content = vfs.cat(filePath);
-            contentGroups[content].push_back(filePath);
+        for (const auto& [filePath, node] : sizeGroup.second) {
+            contents.push_back(node->getContentView());
+            contentGroups[contents.back().view()].push_back(filePath);
         }
         
         // Check which files have identical content
         for (const auto& contentGroup : contentGroups) {
             if (contentGroup.second.size() > 1) {
-                std::string hash = std::to_string(std::hash<std::string>{}(contentGroup.first));
+                std::string hash = std::to_string(std::hash<std::string_view>{}(contentGroup.first));
                 duplicateGroups[hash] = contentGroup.second;
                 duplicateCount += contentGroup.second.size() - 1;
                 wastedSpace += (contentGroup.second.size() - 1) * sizeGroup.first;
@@ -324,16 +301,15 @@ std::string FileStatsPlugin::getFileType(const std::string& path, VirtualFileSys
         extension = path.substr(dotPos + 1);
     }
     
-    std::string content = vfs.cat(path);
-    if (content.empty()) {
+    // Check for binary content (sample the first 1000 bytes)
+    std::string sample;
+    if (!vfs.read(path, 0, 1000, sample) || sample.empty()) {
         return "Empty file";
     }
     
-    // Check for binary content (sample the first 1000 bytes)
-    size_t sampleSize = std::min(content.size(), static_cast<size_t>(1000));
     bool isBinary = false;
-    for (size_t i = 0; i < sampleSize; ++i) {
-        char c = content[i];
+    for (size_t i = 0; i < sample.size(); ++i) {
+        char c = sample[i];
         if (c == 0 || (c < 32 && c != '\n' && c != '\r' && c != '\t' && c != '\b')) {
             isBinary = true;
             break;
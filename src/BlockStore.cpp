@@ -0,0 +1,225 @@
+#include "../include/BlockStore.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const std::array<uint64_t, 256>& gearTable() {
+    // Fixed pseudo-random table (splitmix64) so chunk boundaries are stable
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> values{};
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (auto& value : values) {
+            state += 0x9E3779B97F4A7C15ull;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+const uint32_t kSha256Constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint32_t rotateRight(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+void sha256Block(uint32_t state[8], const unsigned char* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+               (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + kSha256Constants[i] + w[i];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+} // namespace
+
+BlockStore::BlockStore()
+    : index(std::make_shared<Index>()), chargedBytes(0), enabled(false) {
+}
+
+std::shared_ptr<const std::string> BlockStore::intern(std::string payload) {
+    Digest digest = sha256(payload);
+    std::lock_guard<std::mutex> guard(index->mutex);
+    index->lookups++;
+    
+    auto it = index->blocks.find(digest);
+    if (it != index->blocks.end()) {
+        if (auto block = it->second.lock()) {
+            index->hits++;
+            return block;
+        }
+    }
+    
+    std::weak_ptr<Index> weakIndex = index;
+    std::shared_ptr<const std::string> block(
+        new std::string(std::move(payload)),
+        [weakIndex, digest](const std::string* data) {
+            // Garbage collection: the last reference drops the index entry
+            if (auto owner = weakIndex.lock()) {
+                std::lock_guard<std::mutex> guard(owner->mutex);
+                // The entry may already point at a replacement, interned by
+                // another thread after this block expired but before it got
+                // here; the bytes of this block were counted all the same
+                owner->uniqueBytes -= data->size();
+                auto entry = owner->blocks.find(digest);
+                if (entry != owner->blocks.end() && entry->second.expired()) {
+                    owner->blocks.erase(entry);
+                }
+            }
+            delete data;
+        });
+    
+    index->blocks[digest] = block;
+    index->uniqueBytes += block->size();
+    return block;
+}
+
+BlockStore::Stats BlockStore::getStats() const {
+    std::lock_guard<std::mutex> guard(index->mutex);
+    Stats stats;
+    stats.blocks = index->blocks.size();
+    stats.uniqueBytes = index->uniqueBytes;
+    stats.lookups = index->lookups;
+    stats.hits = index->hits;
+    stats.chargedBytes = chargedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+BlockStore::ChargeShard& BlockStore::shardOf(const std::string* payload) {
+    // Buffers are heap allocations, so the low bits carry no information
+    auto address = reinterpret_cast<uintptr_t>(payload);
+    return charges[(address >> 6) % kChargeShards];
+}
+
+size_t BlockStore::reference(const std::string* payload) {
+    ChargeShard& shard = shardOf(payload);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    if (shard.references[payload]++ > 0) {
+        return 0;
+    }
+    chargedBytes.fetch_add(payload->size(), std::memory_order_relaxed);
+    return payload->size();
+}
+
+size_t BlockStore::release(const std::string* payload) {
+    // The caller still holds the buffer, so its address can't have been reused
+    ChargeShard& shard = shardOf(payload);
+    std::lock_guard<std::mutex> guard(shard.mutex);
+    auto it = shard.references.find(payload);
+    if (it == shard.references.end() || --it->second > 0) {
+        return 0;
+    }
+    shard.references.erase(it);
+    chargedBytes.fetch_sub(payload->size(), std::memory_order_relaxed);
+    return payload->size();
+}
+
+std::vector<size_t> BlockStore::chunkLengths(std::string_view data, size_t maxChunk) {
+    const auto& gear = gearTable();
+    std::vector<size_t> lengths;
+    
+    size_t start = 0;
+    while (start < data.size()) {
+        size_t remaining = data.size() - start;
+        size_t limit = std::min(remaining, maxChunk);
+        size_t length = limit;
+        
+        uint64_t hash = 0;
+        for (size_t i = kMinChunk; i < limit; ++i) {
+            hash = (hash << 1) + gear[static_cast<unsigned char>(data[start + i])];
+            if ((hash & kBoundaryMask) == 0) {
+                length = i + 1;
+                break;
+            }
+        }
+        
+        lengths.push_back(length);
+        start += length;
+    }
+    
+    return lengths;
+}
+
+BlockStore::Digest BlockStore::sha256(std::string_view data) {
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64) {
+        sha256Block(state, bytes + i);
+    }
+    
+    // Final block(s): remaining bytes, 0x80, zero padding, bit length
+    unsigned char tail[128] = {};
+    size_t rest = data.size() - full;
+    std::memcpy(tail, bytes + full, rest);
+    tail[rest] = 0x80;
+    size_t tailSize = rest + 1 + 8 <= 64 ? 64 : 128;
+    uint64_t bitLength = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[tailSize - 1 - i] = static_cast<unsigned char>(bitLength >> (i * 8));
+    }
+    for (size_t i = 0; i < tailSize; i += 64) {
+        sha256Block(state, tail + i);
+    }
+    
+    Digest digest;
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+size_t BlockStore::DigestHash::operator()(const Digest& digest) const {
+    // The digest is already uniformly distributed
+    size_t value;
+    std::memcpy(&value, digest.data(), sizeof(value));
+    return value;
+}
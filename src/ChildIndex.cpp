@@ -0,0 +1,127 @@
+#include "../include/ChildIndex.h"
+#include "../include/FileNode.h"
+
+ChildIndex::ChildIndex(size_t capacity)
+    : entryCapacity(std::max(capacity, kMinCapacity)), slotMask(0), used(0), live(0) {
+    entries.reset(new Entry[entryCapacity]());
+    if (entryCapacity <= kFlatLimit) {
+        return;
+    }
+
+    // Slots are never reused within one index, so twice as many slots as
+    // entries keeps the load factor at or below 1/2 and probe chains short
+    size_t slotCount = 8;
+    while (slotCount < entryCapacity * 2) {
+        slotCount <<= 1;
+    }
+    slotMask = slotCount - 1;
+    slots.reset(new std::atomic<uint32_t>[slotCount]());
+}
+
+ChildIndex::ChildIndex(const ChildIndex& other, const Children& children, size_t capacity)
+    : ChildIndex(std::max(capacity, other.live)) {
+    for (size_t i = 0; i < other.end(); ++i) {
+        if (other.child(i)) {
+            const Entry& entry = other.entries[i];
+            insert(children[entry.position].get(), entry.name, entry.hash, entry.position);
+        }
+    }
+}
+
+FileNode* ChildIndex::find(std::string_view name, size_t hash, const NameTable& names) const {
+    if (!slots) {
+        for (size_t i = 0, count = end(); i < count; ++i) {
+            const Entry& entry = entries[i];
+            if (entry.hash == hash) {
+                FileNode* child = entry.node.load(std::memory_order_acquire);
+                if (child && names.text(entry.name) == name) {
+                    return child;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    for (size_t i = hash & slotMask;; i = (i + 1) & slotMask) {
+        uint32_t slot = slots[i].load(std::memory_order_acquire);
+        if (slot == kEmpty) {
+            return nullptr;
+        }
+
+        const Entry& entry = entries[slot - 1];
+        if (entry.hash == hash) {
+            FileNode* child = entry.node.load(std::memory_order_acquire);
+            if (child && names.text(entry.name) == name) {
+                return child;
+            }
+        }
+    }
+}
+
+bool ChildIndex::insert(FileNode* child, NameTable::NameId name, size_t hash, size_t position) {
+    size_t index = used.load(std::memory_order_relaxed);
+    if (index == entryCapacity) {
+        return false;
+    }
+
+    // The entry is complete before its slot is published, and the slot
+    // before the entry count, so readers coming from either side see it whole
+    Entry& entry = entries[index];
+    entry.hash = hash;
+    entry.name = name;
+    entry.position = static_cast<uint32_t>(position);
+    entry.node.store(child, std::memory_order_release);
+
+    if (slots) {
+        size_t i = hash & slotMask;
+        while (slots[i].load(std::memory_order_relaxed) != kEmpty) {
+            i = (i + 1) & slotMask;
+        }
+        slots[i].store(static_cast<uint32_t>(index + 1), std::memory_order_release);
+    }
+
+    used.store(index + 1, std::memory_order_release);
+    ++live;
+    return true;
+}
+
+size_t ChildIndex::erase(const FileNode* child, size_t hash) {
+    size_t index = locate(child, hash);
+    if (index == npos) {
+        return npos;
+    }
+
+    // The slot stays, pointing at a dead entry, so probe chains through it
+    // remain intact for readers
+    entries[index].node.store(nullptr, std::memory_order_release);
+    --live;
+    return entries[index].position;
+}
+
+void ChildIndex::relocate(const FileNode* child, size_t hash, size_t position) {
+    size_t index = locate(child, hash);
+    if (index != npos) {
+        entries[index].position = static_cast<uint32_t>(position);
+    }
+}
+
+size_t ChildIndex::locate(const FileNode* child, size_t hash) const {
+    if (!slots) {
+        for (size_t i = 0, count = used.load(std::memory_order_relaxed); i < count; ++i) {
+            if (entries[i].node.load(std::memory_order_relaxed) == child) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    for (size_t i = hash & slotMask;; i = (i + 1) & slotMask) {
+        uint32_t slot = slots[i].load(std::memory_order_relaxed);
+        if (slot == kEmpty) {
+            return npos;
+        }
+        if (entries[slot - 1].node.load(std::memory_order_relaxed) == child) {
+            return slot - 1;
+        }
+    }
+}
@@ -11,7 +11,9 @@ std::string RLECompression::compress(const std::string& input) const {
         return "";
     }
     
-    std::string result;
+    // The first byte says whether runs follow or the input is stored as
+    // is; plain input can look like runs, so decompress() can't guess
+    std::string result(1, kRuns);
     char current = input[0];
     int count = 1;
     
@@ -30,7 +32,10 @@ std::string RLECompression::compress(const std::string& input) const {
     result.push_back(current);
     
     // Only use compressed version if it's smaller
-    return (result.size() < input.size()) ? result : input;
+    if (result.size() <= input.size()) {
+        return result;
+    }
+    return std::string(1, kStored) + input;
 }
 
 std::string RLECompression::decompress(const std::string& input) const {
@@ -38,15 +43,13 @@ std::string RLECompression::decompress(const std::string& input) const {
         return "";
     }
     
-    // Quick check to see if the data was actually compressed
-    // If input length is odd, it wasn't RLE compressed
-    if (input.length() % 2 != 0) {
-        return input;
+    if (input[0] != kRuns) {
+        return input.substr(1);
     }
     
     std::string result;
     
-    for (size_t i = 0; i < input.length(); i += 2) {
+    for (size_t i = 1; i < input.length(); i += 2) {
         if (i + 1 < input.length()) {
             int count = static_cast<unsigned char>(input[i]);
             char c = input[i + 1];
@@ -67,9 +70,14 @@ std::shared_ptr<HuffmanCompression::HuffmanNode> HuffmanCompression::buildHuffma
         freqMap[c]++;
     }
     
+    // Lowest frequency first; std::greater on the shared_ptrs themselves
+    // would order the nodes by address
+    auto byFrequency = [](const std::shared_ptr<HuffmanNode>& a, const std::shared_ptr<HuffmanNode>& b) {
+        return *a > *b;
+    };
     std::priority_queue<std::shared_ptr<HuffmanNode>, 
                        std::vector<std::shared_ptr<HuffmanNode>>, 
-                       std::greater<std::shared_ptr<HuffmanNode>>> pq;
+                       decltype(byFrequency)> pq(byFrequency);
     
     for (const auto& pair : freqMap) {
         pq.push(std::make_shared<HuffmanNode>(pair.first, pair.second));
@@ -240,7 +248,12 @@ std::string HuffmanCompression::decompress(const std::string& input) const {
     if (!root) {
         return input;
     }
-    
+
+    // A single-symbol input is encoded as one '0' bit per character
+    if (!root->left && !root->right) {
+        return std::string(encodedBitsCount, root->ch);
+    }
+
     // Convert bytes to binary string
     std::string encodedBits;
     for (size_t i = index; i < input.size(); ++i) {
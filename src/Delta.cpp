@@ -0,0 +1,162 @@
+#include "../include/Delta.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+constexpr char kCopyOp = 'C';
+constexpr char kInsertOp = 'I';
+constexpr uint64_t kHashBase = 1099511628211ull;
+
+uint64_t hashBlock(const char* data, size_t length) {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < length; ++i) {
+        hash = hash * kHashBase + static_cast<unsigned char>(data[i]);
+    }
+    return hash;
+}
+
+} // namespace
+
+std::string DeltaCodec::encode(const std::string& base, const std::string& target) {
+    std::string out;
+    
+    // Most edits are local, so trim the common prefix and suffix first
+    size_t limit = std::min(base.size(), target.size());
+    size_t prefix = 0;
+    while (prefix < limit && base[prefix] == target[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < limit - prefix &&
+           base[base.size() - 1 - suffix] == target[target.size() - 1 - suffix]) {
+        suffix++;
+    }
+    
+    writeCopy(out, 0, prefix);
+    
+    // Index the base's middle in aligned blocks, then slide a rolling hash
+    // over the target's middle looking for blocks that can be copied
+    size_t baseEnd = base.size() - suffix;
+    size_t targetEnd = target.size() - suffix;
+    
+    std::unordered_map<uint64_t, size_t> blocks;
+    for (size_t pos = prefix; pos + kBlockSize <= baseEnd; pos += kBlockSize) {
+        blocks.emplace(hashBlock(base.data() + pos, kBlockSize), pos);
+    }
+    
+    uint64_t highPower = 1;
+    for (size_t i = 1; i < kBlockSize; ++i) {
+        highPower *= kHashBase;
+    }
+    
+    size_t literalStart = prefix;
+    size_t pos = prefix;
+    uint64_t hash = 0;
+    bool hashValid = false;
+    
+    while (!blocks.empty() && pos + kBlockSize <= targetEnd) {
+        if (!hashValid) {
+            hash = hashBlock(target.data() + pos, kBlockSize);
+            hashValid = true;
+        }
+        
+        auto it = blocks.find(hash);
+        if (it != blocks.end() &&
+            std::memcmp(base.data() + it->second, target.data() + pos, kBlockSize) == 0) {
+            // Extend the match in both directions as far as it goes
+            size_t matchBase = it->second;
+            size_t matchTarget = pos;
+            size_t length = kBlockSize;
+            while (matchBase > prefix && matchTarget > literalStart &&
+                   base[matchBase - 1] == target[matchTarget - 1]) {
+                matchBase--;
+                matchTarget--;
+                length++;
+            }
+            while (matchBase + length < baseEnd && matchTarget + length < targetEnd &&
+                   base[matchBase + length] == target[matchTarget + length]) {
+                length++;
+            }
+            
+            writeInsert(out, target.data() + literalStart, matchTarget - literalStart);
+            writeCopy(out, matchBase, length);
+            
+            pos = matchTarget + length;
+            literalStart = pos;
+            hashValid = false;
+            continue;
+        }
+        
+        if (pos + kBlockSize < targetEnd) {
+            hash -= highPower * static_cast<unsigned char>(target[pos]);
+            hash = hash * kHashBase + static_cast<unsigned char>(target[pos + kBlockSize]);
+        }
+        pos++;
+    }
+    
+    writeInsert(out, target.data() + literalStart, targetEnd - literalStart);
+    writeCopy(out, baseEnd, suffix);
+    return out;
+}
+
+std::string DeltaCodec::apply(const std::string& base, const std::string& delta) {
+    std::string result;
+    size_t pos = 0;
+    
+    while (pos < delta.size()) {
+        char op = delta[pos++];
+        if (op == kCopyOp) {
+            size_t offset = readVarint(delta, pos);
+            size_t length = readVarint(delta, pos);
+            result.append(base, offset, length);
+        } else {
+            size_t length = readVarint(delta, pos);
+            result.append(delta, pos, length);
+            pos += length;
+        }
+    }
+    
+    return result;
+}
+
+void DeltaCodec::writeCopy(std::string& out, size_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    out.push_back(kCopyOp);
+    writeVarint(out, offset);
+    writeVarint(out, length);
+}
+
+void DeltaCodec::writeInsert(std::string& out, const char* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    out.push_back(kInsertOp);
+    writeVarint(out, length);
+    out.append(data, length);
+}
+
+void DeltaCodec::writeVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t DeltaCodec::readVarint(const std::string& in, size_t& pos) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (pos < in.size()) {
+        unsigned char byte = static_cast<unsigned char>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
@@ -0,0 +1,168 @@
+#include "../include/DentryCache.h"
+#include <functional>
+
+DentryCache::DentryCache(size_t capacity)
+    : head(kNone), tail(kNone), capacity(capacity) {
+}
+
+size_t DentryCache::keyOf(const FileNode* parent, size_t hash) {
+    return hash ^ (std::hash<const FileNode*>()(parent) * 0x9E3779B97F4A7C15ull);
+}
+
+uint32_t DentryCache::find(const FileNode* parent, std::string_view name, size_t hash) const {
+    auto range = byKey.equal_range(keyOf(parent, hash));
+    for (auto it = range.first; it != range.second; ++it) {
+        const Entry& entry = entries[it->second];
+        if (entry.parent == parent && entry.hash == hash && entry.name == name) {
+            return it->second;
+        }
+    }
+    return kNone;
+}
+
+bool DentryCache::lookup(const FileNode* parent, std::string_view name, size_t hash, FileNode*& node) {
+    uint32_t slot = find(parent, name, hash);
+    if (slot == kNone) {
+        stats.misses++;
+        return false;
+    }
+    
+    // Move to the front of the LRU list
+    if (slot != head) {
+        unlink(slot);
+        link(slot);
+    }
+    
+    node = entries[slot].node;
+    stats.hits++;
+    if (!node) {
+        stats.negativeHits++;
+    }
+    return true;
+}
+
+void DentryCache::insert(const FileNode* parent, std::string_view name, size_t hash, FileNode* node) {
+    if (capacity == 0) {
+        return;
+    }
+    
+    uint32_t slot = find(parent, name, hash);
+    if (slot != kNone) {
+        entries[slot].node = node;
+        return;
+    }
+    
+    if (byKey.size() >= capacity) {
+        erase(tail);
+        stats.evictions++;
+    }
+    
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        entries[slot] = Entry{parent, hash, std::string(name), node, kNone, kNone};
+    } else {
+        slot = static_cast<uint32_t>(entries.size());
+        entries.push_back(Entry{parent, hash, std::string(name), node, kNone, kNone});
+    }
+    
+    link(slot);
+    byKey.emplace(keyOf(parent, hash), slot);
+    byParent.emplace(parent, slot);
+}
+
+void DentryCache::invalidate(const FileNode* parent, std::string_view name, size_t hash) {
+    uint32_t slot = find(parent, name, hash);
+    if (slot != kNone) {
+        erase(slot);
+        stats.invalidations++;
+    }
+}
+
+void DentryCache::invalidateChildren(const FileNode* parent) {
+    auto range = byParent.equal_range(parent);
+    std::vector<uint32_t> slots;
+    for (auto it = range.first; it != range.second; ++it) {
+        slots.push_back(it->second);
+    }
+    
+    for (uint32_t slot : slots) {
+        erase(slot);
+        stats.invalidations++;
+    }
+}
+
+void DentryCache::clear() {
+    stats.invalidations += byKey.size();
+    entries.clear();
+    freeSlots.clear();
+    byKey.clear();
+    byParent.clear();
+    head = kNone;
+    tail = kNone;
+}
+
+void DentryCache::setCapacity(size_t newCapacity) {
+    capacity = newCapacity;
+    while (byKey.size() > capacity) {
+        erase(tail);
+        stats.evictions++;
+    }
+}
+
+DentryCache::Stats DentryCache::getStats() const {
+    Stats result = stats;
+    result.entries = byKey.size();
+    result.capacity = capacity;
+    return result;
+}
+
+void DentryCache::link(uint32_t slot) {
+    Entry& entry = entries[slot];
+    entry.prev = kNone;
+    entry.next = head;
+    if (head != kNone) {
+        entries[head].prev = slot;
+    }
+    head = slot;
+    if (tail == kNone) {
+        tail = slot;
+    }
+}
+
+void DentryCache::unlink(uint32_t slot) {
+    Entry& entry = entries[slot];
+    if (entry.prev != kNone) {
+        entries[entry.prev].next = entry.next;
+    } else {
+        head = entry.next;
+    }
+    if (entry.next != kNone) {
+        entries[entry.next].prev = entry.prev;
+    } else {
+        tail = entry.prev;
+    }
+}
+
+void DentryCache::erase(uint32_t slot) {
+    Entry& entry = entries[slot];
+    unlink(slot);
+    
+    auto range = byKey.equal_range(keyOf(entry.parent, entry.hash));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == slot) {
+            byKey.erase(it);
+            break;
+        }
+    }
+    auto parents = byParent.equal_range(entry.parent);
+    for (auto it = parents.first; it != parents.second; ++it) {
+        if (it->second == slot) {
+            byParent.erase(it);
+            break;
+        }
+    }
+    
+    entry.name.clear();
+    freeSlots.push_back(slot);
+}
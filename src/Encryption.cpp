@@ -68,6 +68,15 @@ std::string CaesarCipher::decrypt(const std::string& input, const std::string& k
 }
 
 // Vigenere Cipher Implementation
+
+// Shift for one key character: a letter's position in the alphabet.
+// Other characters are reduced into 0-25 too, so keys with digits or
+// spaces still decrypt what they encrypted
+static int shiftOf(char keyChar) {
+    int shift = (tolower(static_cast<unsigned char>(keyChar)) - 'a') % 26;
+    return shift < 0 ? shift + 26 : shift;
+}
+
 std::string VigenereCipher::encrypt(const std::string& input, const std::string& key) const {
     if (input.empty() || key.empty()) {
         return input;
@@ -79,7 +88,7 @@ std::string VigenereCipher::encrypt(const std::string& input, const std::string&
     for (size_t i = 0; i < result.size(); ++i) {
         if (isalpha(result[i])) {
             char base = islower(result[i]) ? 'a' : 'A';
-            char keyChar = tolower(key[keyIndex % key.size()]) - 'a';
+            int keyChar = shiftOf(key[keyIndex % key.size()]);
             result[i] = static_cast<char>((result[i] - base + keyChar) % 26 + base);
             keyIndex++;
         }
@@ -99,7 +108,7 @@ std::string VigenereCipher::decrypt(const std::string& input, const std::string&
     for (size_t i = 0; i < result.size(); ++i) {
         if (isalpha(result[i])) {
             char base = islower(result[i]) ? 'a' : 'A';
-            char keyChar = tolower(key[keyIndex % key.size()]) - 'a';
+            int keyChar = shiftOf(key[keyIndex % key.size()]);
             result[i] = static_cast<char>((result[i] - base - keyChar + 26) % 26 + base);
             keyIndex++;
         }
@@ -153,6 +162,11 @@ std::vector<unsigned char> AESEncryption::processBlock(const std::vector<unsigne
     std::vector<unsigned char> result = block;
     
     for (size_t i = 0; i < result.size(); ++i) {
+        // Decryption undoes the key addition before the substitution
+        if (!encrypt) {
+            result[i] ^= key[i % key.size()];
+        }
+        
         // Apply S-box or inverse S-box based on encrypt/decrypt
         unsigned char nibbleHigh = (result[i] >> 4) & 0xF;
         unsigned char nibbleLow = result[i] & 0xF;
@@ -169,7 +183,9 @@ std::vector<unsigned char> AESEncryption::processBlock(const std::vector<unsigne
         result[i] = (nibbleHigh << 4) | nibbleLow;
         
         // XOR with key (simplified key addition)
-        result[i] ^= key[i % key.size()];
+        if (encrypt) {
+            result[i] ^= key[i % key.size()];
+        }
     }
     
     return result;
@@ -0,0 +1,214 @@
+#include "../include/Epoch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Stands in for the domain of a thread inside guards of several domains
+const Epoch::Domain kAnyDomain = reinterpret_cast<Epoch::Domain>(static_cast<uintptr_t>(-1));
+
+// Retirements a thread collects before it advances the epoch
+constexpr size_t kBatchSize = 64;
+
+struct Retired {
+    uint64_t epoch; // The epoch it was unlinked in; safe once no guard is that old
+    Epoch::Domain domain;
+    std::function<void()> reclaim;
+};
+
+// One per thread that has ever entered a guard or retired something, on a
+// cache line of its own
+struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{0}; // 0 while the thread is outside any guard
+    std::atomic<Epoch::Domain> domain{nullptr}; // Of the open guards
+    std::atomic<bool> taken{false};
+    Slot* next = nullptr;
+
+    // Retired by this thread and not yet run. Only synchronize() reaches
+    // into other threads' lists, so the lock is practically never contended
+    std::mutex limboMutex;
+    std::vector<Retired> limbo;
+    size_t collectAt = kBatchSize; // Limbo size that triggers the next collection
+    std::atomic<unsigned> running{0}; // Batches taken from limbo and still being run
+};
+
+struct State {
+    std::atomic<uint64_t> global{1};
+    std::atomic<Slot*> slots{nullptr}; // Only ever grows; slots of exited threads are reused
+};
+
+State& state() {
+    // Intentionally leaked, so guards and retirements still work during
+    // static destruction
+    static State* instance = new State();
+    return *instance;
+}
+
+Slot* acquireSlot() {
+    State& s = state();
+    for (Slot* slot = s.slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->taken.load(std::memory_order_relaxed) &&
+            slot->taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+
+    Slot* slot = new Slot();
+    slot->taken.store(true, std::memory_order_relaxed);
+    slot->next = s.slots.load(std::memory_order_relaxed);
+    while (!s.slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return slot;
+}
+
+// The calling thread's slot, handed back when the thread exits. Whatever
+// it retired stays in the slot for the next owner or synchronize() to run
+struct ThreadSlot {
+    Slot* slot = nullptr;
+    unsigned depth = 0;
+
+    Slot* get() {
+        if (!slot) {
+            slot = acquireSlot();
+        }
+        return slot;
+    }
+
+    ~ThreadSlot() {
+        if (slot) {
+            slot->taken.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadSlot current;
+
+// Oldest epoch any open guard was entered in, or epoch if there is none
+uint64_t oldestActive(uint64_t epoch) {
+    uint64_t oldest = epoch;
+    for (Slot* slot = state().slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+        uint64_t entered = slot->epoch.load();
+        if (entered != 0 && entered < oldest) {
+            oldest = entered;
+        }
+    }
+    return oldest;
+}
+
+// Moves the entries of slot's limbo for which keep is false into ready
+template <typename Predicate>
+void takeRetired(Slot* slot, std::vector<Retired>& ready, Predicate keep) {
+    auto middle = std::partition(slot->limbo.begin(), slot->limbo.end(), keep);
+    std::move(middle, slot->limbo.end(), std::back_inserter(ready));
+    slot->limbo.erase(middle, slot->limbo.end());
+}
+
+void run(std::vector<Retired>& ready) {
+    // Outside of any limbo lock, since reclaimers may retire in turn
+    for (Retired& retired : ready) {
+        retired.reclaim();
+    }
+}
+
+} // namespace
+
+Epoch::Guard::Guard(Domain domain) {
+    Slot* slot = current.get();
+    if (current.depth++ > 0) {
+        if (slot->domain.load(std::memory_order_relaxed) != domain) {
+            // Announced before anything of the new domain is read
+            slot->domain.store(kAnyDomain);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        return;
+    }
+
+    // Announce the epoch, then check it is still current: a reclaimer that
+    // advanced it in between may not have seen the announcement
+    State& s = state();
+    slot->domain.store(domain);
+    uint64_t epoch = s.global.load();
+    for (;;) {
+        slot->epoch.store(epoch);
+        uint64_t now = s.global.load();
+        if (now == epoch) {
+            break;
+        }
+        epoch = now;
+    }
+}
+
+Epoch::Guard::~Guard() {
+    if (--current.depth == 0) {
+        current.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Epoch::retire(Domain domain, std::function<void()> reclaim) {
+    State& s = state();
+    Slot* slot = current.get();
+    {
+        std::lock_guard<std::mutex> guard(slot->limboMutex);
+        slot->limbo.push_back(Retired{s.global.load(), domain, std::move(reclaim)});
+        if (slot->limbo.size() < slot->collectAt) {
+            return;
+        }
+    }
+
+    // A full batch: move the epoch on once and run what no guard can reach
+    uint64_t oldest = oldestActive(s.global.fetch_add(1) + 1);
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> guard(slot->limboMutex);
+        takeRetired(slot, ready, [oldest](const Retired& retired) { return retired.epoch >= oldest; });
+        // Long-lived guards keep entries back; don't rescan for each retire
+        slot->collectAt = slot->limbo.size() + kBatchSize;
+        slot->running.fetch_add(1, std::memory_order_relaxed);
+    }
+    run(ready);
+    slot->running.fetch_sub(1, std::memory_order_release);
+}
+
+void Epoch::synchronize(Domain domain) {
+    State& s = state();
+    uint64_t epoch = s.global.fetch_add(1) + 1;
+
+    // Only guards of this domain are waited for; a slot is read epoch first,
+    // so a domain seen with a current epoch belongs to that guard
+    for (Slot* slot = s.slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+        unsigned attempts = 0;
+        for (;;) {
+            uint64_t entered = slot->epoch.load();
+            Domain owner = slot->domain.load();
+            if (entered == 0 || entered >= epoch || (owner != domain && owner != kAnyDomain)) {
+                break;
+            }
+            if (++attempts > 16) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // A batch some thread already took may hold entries of this domain too,
+    // and the caller may be about to free what they refer to
+    std::vector<Retired> ready;
+    for (Slot* slot = s.slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+        {
+            std::lock_guard<std::mutex> guard(slot->limboMutex);
+            takeRetired(slot, ready, [domain, epoch](const Retired& retired) {
+                return retired.domain != domain || retired.epoch >= epoch;
+            });
+        }
+        while (slot->running.load(std::memory_order_acquire) > 0 && slot != current.slot) {
+            std::this_thread::yield();
+        }
+    }
+    run(ready);
+}
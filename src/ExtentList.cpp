@@ -0,0 +1,67 @@
+#include "../include/ExtentList.h"
+#include <algorithm>
+
+ExtentList::Chunk& ExtentList::writable(size_t chunk) {
+    // Only this list can reach a chunk nobody else holds, so it can be
+    // changed in place
+    if (chunks[chunk].use_count() > 1) {
+        chunks[chunk] = std::make_shared<Chunk>(*chunks[chunk]);
+    }
+    return *chunks[chunk];
+}
+
+void ExtentList::set(size_t index, Extent extent) {
+    writable(index / kChunkExtents)[index % kChunkExtents] = std::move(extent);
+}
+
+void ExtentList::push_back(Extent extent) {
+    if (count % kChunkExtents == 0) {
+        chunks.push_back(std::make_shared<Chunk>());
+        chunks.back()->reserve(kChunkExtents);
+    }
+    writable(chunks.size() - 1).push_back(std::move(extent));
+    count++;
+}
+
+void ExtentList::truncate(size_t newCount) {
+    if (newCount >= count) {
+        return;
+    }
+
+    chunks.resize((newCount + kChunkExtents - 1) / kChunkExtents);
+    if (newCount % kChunkExtents != 0) {
+        writable(chunks.size() - 1).resize(newCount % kChunkExtents);
+    }
+    count = newCount;
+}
+
+void ExtentList::clear() {
+    chunks.clear();
+    count = 0;
+}
+
+size_t ExtentList::find(size_t position) const {
+    // The last chunk starting at or before position, then the extent in it
+    auto chunk = std::upper_bound(chunks.begin(), chunks.end(), position,
+        [](size_t value, const std::shared_ptr<Chunk>& candidate) { return value < candidate->front().offset; });
+    size_t chunkIndex = static_cast<size_t>(chunk - chunks.begin()) - 1;
+
+    const Chunk& extents = *chunks[chunkIndex];
+    auto it = std::upper_bound(extents.begin(), extents.end(), position,
+        [](size_t value, const Extent& extent) { return value < extent.offset; });
+    return chunkIndex * kChunkExtents + static_cast<size_t>(it - extents.begin()) - 1;
+}
+
+void ExtentList::forEachDifference(const ExtentList& a, const ExtentList& b, const std::function<void(size_t)>& visit) {
+    size_t total = std::max(a.count, b.count);
+    size_t chunkCount = std::max(a.chunks.size(), b.chunks.size());
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        if (chunk < a.chunks.size() && chunk < b.chunks.size() && a.chunks[chunk] == b.chunks[chunk]) {
+            continue;
+        }
+        size_t end = std::min(total, (chunk + 1) * kChunkExtents);
+        for (size_t index = chunk * kChunkExtents; index < end; ++index) {
+            visit(index);
+        }
+    }
+}
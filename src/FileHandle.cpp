@@ -0,0 +1,151 @@
+#include "../include/FileHandle.h"
+#include "../include/FileNode.h"
+#include "../include/VirtualFileSystem.h"
+#include <cstring>
+
+FileHandle::FileHandle(FileNode* node, VirtualFileSystem* volume, unsigned flags)
+    : node(node), volume(volume), flags(flags), position(0) {
+}
+
+FileHandle::~FileHandle() {
+    close();
+}
+
+bool FileHandle::isOpen() const {
+    if (!volume) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> guard(volume->handlesLock);
+    return node != nullptr;
+}
+
+void FileHandle::close() {
+    if (volume) {
+        volume->releaseHandle(this);
+    }
+    node = nullptr;
+    volume = nullptr;
+}
+
+size_t FileHandle::read(char* buffer, size_t count) {
+    size_t transferred = pread(buffer, count, position);
+    position += transferred;
+    return transferred;
+}
+
+size_t FileHandle::write(const char* data, size_t count) {
+    if (!volume) {
+        return 0;
+    }
+    
+    // Finding the end and writing there happen under one lock
+    VirtualFileSystem::PathLock lock(volume->treeLock);
+    FileNode* target = volume->pinHandle(this, true);
+    if (!target) {
+        return 0;
+    }
+    std::unique_lock<NodeLock> nodeLock(target->getLock(), std::adopt_lock);
+    if (flags & Append) {
+        position = target->getSize();
+    }
+    size_t transferred = writeAt(target, data, count, position);
+    position += transferred;
+    return transferred;
+}
+
+size_t FileHandle::write(const std::string& data) {
+    return write(data.data(), data.size());
+}
+
+size_t FileHandle::pread(char* buffer, size_t count, size_t offset) const {
+    if (!volume) {
+        return 0;
+    }
+    
+    if (!(flags & Read)) {
+        return 0;
+    }
+    
+    VirtualFileSystem::ReadLock lock(volume->treeLock);
+    FileNode* target = volume->pinHandle(this, false);
+    if (!target) {
+        return 0;
+    }
+    std::shared_lock<NodeLock> nodeLock(target->getLock(), std::adopt_lock);
+    
+    // Only the extents overlapping the range are decoded
+    std::string data = target->readAt(offset, count);
+    std::memcpy(buffer, data.data(), data.size());
+    return data.size();
+}
+
+size_t FileHandle::pwrite(const char* data, size_t count, size_t offset) {
+    if (!volume) {
+        return 0;
+    }
+    
+    VirtualFileSystem::PathLock lock(volume->treeLock);
+    FileNode* target = volume->pinHandle(this, true);
+    if (!target) {
+        return 0;
+    }
+    std::unique_lock<NodeLock> nodeLock(target->getLock(), std::adopt_lock);
+    return writeAt(target, data, count, offset);
+}
+
+size_t FileHandle::writeAt(FileNode* target, const char* data, size_t count, size_t offset) {
+    if (!(flags & Write)) {
+        return 0;
+    }
+    
+    target->writeAt(offset, std::string(data, count));
+    volume->checkUsedSpace();
+    return count;
+}
+
+bool FileHandle::seek(long long offset, int whence) {
+    if (!volume) {
+        return false;
+    }
+    
+    VirtualFileSystem::ReadLock lock(volume->treeLock);
+    FileNode* target = volume->pinHandle(this, false);
+    if (!target) {
+        return false;
+    }
+    std::shared_lock<NodeLock> nodeLock(target->getLock(), std::adopt_lock);
+    
+    long long base = 0;
+    if (whence == SeekCur) {
+        base = static_cast<long long>(position);
+    } else if (whence == SeekEnd) {
+        base = static_cast<long long>(target->getSize());
+    } else if (whence != SeekSet) {
+        return false;
+    }
+    
+    if (base + offset < 0) {
+        return false;
+    }
+    position = static_cast<size_t>(base + offset);
+    return true;
+}
+
+size_t FileHandle::tell() const {
+    return position;
+}
+
+size_t FileHandle::size() const {
+    if (!volume) {
+        return 0;
+    }
+    
+    VirtualFileSystem::ReadLock lock(volume->treeLock);
+    FileNode* target = volume->pinHandle(this, false);
+    if (!target) {
+        return 0;
+    }
+    std::shared_lock<NodeLock> nodeLock(target->getLock(), std::adopt_lock);
+    return target->getSize();
+}
@@ -1,50 +1,182 @@
 #include "../include/FileNode.h"
 #include "../include/Compression.h"
 #include "../include/Encryption.h"
+#include "../include/NodeArena.h"
+#include "../include/Delta.h"
+#include "../include/Epoch.h"
 #include <algorithm>
+#include <functional>
 #include <sstream>
 #include <ctime>
 #include <iomanip>
 
-FileNode::FileNode(const FileNode& other)
-    : name(other.name),
+FileNode::FileNode(NodeArena& arena, const FileNode& other)
+    : FileNode(arena, other, other.getName())
+{
+}
+
+FileNode::FileNode(NodeArena& arena, const FileNode& other, const std::string& name)
+    : arena(&arena),
+      nameId(arena.names().acquire(name, hashName(name))),
+      nameHash(hashName(name)),
       isDir(other.isDir),
       parent(nullptr), // Will be set by the parent when adding to children
-      content(other.content),
-      size(other.size),
-      compressed(other.compressed),
-      compressedContent(other.compressedContent),
-      compressionAlgorithm(other.compressionAlgorithm),
-      encrypted(other.encrypted),
-      encryptionKey(other.encryptionKey),
-      encryptionAlgorithm(other.encryptionAlgorithm),
+      attached(false),
+      charged(true),
+      childIndex(nullptr),
+      content(other.content.load(std::memory_order_acquire) ? new Content(other.current()) : nullptr),
       maxVersions(other.maxVersions)
 {
-    // Deep copy children
-    for (const auto& child : other.children) {
-        auto childCopy = std::make_unique<FileNode>(*child);
+    Totals otherTotals = other.getTotals();
+    totals.logicalBytes.store(otherTotals.logicalBytes, std::memory_order_relaxed);
+    totals.storedBytes.store(otherTotals.storedBytes, std::memory_order_relaxed);
+    totals.files.store(otherTotals.files, std::memory_order_relaxed);
+    totals.directories.store(otherTotals.directories, std::memory_order_relaxed);
+    
+    // Extent payloads are shared, not copied; children are copied into the
+    // same arena as this node, in listing order
+    other.forEachChild([&](FileNode* child, const std::string&, size_t) {
+        std::unique_ptr<FileNode> childCopy(new (arena) FileNode(arena, *child));
         childCopy->parent = this;
+        childCopy->attached = true;
         children.push_back(std::move(childCopy));
-    }
+        indexChild(children.back().get());
+    });
     
-    // Deep copy versions
+    // Version copies share their content buffers
     for (const auto& version : other.versions) {
         auto versionCopy = std::make_unique<FileNodeVersion>(*version);
         versions.push_back(std::move(versionCopy));
     }
+    
+    arena.account(getFootprint());
+    if (const Content* copied = content.load(std::memory_order_relaxed)) {
+        chargePayloads(Content(), *copied);
+    }
 }
 
-FileNode::FileNode(const std::string& name, bool isDirectory, FileNode* parent)
-    : name(name), isDir(isDirectory), parent(parent), content(""), size(0),
-      compressed(false), encrypted(false), compressionAlgorithm(""), encryptionAlgorithm("") {
+FileNode::FileNode(FileNode&& other) noexcept
+    : arena(other.arena),
+      nameId(other.nameId),
+      nameHash(other.nameHash),
+      isDir(other.isDir),
+      parent(other.parent),
+      attached(other.attached),
+      charged(other.charged),
+      children(std::move(other.children)),
+      childIndex(other.childIndex.exchange(nullptr)),
+      content(other.content.exchange(nullptr)),
+      versions(std::move(other.versions)),
+      maxVersions(other.maxVersions)
+{
+    Totals otherTotals = other.getTotals();
+    totals.logicalBytes.store(otherTotals.logicalBytes, std::memory_order_relaxed);
+    totals.storedBytes.store(otherTotals.storedBytes, std::memory_order_relaxed);
+    totals.files.store(otherTotals.files, std::memory_order_relaxed);
+    totals.directories.store(otherTotals.directories, std::memory_order_relaxed);
+    
+    // Relocation stays within one arena, so the name reference and the
+    // accounted bytes move over; the moved-from node reports nothing
+    other.nameId = NameTable::kNoName;
+    other.charged = false;
+    
+    for (auto& child : children) {
+        child->parent = this;
+    }
+}
+
+void* FileNode::operator new(size_t size) {
+    return operator new(size, NodeArena::shared());
+}
+
+void* FileNode::operator new(size_t size, NodeArena& arena) {
+    if (size != sizeof(FileNode)) {
+        throw std::bad_alloc();
+    }
+    return arena.allocate();
+}
+
+void FileNode::operator delete(void* ptr) {
+    NodeArena::deallocate(ptr);
+}
+
+void FileNode::operator delete(void* ptr, NodeArena&) {
+    NodeArena::deallocate(ptr);
+}
+
+FileNode::FileNode(NodeArena& arena, const std::string& name, bool isDirectory, FileNode* parent)
+    : arena(&arena), nameHash(hashName(name)), isDir(isDirectory), parent(parent), attached(false), charged(true),
+      childIndex(nullptr), content(nullptr) {
+    propagateTotals(ownTotals(), Totals());
+    
+    nameId = arena.names().acquire(name, nameHash);
+    arena.account(getFootprint());
 }
 
 FileNode::~FileNode() {
-    // Children will be automatically deleted by unique_ptr
+    // Descendants are destroyed one at a time, each after its own children
+    // were taken over, so tearing down a deep chain doesn't recurse. Their
+    // slots are collected and handed back to the arena in one call, which
+    // takes its lock once instead of once per node. Nothing can still be
+    // reading this node, so its snapshots are freed directly
+    std::vector<std::unique_ptr<FileNode>> pending = std::move(children);
+    std::vector<void*> slots;
+    while (!pending.empty()) {
+        FileNode* node = pending.back().release();
+        pending.pop_back();
+        for (auto& child : node->children) {
+            pending.push_back(std::move(child));
+        }
+        node->children.clear();
+        node->~FileNode();
+        slots.push_back(node);
+    }
+    NodeArena::deallocate(slots.data(), slots.size());
+    
+    uncharge();
+    if (nameId != NameTable::kNoName) {
+        arena->names().release(nameId);
+    }
+    delete childIndex.load(std::memory_order_relaxed);
+    delete content.load(std::memory_order_relaxed);
 }
 
-std::string FileNode::getName() const {
-    return name;
+void FileNode::uncharge() {
+    if (!charged) {
+        return;
+    }
+    charged = false;
+    
+    arena->account(-static_cast<std::ptrdiff_t>(getFootprint()));
+    if (const Content* last = content.load(std::memory_order_relaxed)) {
+        chargePayloads(*last, Content());
+    }
+}
+
+void FileNode::unchargeSubtree() {
+    // Nothing writes to an unlinked subtree any more, so its charges can
+    // go while lock-free readers may still be looking at it
+    std::vector<FileNode*> pending{this};
+    while (!pending.empty()) {
+        FileNode* node = pending.back();
+        pending.pop_back();
+        for (auto& child : node->children) {
+            pending.push_back(child.get());
+        }
+        node->uncharge();
+    }
+}
+
+const std::string& FileNode::getName() const {
+    return arena->names().text(nameId);
+}
+
+size_t FileNode::getNameHash() const {
+    return nameHash;
+}
+
+size_t FileNode::hashName(std::string_view name) {
+    return std::hash<std::string_view>{}(name);
 }
 
 bool FileNode::isDirectory() const {
@@ -59,223 +191,742 @@ std::vector<std::unique_ptr<FileNode>>& FileNode::getChildren() {
     return children;
 }
 
+const std::vector<std::unique_ptr<FileNode>>& FileNode::getChildren() const {
+    return children;
+}
+
+void FileNode::forEachChild(const std::function<void(FileNode*, const std::string&, size_t)>& visit) const {
+    const ChildIndex* index = childIndex.load(std::memory_order_acquire);
+    if (!index) {
+        return;
+    }
+    
+    // Names come from the index rather than the children, whose names
+    // may change once they are unlinked
+    const NameTable& names = arena->names();
+    for (size_t i = 0, end = index->end(); i < end; ++i) {
+        if (FileNode* child = index->child(i)) {
+            visit(child, names.text(index->name(i)), index->hash(i));
+        }
+    }
+}
+
+const FileNode::Content& FileNode::current() const {
+    static const Content empty;
+    const Content* snapshot = content.load(std::memory_order_acquire);
+    return snapshot ? *snapshot : empty;
+}
+
+void FileNode::swapContent(Content next) {
+    next.versionCount = versions.size();
+    next.oldestVersion = versions.empty() ? 0 : versions.back()->getTimestamp();
+    
+    const Content* published = new Content(std::move(next));
+    const Content* previous = content.exchange(published, std::memory_order_acq_rel);
+    if (previous) {
+        chargePayloads(*previous, *published);
+        Epoch::retire(arena, [previous] { delete previous; });
+    } else {
+        chargePayloads(Content(), *published);
+    }
+}
+
+void FileNode::chargePayloads(const Content& previous, const Content& next) {
+    // Snapshots share the chunks a change left alone, so only the extents
+    // in the chunks it touched are compared. New references go first, so
+    // a buffer that only moved is never released in between
+    BlockStore& store = arena->blocks();
+    std::ptrdiff_t delta = 0;
+    auto changed = [&](size_t i) {
+        return i >= previous.extents.size() || i >= next.extents.size() ||
+               next.extents[i].payload != previous.extents[i].payload;
+    };
+    ExtentList::forEachDifference(previous.extents, next.extents, [&](size_t i) {
+        if (i < next.extents.size() && changed(i)) {
+            delta += static_cast<std::ptrdiff_t>(store.reference(next.extents[i].payload.get()));
+        }
+    });
+    ExtentList::forEachDifference(previous.extents, next.extents, [&](size_t i) {
+        if (i < previous.extents.size() && changed(i)) {
+            delta -= static_cast<std::ptrdiff_t>(store.release(previous.extents[i].payload.get()));
+        }
+    });
+    
+    if (delta != 0) {
+        arena->account(delta);
+    }
+}
+
 std::string FileNode::getContent() const {
     if (isDir) {
         return "";
     }
+    return readContent(current());
+}
+
+std::string FileNode::readContent(const Content& state) {
+    std::string result;
+    result.reserve(state.size);
+    for (const auto& extent : state.extents) {
+        result += decodeContent(state, *extent.payload);
+    }
+    return result;
+}
+
+ContentView FileNode::getContentView() const {
+    const Content& state = current();
+    if (isDir || state.extents.empty()) {
+        return ContentView();
+    }
     
-    std::string result = content;
-    
-    // If content is encrypted, decrypt it first
-    if (encrypted && !encryptionKey.empty()) {
-        result = decryptContent(result, encryptionKey);
+    bool plain = !state.compressed && !(state.encrypted && !state.encryptionKey.empty());
+    if (plain && state.extents.size() == 1) {
+        const auto& payload = state.extents.front().payload;
+        return ContentView(payload, std::string_view(*payload).substr(0, state.size));
     }
     
-    // If content is compressed, decompress it
-    if (compressed) {
-        result = decompressContent(compressedContent);
+    auto buffer = std::make_shared<const std::string>(readContent(state));
+    return ContentView(buffer, *buffer);
+}
+
+std::vector<ContentView> FileNode::getContentViews() const {
+    const Content& state = current();
+    std::vector<ContentView> views;
+    if (isDir) {
+        return views;
     }
     
-    return result;
+    bool plain = !state.compressed && !(state.encrypted && !state.encryptionKey.empty());
+    views.reserve(state.extents.size());
+    for (const auto& extent : state.extents) {
+        if (plain) {
+            views.emplace_back(extent.payload, std::string_view(*extent.payload).substr(0, extent.length));
+        } else {
+            auto buffer = std::make_shared<const std::string>(decodeContent(state, *extent.payload));
+            views.emplace_back(buffer, *buffer);
+        }
+    }
+    return views;
 }
 
 size_t FileNode::getSize() const {
-    return size;
+    return current().size;
+}
+
+size_t FileNode::getStoredSize() const {
+    return current().storedSize;
 }
 
 std::string FileNode::getPath() const {
-    if (parent == nullptr) {
-        // This is the root
-        return "/";
+    return NodePath(this).str();
+}
+
+NodePath FileNode::getPathHandle() const {
+    return NodePath(this);
+}
+
+size_t NodePath::length() const {
+    if (!node->getParent()) {
+        return 1; // "/"
     }
     
-    if (parent->getParent() == nullptr) {
-        // Parent is the root
-        return "/" + name;
+    size_t total = 0;
+    for (const FileNode* current = node; current->getParent(); current = current->getParent()) {
+        total += 1 + current->getName().size();
+    }
+    return total;
+}
+
+std::string NodePath::str() const {
+    // One pass to size the buffer, one to fill it from the back
+    std::string result(length(), '/');
+    size_t end = result.size();
+    for (const FileNode* current = node; current->getParent(); current = current->getParent()) {
+        const std::string& name = current->getName();
+        end -= name.size();
+        result.replace(end, name.size(), name);
+        end--; // Separator, already '/'
+    }
+    return result;
+}
+
+int NodePath::compare(std::string_view other) const {
+    // Each "/name" piece sits at a known offset of the full path, so the
+    // pieces can be matched bottom up and the first mismatch kept, without
+    // recursing or building the string
+    size_t total = length();
+    size_t mismatch = std::min(total, other.size());
+    char mine = 0;
+    if (!node->getParent() && mismatch > 0 && other[0] != '/') {
+        mismatch = 0;
+        mine = '/';
+    }
+    size_t end = total;
+    for (const FileNode* current = node; current->getParent(); current = current->getParent()) {
+        const std::string& name = current->getName();
+        size_t start = end - name.size() - 1;
+        for (size_t pos = start; pos < std::min(end, mismatch); ++pos) {
+            char c = pos == start ? '/' : name[pos - start - 1];
+            if (c != other[pos]) {
+                mismatch = pos;
+                mine = c;
+                break;
+            }
+        }
+        end = start;
     }
     
-    // Recursively build path
-    return parent->getPath() + "/" + name;
+    if (mismatch < std::min(total, other.size())) {
+        return static_cast<unsigned char>(mine) < static_cast<unsigned char>(other[mismatch]) ? -1 : 1;
+    }
+    return total < other.size() ? -1 : (total > other.size() ? 1 : 0);
+}
+
+std::ostream& operator<<(std::ostream& out, const NodePath& path) {
+    return out << path.str();
 }
 
 void FileNode::setContent(const std::string& newContent) {
     if (!isDir) {
         // Save a version before changing content
-        if (!content.empty()) {
-            saveVersion();
+        if (current().size > 0) {
+            recordVersion();
         }
         
-        content = newContent;
-        size = content.size();
-        
-        // If compression is enabled, compress the content
-        if (compressed) {
-            compressedContent = compressContent(content);
+        Content next = current();
+        assignContent(next, newContent);
+        contentChanged(std::move(next));
+    }
+}
+
+void FileNode::adoptContent(const FileNode& source) {
+    if (isDir || source.isDir) {
+        return;
+    }
+    
+    if (current().size > 0) {
+        recordVersion();
+    }
+    
+    BlockStore& store = arena->blocks();
+    const Content& from = source.current();
+    Content next = current();
+    bool sameEncoding = next.compressed == from.compressed &&
+                        next.compressionAlgorithm == from.compressionAlgorithm &&
+                        next.encrypted == from.encrypted &&
+                        next.encryptionKey == from.encryptionKey &&
+                        next.encryptionAlgorithm == from.encryptionAlgorithm;
+    
+    next.extents.clear();
+    next.storedSize = 0;
+    next.size = from.size;
+    if (sameEncoding && !store.isEnabled()) {
+        // The extent chunks themselves are shared
+        next.extents = from.extents;
+        next.storedSize = from.storedSize;
+        contentChanged(std::move(next));
+        return;
+    }
+    for (const Extent& extent : from.extents) {
+        if (!sameEncoding) {
+            next.extents.push_back(encodeExtent(next, decodeContent(from, *extent.payload), extent.offset));
+        } else if (store.isEnabled()) {
+            next.extents.push_back(Extent{store.intern(*extent.payload), extent.offset, extent.length});
+        } else {
+            next.extents.push_back(extent);
         }
-        
-        // If encryption is enabled, encrypt the content
-        if (encrypted && !encryptionKey.empty()) {
-            content = encryptContent(content, encryptionKey);
+        next.storedSize += next.extents.back().payload->size();
+    }
+    
+    contentChanged(std::move(next));
+}
+
+void FileNode::writeAt(size_t offset, const std::string& data) {
+    if (isDir) {
+        return;
+    }
+    
+    Content next = current();
+    
+    // Zero-fill up to the write offset one extent at a time
+    while (next.size < offset) {
+        size_t fill = std::min(kExtentSize, offset - next.size);
+        writeExtents(next, next.size, std::string(fill, '\0'));
+    }
+    writeExtents(next, offset, data);
+    
+    contentChanged(std::move(next));
+}
+
+void FileNode::append(const std::string& data) {
+    writeAt(current().size, data);
+}
+
+void FileNode::truncate(size_t newSize) {
+    if (isDir) {
+        return;
+    }
+    
+    if (newSize >= current().size) {
+        // Growing is a zero-length write at the new end
+        writeAt(newSize, "");
+        return;
+    }
+    
+    Content next = current();
+    
+    size_t keep = newSize == 0 ? 0 : findExtent(next, newSize - 1) + 1;
+    for (size_t i = keep; i < next.extents.size(); ++i) {
+        next.storedSize -= next.extents[i].payload->size();
+    }
+    next.extents.truncate(keep);
+    
+    if (keep > 0) {
+        Extent last = next.extents.back();
+        if (last.offset + last.length > newSize) {
+            std::string raw = decodeContent(next, *last.payload);
+            raw.resize(newSize - last.offset);
+            storeExtent(next, keep - 1, encodeExtent(next, raw, last.offset));
         }
     }
+    next.size = newSize;
+    
+    contentChanged(std::move(next));
+}
+
+std::string FileNode::readAt(size_t offset, size_t length) const {
+    std::string result;
+    const Content& state = current();
+    if (isDir || offset >= state.size) {
+        return result;
+    }
+    
+    size_t end = offset + std::min(length, state.size - offset);
+    result.reserve(end - offset);
+    
+    // Only the extents overlapping the range are decoded, and plain
+    // payloads are sliced without decoding at all
+    const auto& extents = state.extents;
+    bool plain = !state.compressed && !(state.encrypted && !state.encryptionKey.empty());
+    for (size_t i = findExtent(state, offset); i < extents.size() && extents[i].offset < end; ++i) {
+        size_t extentStart = extents[i].offset;
+        size_t from = std::max(offset, extentStart) - extentStart;
+        size_t to = std::min(end, extentStart + extents[i].length) - extentStart;
+        if (plain) {
+            result.append(*extents[i].payload, from, to - from);
+        } else {
+            std::string raw = decodeContent(state, *extents[i].payload);
+            result.append(raw, from, std::min(to, raw.size()) - from);
+        }
+    }
+    return result;
 }
 
 void FileNode::addChild(std::unique_ptr<FileNode> child) {
     if (isDir) {
+        child->parent = this;
+        child->attached = true;
+        propagateTotals(child->getTotals(), Totals());
         children.push_back(std::move(child));
+        indexChild(children.back().get());
     }
 }
 
-FileNode* FileNode::findChild(const std::string& childName) const {
-    for (const auto& child : children) {
-        if (child->getName() == childName) {
-            return child.get();
-        }
+void FileNode::reserveChildren(size_t additional) {
+    if (!isDir || additional == 0) {
+        return;
+    }
+    
+    children.reserve(children.size() + additional);
+    const ChildIndex* index = childIndex.load(std::memory_order_relaxed);
+    if (!index || index->end() + additional > index->capacity()) {
+        replaceChildIndex(children.size() + additional);
+    }
+}
+
+void FileNode::indexChild(FileNode* child) {
+    ChildIndex* index = childIndex.load(std::memory_order_relaxed);
+    if (!index || !index->insert(child, child->nameId, child->nameHash, children.size() - 1)) {
+        // Full, possibly of removed entries: publish a compacted copy with
+        // room to grow
+        replaceChildIndex(children.size() * 2);
+        childIndex.load(std::memory_order_relaxed)->insert(child, child->nameId, child->nameHash, children.size() - 1);
+    }
+}
+
+void FileNode::replaceChildIndex(size_t capacity) {
+    ChildIndex* previous = childIndex.load(std::memory_order_relaxed);
+    ChildIndex* next = previous ? new ChildIndex(*previous, children, capacity) : new ChildIndex(capacity);
+    childIndex.store(next, std::memory_order_release);
+    if (previous) {
+        Epoch::retire(arena, [previous] { delete previous; });
+    }
+}
+
+void FileNode::refreshChildIndex() {
+    if (childIndex.load(std::memory_order_relaxed)) {
+        replaceChildIndex(children.size() * 2);
+    }
+}
+
+FileNode* FileNode::findChild(std::string_view childName) const {
+    return findChild(childName, hashName(childName));
+}
+
+FileNode* FileNode::findChild(std::string_view childName, size_t childHash) const {
+    const ChildIndex* index = childIndex.load(std::memory_order_acquire);
+    return index ? index->find(childName, childHash, arena->names()) : nullptr;
+}
+
+void FileNode::removeChild(std::string_view childName) {
+    std::unique_ptr<FileNode> child = detachChild(childName);
+    if (child) {
+        // Freeing waits for readers, possibly for a whole batch of
+        // retirements; used space shouldn't
+        child->unchargeSubtree();
+        Epoch::retire(arena, [node = child.release()] { delete node; });
+    }
+}
+
+std::unique_ptr<FileNode> FileNode::detachChild(std::string_view childName) {
+    size_t childHash = hashName(childName);
+    FileNode* found = findChild(childName, childHash);
+    if (!found) {
+        return nullptr;
+    }
+    
+    ChildIndex* index = childIndex.load(std::memory_order_relaxed);
+    size_t position = index->erase(found, childHash);
+    propagateTotals(Totals(), found->getTotals());
+    
+    // The last child is swapped into the hole so removal stays O(1); the
+    // index keeps the listing order
+    size_t last = children.size() - 1;
+    if (position != last) {
+        index->relocate(children[last].get(), children[last]->nameHash, position);
+        std::swap(children[position], children[last]);
     }
-    return nullptr;
+    std::unique_ptr<FileNode> child = std::move(children.back());
+    children.pop_back();
+    
+    if (index->capacity() > ChildIndex::kMinCapacity && index->size() * 4 < index->capacity()) {
+        replaceChildIndex(children.size() * 2);
+    }
+    
+    child->parent = nullptr;
+    child->attached = false;
+    return child;
 }
 
-void FileNode::removeChild(const std::string& childName) {
-    auto it = std::remove_if(children.begin(), children.end(), 
-                            [&childName](const std::unique_ptr<FileNode>& child) {
-                                return child->getName() == childName;
-                            });
+void FileNode::setName(const std::string& newName) {
+    if (attached) {
+        return; // The parent's child index is keyed by the old name
+    }
+    
+    size_t previousFootprint = getFootprint();
     
-    if (it != children.end()) {
-        children.erase(it, children.end());
+    // Readers that found this node before it was unlinked may still be
+    // comparing the old name
+    size_t newHash = hashName(newName);
+    NameTable::NameId newId = arena->names().acquire(newName, newHash);
+    NameTable::NameId oldId = nameId;
+    Epoch::retire(arena, [owner = arena, oldId] { owner->names().release(oldId); });
+    nameId = newId;
+    nameHash = newHash;
+    
+    if (charged) {
+        arena->account(static_cast<std::ptrdiff_t>(getFootprint()) -
+                      static_cast<std::ptrdiff_t>(previousFootprint));
     }
 }
 
 void FileNode::setCompressed(bool compress, const std::string& algorithmName) {
-    if (isDir || compressed == compress) {
+    if (isDir || current().compressed == compress) {
         return;
     }
     
-    compressed = compress;
+    std::string raw = getContent();
+    Content next = current();
+    next.compressed = compress;
     
-    if (compressed) {
+    if (next.compressed) {
         if (!algorithmName.empty()) {
-            compressionAlgorithm = algorithmName;
+            next.compressionAlgorithm = algorithmName;
         } else {
-            compressionAlgorithm = CompressionFactory::getDefaultAlgorithm()->getName();
+            next.compressionAlgorithm = CompressionFactory::getDefaultAlgorithm()->getName();
         }
-        
-        compressedContent = compressContent(content);
     } else {
-        compressionAlgorithm = "";
-        compressedContent = "";
+        next.compressionAlgorithm = "";
     }
+    
+    assignContent(next, raw);
+    contentChanged(std::move(next));
 }
 
 bool FileNode::isCompressed() const {
-    return compressed;
+    return current().compressed;
 }
 
 std::string FileNode::getCompressedContent() const {
-    return compressedContent;
+    const Content& state = current();
+    if (!state.compressed) {
+        return "";
+    }
+    
+    // Peel off encryption only; each extent is still compressed
+    std::string result;
+    for (const auto& extent : state.extents) {
+        if (state.encrypted && !state.encryptionKey.empty()) {
+            result += decryptContent(state, *extent.payload, state.encryptionKey);
+        } else {
+            result += *extent.payload;
+        }
+    }
+    return result;
 }
 
 std::string FileNode::getCompressionAlgorithm() const {
-    return compressionAlgorithm;
+    return current().compressionAlgorithm;
 }
 
-std::string FileNode::compressContent(const std::string& input) const {
+std::string FileNode::compressContent(const Content& state, const std::string& input) {
     if (input.empty()) {
         return "";
     }
     
-    auto algorithm = CompressionFactory::createAlgorithm(compressionAlgorithm);
+    auto algorithm = CompressionFactory::createAlgorithm(state.compressionAlgorithm);
     return algorithm->compress(input);
 }
 
-std::string FileNode::decompressContent(const std::string& input) const {
+std::string FileNode::decompressContent(const Content& state, const std::string& input) {
     if (input.empty()) {
         return "";
     }
     
-    auto algorithm = CompressionFactory::createAlgorithm(compressionAlgorithm);
+    auto algorithm = CompressionFactory::createAlgorithm(state.compressionAlgorithm);
     return algorithm->decompress(input);
 }
 
 // Encryption methods
 void FileNode::setEncrypted(bool encrypt, const std::string& key, const std::string& algorithmName) {
-    if (isDir || encrypted == encrypt) {
+    if (isDir || current().encrypted == encrypt) {
         return;
     }
     
+    Content next = current();
+    
     if (encrypt && !key.empty()) {
+        std::string raw = getContent();
+        
         // Set encryption algorithm if specified, otherwise use default
         if (!algorithmName.empty()) {
-            encryptionAlgorithm = algorithmName;
+            next.encryptionAlgorithm = algorithmName;
         } else {
-            encryptionAlgorithm = EncryptionFactory::getDefaultAlgorithm()->getName();
+            next.encryptionAlgorithm = EncryptionFactory::getDefaultAlgorithm()->getName();
         }
         
-        encryptionKey = key;
-        
-        // We need to decrypt content first if it was already encrypted
-        std::string decrypted = encrypted ? decryptContent(content, encryptionKey) : content;
-        encrypted = true;
-        content = encryptContent(decrypted, encryptionKey);
+        next.encryptionKey = key;
+        next.encrypted = true;
+        assignContent(next, raw);
     } 
-    else if (!encrypt && encrypted) {
+    else if (!encrypt && next.encrypted) {
         // Decrypt the content
-        content = decryptContent(content, encryptionKey);
-        encrypted = false;
-        encryptionKey = "";
-        encryptionAlgorithm = "";
+        std::string raw = getContent();
+        next.encrypted = false;
+        next.encryptionKey = "";
+        next.encryptionAlgorithm = "";
+        assignContent(next, raw);
     }
+    
+    contentChanged(std::move(next));
 }
 
 bool FileNode::isEncrypted() const {
-    return encrypted;
+    return current().encrypted;
 }
 
 void FileNode::setEncryptionKey(const std::string& key) {
-    if (encrypted && !key.empty() && key != encryptionKey) {
-        // Decrypt with old key, then encrypt with new key
-        std::string decrypted = decryptContent(content, encryptionKey);
-        encryptionKey = key;
-        content = encryptContent(decrypted, encryptionKey);
-    } else if (!encrypted) {
-        encryptionKey = key;
+    const Content& state = current();
+    if (state.encrypted && !key.empty() && key != state.encryptionKey) {
+        // Decode with old key, then encode with new key
+        std::string raw = getContent();
+        Content next = state;
+        next.encryptionKey = key;
+        assignContent(next, raw);
+        contentChanged(std::move(next));
+    } else if (!state.encrypted) {
+        Content next = state;
+        next.encryptionKey = key;
+        swapContent(std::move(next));
     }
 }
 
 std::string FileNode::getEncryptionKey() const {
-    return encryptionKey;
+    return current().encryptionKey;
 }
 
 std::string FileNode::getEncryptionAlgorithm() const {
-    return encryptionAlgorithm;
+    return current().encryptionAlgorithm;
 }
 
-std::string FileNode::encryptContent(const std::string& input, const std::string& key) const {
+std::string FileNode::encryptContent(const Content& state, const std::string& input, const std::string& key) {
     if (input.empty() || key.empty()) {
         return input;
     }
     
-    auto algorithm = EncryptionFactory::createAlgorithm(encryptionAlgorithm);
+    auto algorithm = EncryptionFactory::createAlgorithm(state.encryptionAlgorithm);
     return algorithm->encrypt(input, key);
 }
 
-std::string FileNode::decryptContent(const std::string& input, const std::string& key) const {
+std::string FileNode::decryptContent(const Content& state, const std::string& input, const std::string& key) {
     if (input.empty() || key.empty()) {
         return input;
     }
     
-    auto algorithm = EncryptionFactory::createAlgorithm(encryptionAlgorithm);
+    auto algorithm = EncryptionFactory::createAlgorithm(state.encryptionAlgorithm);
     return algorithm->decrypt(input, key);
 }
 
+std::string FileNode::encodeContent(const Content& state, const std::string& raw) {
+    // Compress first: encrypted bytes would not compress
+    std::string payload = state.compressed ? compressContent(state, raw) : raw;
+    
+    if (state.encrypted && !state.encryptionKey.empty()) {
+        payload = encryptContent(state, payload, state.encryptionKey);
+    }
+    return payload;
+}
+
+std::string FileNode::decodeContent(const Content& state, const std::string& payload) {
+    std::string result = payload;
+    
+    if (state.encrypted && !state.encryptionKey.empty()) {
+        result = decryptContent(state, result, state.encryptionKey);
+    }
+    if (state.compressed) {
+        result = decompressContent(state, result);
+    }
+    return result;
+}
+
+FileNode::Extent FileNode::encodeExtent(const Content& state, const std::string& raw, size_t offset) const {
+    BlockStore& store = arena->blocks();
+    std::string payload = encodeContent(state, raw);
+    if (store.isEnabled()) {
+        return Extent{store.intern(std::move(payload)), offset, raw.size()};
+    }
+    return Extent{std::make_shared<const std::string>(std::move(payload)), offset, raw.size()};
+}
+
+void FileNode::assignContent(Content& state, const std::string& raw) const {
+    state.extents.clear();
+    state.storedSize = 0;
+    
+    std::vector<size_t> lengths;
+    if (arena->blocks().isEnabled()) {
+        lengths = BlockStore::chunkLengths(raw, kExtentSize);
+    } else {
+        for (size_t offset = 0; offset < raw.size(); offset += kExtentSize) {
+            lengths.push_back(std::min(kExtentSize, raw.size() - offset));
+        }
+    }
+    
+    size_t offset = 0;
+    for (size_t length : lengths) {
+        state.extents.push_back(encodeExtent(state, raw.substr(offset, length), offset));
+        state.storedSize += state.extents.back().payload->size();
+        offset += length;
+    }
+    state.size = raw.size();
+}
+
+size_t FileNode::findExtent(const Content& state, size_t position) {
+    // Index of the extent holding position, or extents.size() past the end
+    if (position >= state.size) {
+        return state.extents.size();
+    }
+    return state.extents.find(position);
+}
+
+void FileNode::storeExtent(Content& state, size_t index, Extent extent) {
+    state.storedSize += extent.payload->size();
+    if (index == state.extents.size()) {
+        state.extents.push_back(std::move(extent));
+    } else {
+        state.storedSize -= state.extents[index].payload->size();
+        state.extents.set(index, std::move(extent));
+    }
+}
+
+void FileNode::writeExtents(Content& state, size_t offset, std::string_view data) const {
+    // Callers guarantee offset <= size, so extents never get holes
+    size_t end = offset + data.size();
+    auto& extents = state.extents;
+    
+    // Writes at the end keep filling the last extent while it has room
+    size_t i = findExtent(state, offset);
+    if (i == extents.size() && !extents.empty() && extents.back().length < kExtentSize) {
+        i--;
+    }
+    
+    size_t position = offset;
+    while (position < end) {
+        std::string raw;
+        size_t extentStart = position;
+        size_t capacity = kExtentSize;
+        if (i < extents.size()) {
+            extentStart = extents[i].offset;
+            raw = decodeContent(state, *extents[i].payload);
+            if (i + 1 < extents.size()) {
+                capacity = extents[i].length; // Inner extents keep their boundaries
+            }
+        }
+        
+        size_t from = position - extentStart;
+        size_t to = std::min(end - extentStart, capacity);
+        if (raw.size() < to) {
+            raw.resize(to, '\0');
+        }
+        raw.replace(from, to - from, data.substr(position - offset, to - from));
+        
+        storeExtent(state, i, encodeExtent(state, raw, extentStart));
+        position = extentStart + to;
+        ++i;
+    }
+    state.size = std::max(state.size, end);
+}
+
 void FileNode::saveVersion() {
     if (isDir) {
         return;
     }
     
-    auto version = std::make_unique<FileNodeVersion>(content);
+    recordVersion();
+    swapContent(current()); // Republished for the version count
+}
+
+void FileNode::recordVersion() {
+    // Versions keep the logical content so they survive key and
+    // compression changes
+    std::string current = getContent();
+    
+    if (!versions.empty()) {
+        // The previous newest version becomes a delta against this one,
+        // unless that would make its run of deltas too long to replay
+        size_t run = 0;
+        while (run + 1 < versions.size() && !versions[run + 1]->isKeyframe()) {
+            run++;
+        }
+        if (run + 1 < kKeyframeInterval) {
+            versions.front()->rebaseOnto(current);
+        }
+    }
+    
+    auto version = std::make_unique<FileNodeVersion>(current);
     versions.push_front(std::move(version));
     
+    // The oldest version is the end of a delta chain, so dropping it never
+    // invalidates the others
     while (versions.size() > maxVersions) {
         versions.pop_back();
     }
@@ -286,28 +937,127 @@ bool FileNode::restoreVersion(size_t versionIndex) {
         return false;
     }
     
-    saveVersion();
-    
-    std::string versionContent = versions[versionIndex]->getContent();
+    // Read the version before saving the current content shifts the indices
+    std::string versionContent = getVersionContent(versionIndex);
+    recordVersion();
     
     // We bypass the regular setContent to avoid creating another version
-    content = versionContent;
-    size = content.size();
+    Content next = current();
+    assignContent(next, versionContent);
     
-    // Apply compression and encryption if needed
-    if (compressed) {
-        compressedContent = compressContent(content);
+    contentChanged(std::move(next));
+    return true;
+}
+
+std::string FileNode::getVersionContent(size_t versionIndex) const {
+    if (versionIndex >= versions.size()) {
+        return "";
     }
     
-    if (encrypted && !encryptionKey.empty()) {
-        content = encryptContent(content, encryptionKey);
+    // Start from the nearest newer keyframe and replay deltas towards the
+    // requested version
+    size_t keyframe = versionIndex;
+    while (!versions[keyframe]->isKeyframe()) {
+        keyframe--;
     }
     
-    return true;
+    std::string content = versions[keyframe]->getData();
+    for (size_t i = keyframe + 1; i <= versionIndex; ++i) {
+        content = DeltaCodec::apply(content, versions[i]->getData());
+    }
+    return content;
+}
+
+void FileNode::repack() {
+    if (isDir) {
+        return;
+    }
+    
+    Content next = current();
+    assignContent(next, getContent());
+    contentChanged(std::move(next));
+}
+
+void FileNode::countUniquePayloads(std::unordered_set<const std::string*>& seen, size_t& uniqueBytes) const {
+    for (const auto& extent : current().extents) {
+        if (seen.insert(extent.payload.get()).second) {
+            uniqueBytes += extent.payload->size();
+        }
+    }
+}
+
+size_t FileNode::getFootprint() const {
+    size_t nameLength = 0;
+    if (nameId != NameTable::kNoName) {
+        nameLength = arena->names().length(nameId);
+    }
+    return sizeof(FileNode) + nameLength;
+}
+
+void FileNode::contentChanged(Content next) {
+    swapContent(std::move(next));
+    
+    Totals previous = getTotals();
+    propagateTotals(ownTotals(), previous);
+}
+
+FileNode::Totals FileNode::getTotals() const {
+    Totals result;
+    result.logicalBytes = totals.logicalBytes.load(std::memory_order_relaxed);
+    result.storedBytes = totals.storedBytes.load(std::memory_order_relaxed);
+    result.files = totals.files.load(std::memory_order_relaxed);
+    result.directories = totals.directories.load(std::memory_order_relaxed);
+    return result;
+}
+
+FileNode::Totals FileNode::ownTotals() const {
+    Totals own;
+    if (isDir) {
+        own.directories = 1;
+    } else {
+        own.files = 1;
+        own.logicalBytes = current().size;
+        own.storedBytes = current().storedSize;
+    }
+    return own;
+}
+
+void FileNode::propagateTotals(const Totals& added, const Totals& removed) {
+    // Walk up as long as each node is actually linked into its parent; nodes
+    // that are still being built only update themselves. Unsigned
+    // wraparound makes adding the difference exact even when it is negative
+    for (FileNode* node = this; node; node = node->attached ? node->parent : nullptr) {
+        node->totals.logicalBytes.fetch_add(added.logicalBytes - removed.logicalBytes, std::memory_order_relaxed);
+        node->totals.storedBytes.fetch_add(added.storedBytes - removed.storedBytes, std::memory_order_relaxed);
+        node->totals.files.fetch_add(added.files - removed.files, std::memory_order_relaxed);
+        node->totals.directories.fetch_add(added.directories - removed.directories, std::memory_order_relaxed);
+    }
 }
 
 size_t FileNode::getVersionCount() const {
-    return versions.size();
+    return current().versionCount;
+}
+
+size_t FileNode::getVersionStoredSize() const {
+    size_t total = 0;
+    for (const auto& version : versions) {
+        total += version->getData().size();
+    }
+    return total;
+}
+
+FileNode::Attributes FileNode::getAttributes() const {
+    const Content& state = current();
+    Attributes attributes;
+    attributes.size = state.size;
+    attributes.storedSize = state.storedSize;
+    attributes.compressed = state.compressed;
+    attributes.compressionAlgorithm = state.compressionAlgorithm;
+    attributes.encrypted = state.encrypted;
+    attributes.encryptionAlgorithm = state.encryptionAlgorithm;
+    attributes.versions = state.versionCount;
+    attributes.modified = state.versionCount > 0 ? state.oldestVersion : std::time(nullptr);
+    return attributes;
 }
 
 std::vector<std::time_t> FileNode::getVersionTimestamps() const {
@@ -319,19 +1069,35 @@ std::vector<std::time_t> FileNode::getVersionTimestamps() const {
 }
 
 FileNodeVersion::FileNodeVersion(const std::string& content)
-    : content(content) {
+    : data(std::make_shared<const std::string>(content)), keyframe(true) {
     timestamp = std::time(nullptr);
 }
 
-std::string FileNodeVersion::getContent() const {
-    return content;
+bool FileNodeVersion::isKeyframe() const {
+    return keyframe;
+}
+
+const std::string& FileNodeVersion::getData() const {
+    return *data;
 }
 
 std::time_t FileNodeVersion::getTimestamp() const {
     return timestamp;
 }
 
+void FileNodeVersion::rebaseOnto(const std::string& newerContent) {
+    if (!keyframe) {
+        return;
+    }
+    
+    std::string delta = DeltaCodec::encode(newerContent, *data);
+    if (delta.size() < data->size()) {
+        data = std::make_shared<const std::string>(std::move(delta));
+        keyframe = false;
+    }
+}
+
 FileNodeVersion::FileNodeVersion(const FileNodeVersion& other)
-    : content(other.content), timestamp(other.timestamp)
+    : data(other.data), keyframe(other.keyframe), timestamp(other.timestamp)
 {
-}
\ No newline at end of file
+}
@@ -0,0 +1,74 @@
+#include "../include/FileWriter.h"
+#include "../include/FileNode.h"
+#include "../include/VirtualFileSystem.h"
+#include <algorithm>
+
+FileWriter::FileWriter(VirtualFileSystem* volume, const VfsPath& path, std::unique_ptr<FileNode> staged)
+    : volume(volume), path(path), staged(std::move(staged)), written(0) {
+}
+
+FileWriter::~FileWriter() {
+    abort();
+}
+
+bool FileWriter::isOpen() const {
+    return staged != nullptr;
+}
+
+bool FileWriter::write(const char* data, size_t count) {
+    if (!staged) {
+        return false;
+    }
+    
+    while (count > 0) {
+        size_t take = std::min(count, FileNode::kExtentSize - pending.size());
+        pending.append(data, take);
+        data += take;
+        count -= take;
+        written += take;
+        
+        if (pending.size() == FileNode::kExtentSize) {
+            flush();
+        }
+    }
+    return true;
+}
+
+bool FileWriter::write(const std::string& chunk) {
+    return write(chunk.data(), chunk.size());
+}
+
+size_t FileWriter::size() const {
+    return written;
+}
+
+void FileWriter::flush() {
+    // The staged node's last extent is always full here, so this encodes
+    // one new extent without touching the earlier ones
+    staged->append(pending);
+    pending.clear();
+}
+
+bool FileWriter::close() {
+    if (!staged) {
+        return false;
+    }
+    
+    if (!pending.empty()) {
+        flush();
+    }
+    
+    bool committed = volume && volume->commitWriter(path, *staged);
+    abort();
+    return committed;
+}
+
+void FileWriter::abort() {
+    if (volume) {
+        volume->releaseWriter(this);
+    }
+    volume = nullptr;
+    staged.reset();
+    pending.clear();
+    pending.shrink_to_fit();
+}
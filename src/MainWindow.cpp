@@ -1,4 +1,5 @@
 #include "../include/MainWindow.h"
+#include "../include/TreeIterator.h"
 #include "../src/generated/ui_mainwindow.h"
 #include <QtWidgets/QInputDialog>
 #include <QtWidgets/QMessageBox>
@@ -96,35 +97,54 @@ void MainWindow::refreshFileSystemView(const QString &path)
 
 void MainWindow::populateTreeView(QStandardItem *parentItem, const std::string &path)
 {
-    std::vector<std::string> entries = vfs->ls(path);
+    const FileNode *start = vfs->resolvePath(path);
     
-    for (const auto &entry : entries) {
-        QString itemName = QString::fromStdString(entry);
-        bool isDirectory = itemName.endsWith('/');
+    // Mounted volumes aren't reachable through this volume's nodes
+    if (!start || vfs->isMountPoint(path)) {
+        std::vector<DirEntry> entries = vfs->list(path);
         
-        if (isDirectory) {
-            itemName = itemName.left(itemName.length() - 1); // Remove trailing slash
+        for (const auto &entry : entries) {
+            QString itemName = QString::fromUtf8(entry.name.data(), static_cast<int>(entry.name.size()));
+            
+            QStandardItem *item = new QStandardItem(itemName);
+            item->setIcon(style()->standardIcon(entry.isDirectory ? QStyle::SP_DirIcon : QStyle::SP_FileIcon));
+            parentItem->appendRow(item);
+            
+            if (entry.isDirectory) {
+                std::string childPath = path;
+                if (childPath.back() != '/') {
+                    childPath += '/';
+                }
+                childPath += entry.name;
+                
+                populateTreeView(item, childPath);
+            }
         }
+        return;
+    }
+    
+    // parents[d] is the item that nodes at depth d + 1 are appended to
+    std::vector<QStandardItem *> parents{parentItem};
+    
+    TreeIterator walk(start);
+    walk.trackPath(path);
+    for (walk.next(); !walk.done(); walk.next()) {
+        const FileNode *node = walk.node();
+        const std::string &name = node->getName();
         
-        QStandardItem *item = new QStandardItem(itemName);
+        QStandardItem *item = new QStandardItem(QString::fromUtf8(name.data(), static_cast<int>(name.size())));
+        item->setIcon(style()->standardIcon(node->isDirectory() ? QStyle::SP_DirIcon : QStyle::SP_FileIcon));
         
-        if (isDirectory) {
-            item->setIcon(style()->standardIcon(QStyle::SP_DirIcon));
-        } else {
-            item->setIcon(style()->standardIcon(QStyle::SP_FileIcon));
-        }
+        parents.resize(walk.depth());
+        parents.back()->appendRow(item);
         
-        parentItem->appendRow(item);
-        
-        // If it's a directory, recursively populate it
-        if (isDirectory) {
-            std::string childPath = path;
-            if (childPath.back() != '/') {
-                childPath += '/';
+        if (node->isDirectory()) {
+            if (vfs->isMountPoint(walk.path())) {
+                walk.prune();
+                populateTreeView(item, walk.path());
+            } else {
+                parents.push_back(item);
             }
-            childPath += itemName.toStdString();
-            
-            populateTreeView(item, childPath);
         }
     }
 }
@@ -169,27 +189,29 @@ void MainWindow::updateFileProperties(const QString &path)
     
     std::string stdPath = path.toStdString();
     
-    FileNode* node = vfs->resolvePath(stdPath);
-    if (!node) {
+    // One lookup for every attribute shown
+    FileStat info = vfs->stat(stdPath);
+    if (!info.exists) {
         updateFileProperties(QString());
         return;
     }
     
-    ui->nameEdit->setText(QString::fromStdString(node->getName()));
-    ui->typeEdit->setText(node->isDirectory() ? "Directory" : "File");
+    VfsPath vfsPath(stdPath);
+    std::string_view name = vfsPath.name();
+    ui->nameEdit->setText(name.empty() ? QString("/") : QString::fromUtf8(name.data(), static_cast<int>(name.size())));
+    ui->typeEdit->setText(info.isDirectory ? "Directory" : "File");
     
-    if (!node->isDirectory()) {
-        ui->sizeEdit->setText(QString::number(node->getSize()) + " bytes");
-        ui->compressedEdit->setText(node->isCompressed() ? 
-                                   "Yes (" + QString::fromStdString(node->getCompressionAlgorithm()) + ")" : 
+    if (!info.isDirectory) {
+        ui->sizeEdit->setText(QString::number(info.size) + " bytes");
+        ui->compressedEdit->setText(info.compressed ? 
+                                   "Yes (" + QString::fromStdString(info.compressionAlgorithm) + ")" : 
                                    "No");
-        ui->encryptedEdit->setText(node->isEncrypted() ? 
-                                  "Yes (" + QString::fromStdString(node->getEncryptionAlgorithm()) + ")" : 
+        ui->encryptedEdit->setText(info.encrypted ? 
+                                  "Yes (" + QString::fromStdString(info.encryptionAlgorithm) + ")" : 
                                   "No");
         
-        std::vector<std::string> tags = vfs->getFileTags(stdPath);
         QString tagStr;
-        for (const auto &tag : tags) {
+        for (const auto &tag : info.tags) {
             if (!tagStr.isEmpty()) {
                 tagStr += ", ";
             }
@@ -198,7 +220,9 @@ void MainWindow::updateFileProperties(const QString &path)
         
         ui->tagsEdit->setText(tagStr);
     } else {
-        ui->sizeEdit->setText("--");
+        ui->sizeEdit->setText(QString::number(info.size) + " bytes in " +
+                              QString::number(info.files) + " file(s), " +
+                              QString::number(info.directories - 1) + " folder(s)");
         ui->compressedEdit->setText("--");
         ui->encryptedEdit->setText("--");
         ui->tagsEdit->setText("--");
@@ -217,7 +241,8 @@ void MainWindow::displayFileContent(const QString &path)
     FileNode* node = vfs->resolvePath(stdPath);
     
     if (node && !node->isDirectory()) {
-        ui->fileContentEdit->setPlainText(QString::fromStdString(node->getContent()));
+        ContentView content = node->getContentView();
+        ui->fileContentEdit->setPlainText(QString::fromUtf8(content.data(), static_cast<int>(content.size())));
     }
 }
 
@@ -363,35 +388,10 @@ void MainWindow::on_actionRename_triggered()
         }
         newPath += newName.toStdString();
         
-        bool success = false;
-        
-        if (node->isDirectory()) {
-            // Create new directory and recursively copy contents
-            if (vfs->mkdir(newPath)) {
-                // TODO: Copy directory contents
-                success = true;
-            }
-        } else {
-            std::string content = node->getContent();
-            if (vfs->touch(newPath)) {
-                success = vfs->write(newPath, content);
-                
-                if (node->isCompressed()) {
-                    vfs->compressFile(newPath, true, node->getCompressionAlgorithm());
-                }
-                
-                if (node->isEncrypted()) {
-                    vfs->encryptFile(newPath, node->getEncryptionKey(), node->getEncryptionAlgorithm());
-                }
-            }
-        }
-        
-        if (success) {
-            if (vfs->remove(path.toStdString())) {
-                terminal->writeOutput("Renamed: " + path + " to " + QString::fromStdString(newPath));
-                refreshFileSystemView(QString::fromStdString(newPath));
-                return;
-            }
+        if (vfs->move(path.toStdString(), newPath)) {
+            terminal->writeOutput("Renamed: " + path + " to " + QString::fromStdString(newPath));
+            refreshFileSystemView(QString::fromStdString(newPath));
+            return;
         }
         
         QMessageBox::warning(this, tr("Error"), tr("Failed to rename item."));
@@ -499,38 +499,12 @@ void MainWindow::on_actionPaste_triggered()
         return;
     }
     
-    bool success = false;
-    
-    if (sourceNode->isDirectory()) {
-        if (vfs->mkdir(fullDestPath.toStdString())) {
-            // TODO: Copy directory contents
-            success = true;
-        }
-    } else {
-        // Copy file
-        if (vfs->touch(fullDestPath.toStdString())) {
-            success = vfs->write(fullDestPath.toStdString(), sourceNode->getContent());
-            
-            if (success) {
-                if (sourceNode->isCompressed()) {
-                    vfs->compressFile(fullDestPath.toStdString(), true, sourceNode->getCompressionAlgorithm());
-                }
-                
-                if (sourceNode->isEncrypted()) {
-                    vfs->encryptFile(fullDestPath.toStdString(), sourceNode->getEncryptionKey(),
-                                    sourceNode->getEncryptionAlgorithm());
-                }
-            }
-        }
-    }
+    bool success = isCut ? vfs->move(clipboardPath.toStdString(), fullDestPath.toStdString())
+                         : vfs->copy(clipboardPath.toStdString(), fullDestPath.toStdString());
     
     if (success && isCut) {
-        if (vfs->remove(clipboardPath.toStdString())) {
-            clipboardPath.clear();
-            terminal->writeOutput("Moved: " + name + " to " + destPath);
-        } else {
-            QMessageBox::warning(this, tr("Error"), tr("Failed to remove source after move."));
-        }
+        clipboardPath.clear();
+        terminal->writeOutput("Moved: " + name + " to " + destPath);
     } else if (success) {
         terminal->writeOutput("Copied: " + name + " to " + destPath);
     }
@@ -0,0 +1,133 @@
+#include "../include/MountTable.h"
+
+MountTable::MountTable() : mounts(0) {
+    clear();
+}
+
+size_t MountTable::edgeKey(uint32_t parent, size_t hash) {
+    return hash ^ (static_cast<size_t>(parent) * 0x9E3779B97F4A7C15ull);
+}
+
+uint32_t MountTable::findChild(uint32_t parent, std::string_view name, size_t hash) const {
+    auto range = edges.equal_range(edgeKey(parent, hash));
+    for (auto it = range.first; it != range.second; ++it) {
+        const Node& node = nodes[it->second];
+        if (node.parent == parent && node.hash == hash && node.name == name) {
+            return it->second;
+        }
+    }
+    return kNone;
+}
+
+MountTable::Cursor MountTable::advance(Cursor cursor, std::string_view name, size_t hash) const {
+    if (cursor.offDepth > 0) {
+        cursor.offDepth++;
+        return cursor;
+    }
+    
+    uint32_t child = findChild(cursor.node, name, hash);
+    if (child == kNone) {
+        return Cursor{cursor.node, 1};
+    }
+    return Cursor{child, 0};
+}
+
+MountTable::Cursor MountTable::up(Cursor cursor) const {
+    if (cursor.offDepth > 0) {
+        cursor.offDepth--;
+    } else if (cursor.node != 0) {
+        cursor.node = nodes[cursor.node].parent;
+    }
+    return cursor;
+}
+
+VirtualFileSystem* MountTable::volumeAt(Cursor cursor) const {
+    if (cursor.offDepth > 0) {
+        return nullptr;
+    }
+    return nodes[cursor.node].volume;
+}
+
+bool MountTable::hasMountsAt(Cursor cursor) const {
+    if (cursor.offDepth > 0) {
+        return false;
+    }
+    // Nodes without a volume are pruned once their last child goes
+    const Node& node = nodes[cursor.node];
+    return node.volume || node.childCount > 0;
+}
+
+void MountTable::insert(const VfsPath& mountPoint, VirtualFileSystem* volume) {
+    uint32_t current = 0;
+    for (size_t i = 0; i < mountPoint.size(); ++i) {
+        uint32_t child = findChild(current, mountPoint[i], mountPoint.hash(i));
+        if (child == kNone) {
+            child = addChild(current, mountPoint[i], mountPoint.hash(i));
+        }
+        current = child;
+    }
+    
+    if (!nodes[current].volume) {
+        mounts++;
+    }
+    nodes[current].volume = volume;
+}
+
+void MountTable::erase(const VfsPath& mountPoint) {
+    uint32_t current = 0;
+    for (size_t i = 0; i < mountPoint.size() && current != kNone; ++i) {
+        current = findChild(current, mountPoint[i], mountPoint.hash(i));
+    }
+    if (current == kNone || !nodes[current].volume) {
+        return;
+    }
+    
+    nodes[current].volume = nullptr;
+    mounts--;
+    
+    // Prune the branch up to the first node that is still needed
+    while (current != 0 && !nodes[current].volume && nodes[current].childCount == 0) {
+        uint32_t parent = nodes[current].parent;
+        removeNode(current);
+        current = parent;
+    }
+}
+
+void MountTable::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    edges.clear();
+    nodes.push_back(Node{"", 0, kNone, 0, nullptr});
+    mounts = 0;
+}
+
+uint32_t MountTable::addChild(uint32_t parent, std::string_view name, size_t hash) {
+    uint32_t index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = Node{std::string(name), hash, parent, 0, nullptr};
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node{std::string(name), hash, parent, 0, nullptr});
+    }
+    
+    nodes[parent].childCount++;
+    edges.emplace(edgeKey(parent, hash), index);
+    return index;
+}
+
+void MountTable::removeNode(uint32_t index) {
+    Node& node = nodes[index];
+    auto range = edges.equal_range(edgeKey(node.parent, node.hash));
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == index) {
+            edges.erase(it);
+            break;
+        }
+    }
+    
+    nodes[node.parent].childCount--;
+    node.name.clear();
+    freeNodes.push_back(index);
+}
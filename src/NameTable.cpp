@@ -0,0 +1,68 @@
+#include "../include/NameTable.h"
+#include <stdexcept>
+
+NameTable::NameTable()
+    : chunks(new std::unique_ptr<Entry[]>[kMaxChunks]), entryCount(0) {
+}
+
+NameTable::NameId NameTable::acquire(std::string_view name, size_t hash) {
+    std::lock_guard<std::mutex> guard(mutex);
+    
+    auto range = byHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        Entry& existing = entry(it->second);
+        if (existing.text == name) {
+            existing.refs++;
+            return it->second;
+        }
+    }
+
+    NameId id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        if (entryCount == kChunkSize * kMaxChunks) {
+            throw std::length_error("Too many distinct names in one volume");
+        }
+        id = static_cast<NameId>(entryCount++);
+        if (!chunks[id >> kChunkBits]) {
+            chunks[id >> kChunkBits].reset(new Entry[kChunkSize]);
+        }
+    }
+    entry(id) = Entry{std::string(name), hash, 1};
+
+    byHash.emplace(hash, id);
+    return id;
+}
+
+void NameTable::retain(NameId id) {
+    std::lock_guard<std::mutex> guard(mutex);
+    entry(id).refs++;
+}
+
+void NameTable::release(NameId id) {
+    std::lock_guard<std::mutex> guard(mutex);
+    
+    Entry& released = entry(id);
+    if (--released.refs > 0) {
+        return;
+    }
+
+    auto range = byHash.equal_range(released.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == id) {
+            byHash.erase(it);
+            break;
+        }
+    }
+
+    released.text.clear();
+    released.text.shrink_to_fit();
+    freeIds.push_back(id);
+}
+
+size_t NameTable::size() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    return entryCount - freeIds.size();
+}
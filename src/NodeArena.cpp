@@ -0,0 +1,255 @@
+#include "../include/NodeArena.h"
+#include "../include/FileNode.h"
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+NodeArena::NodeArena()
+    : slabs(nullptr), available(nullptr), slabCount(0), liveNodes(0), releaseLocks(0), accountedBytes(0) {
+}
+
+NodeArena::~NodeArena() {
+    while (slabs) {
+        Slab* next = slabs->next;
+        ::operator delete(slabs, std::align_val_t(kSlabSize));
+        slabs = next;
+    }
+}
+
+size_t NodeArena::slotSize() {
+    size_t size = std::max(sizeof(FileNode), sizeof(FreeSlot));
+    size_t align = alignof(FileNode);
+    return (size + align - 1) / align * align;
+}
+
+size_t NodeArena::slotsOffset() {
+    size_t align = alignof(FileNode);
+    return (sizeof(Slab) + align - 1) / align * align;
+}
+
+size_t NodeArena::slotsPerSlab() {
+    return (kSlabSize - slotsOffset()) / slotSize();
+}
+
+NodeArena::Slab* NodeArena::slabOf(const void* ptr) {
+    // Slabs are kSlabSize-aligned, so the header is found by masking
+    auto address = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<Slab*>(address & ~(static_cast<uintptr_t>(kSlabSize) - 1));
+}
+
+NodeArena& NodeArena::shared() {
+    // Intentionally leaked so nodes can still be freed during static destruction
+    static NodeArena* arena = new NodeArena();
+    return *arena;
+}
+
+void* NodeArena::allocate() {
+    std::lock_guard<std::mutex> guard(slabMutex);
+    Slab* slab = available;
+    if (!slab) {
+        slab = createSlab();
+    }
+
+    void* ptr;
+    if (slab->freeList) {
+        ptr = slab->freeList;
+        slab->freeList = slab->freeList->next;
+    } else {
+        ptr = reinterpret_cast<char*>(slab) + slotsOffset() + slab->bumpIndex * slotSize();
+        slab->bumpIndex++;
+    }
+
+    slab->used++;
+    liveNodes++;
+
+    if (!slab->freeList && slab->bumpIndex == slotsPerSlab()) {
+        unlinkAvailable(slab);
+    }
+
+    return ptr;
+}
+
+void NodeArena::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    deallocate(&ptr, 1);
+}
+
+void NodeArena::deallocate(void* const* ptrs, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        if (!ptrs[i]) {
+            ++i;
+            continue;
+        }
+        
+        // A slot's slab is only destroyed once its last slot is freed, so
+        // the slabs of the slots still to come stay readable
+        assert(slabOf(ptrs[i])->magic == kSlabMagic && "node was not allocated from a NodeArena");
+        NodeArena* owner = slabOf(ptrs[i])->owner;
+        std::lock_guard<std::mutex> guard(owner->slabMutex);
+        owner->releaseLocks++;
+        for (; i < count && (!ptrs[i] || slabOf(ptrs[i])->owner == owner); ++i) {
+            if (ptrs[i]) {
+                owner->release(slabOf(ptrs[i]), ptrs[i]);
+            }
+        }
+    }
+}
+
+void NodeArena::release(Slab* slab, void* ptr) {
+    auto* slot = static_cast<FreeSlot*>(ptr);
+    slot->next = slab->freeList;
+    slab->freeList = slot;
+
+    slab->used--;
+    liveNodes--;
+
+    if (slab->evacuating) {
+        // Released by endCompaction() once it is empty
+        return;
+    }
+
+    if (slab->used == 0 && slabCount > 1) {
+        destroySlab(slab);
+        return;
+    }
+
+    if (!slab->isAvailable) {
+        linkAvailable(slab);
+    }
+}
+
+NodeArena::Slab* NodeArena::createSlab() {
+    void* memory = ::operator new(kSlabSize, std::align_val_t(kSlabSize));
+    Slab* slab = static_cast<Slab*>(memory);
+
+    slab->magic = kSlabMagic;
+    slab->owner = this;
+    slab->prev = nullptr;
+    slab->next = slabs;
+    slab->availablePrev = nullptr;
+    slab->availableNext = nullptr;
+    slab->freeList = nullptr;
+    slab->used = 0;
+    slab->bumpIndex = 0;
+    slab->isAvailable = false;
+    slab->evacuating = false;
+
+    if (slabs) {
+        slabs->prev = slab;
+    }
+    slabs = slab;
+    slabCount++;
+
+    linkAvailable(slab);
+    return slab;
+}
+
+void NodeArena::destroySlab(Slab* slab) {
+    if (slab->isAvailable) {
+        unlinkAvailable(slab);
+    }
+
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        slabs = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+
+    slabCount--;
+    slab->magic = 0;
+    ::operator delete(slab, std::align_val_t(kSlabSize));
+}
+
+void NodeArena::linkAvailable(Slab* slab) {
+    slab->availablePrev = nullptr;
+    slab->availableNext = available;
+    if (available) {
+        available->availablePrev = slab;
+    }
+    available = slab;
+    slab->isAvailable = true;
+}
+
+void NodeArena::unlinkAvailable(Slab* slab) {
+    if (slab->availablePrev) {
+        slab->availablePrev->availableNext = slab->availableNext;
+    } else {
+        available = slab->availableNext;
+    }
+    if (slab->availableNext) {
+        slab->availableNext->availablePrev = slab->availablePrev;
+    }
+    slab->availablePrev = nullptr;
+    slab->availableNext = nullptr;
+    slab->isAvailable = false;
+}
+
+size_t NodeArena::beginCompaction(double occupancyThreshold) {
+    std::lock_guard<std::mutex> guard(slabMutex);
+    size_t marked = 0;
+    size_t threshold = static_cast<size_t>(slotsPerSlab() * occupancyThreshold);
+
+    for (Slab* slab = slabs; slab; slab = slab->next) {
+        if (slab->used > 0 && slab->used < threshold) {
+            slab->evacuating = true;
+            if (slab->isAvailable) {
+                unlinkAvailable(slab);
+            }
+            marked++;
+        }
+    }
+
+    return marked;
+}
+
+bool NodeArena::isEvacuating(const void* ptr) const {
+    std::lock_guard<std::mutex> guard(slabMutex);
+    Slab* slab = slabOf(ptr);
+    return slab->owner == this && slab->evacuating;
+}
+
+size_t NodeArena::endCompaction() {
+    std::lock_guard<std::mutex> guard(slabMutex);
+    size_t released = 0;
+
+    Slab* slab = slabs;
+    while (slab) {
+        Slab* next = slab->next;
+
+        if (slab->evacuating) {
+            slab->evacuating = false;
+            if (slab->used == 0) {
+                destroySlab(slab);
+                released++;
+            } else {
+                // Something outside the tree still lives here; keep the slab
+                linkAvailable(slab);
+            }
+        } else if (slab->used == 0 && slabCount > 1) {
+            destroySlab(slab);
+            released++;
+        }
+
+        slab = next;
+    }
+
+    return released;
+}
+
+NodeArena::Stats NodeArena::getStats() const {
+    std::lock_guard<std::mutex> guard(slabMutex);
+    Stats stats;
+    stats.slabs = slabCount;
+    stats.liveNodes = liveNodes;
+    stats.capacity = slabCount * slotsPerSlab();
+    stats.bytesReserved = slabCount * kSlabSize;
+    stats.releaseLocks = releaseLocks;
+    return stats;
+}
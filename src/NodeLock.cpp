@@ -0,0 +1,38 @@
+#include "../include/NodeLock.h"
+#include <thread>
+
+namespace {
+
+// Spins a little first, since most critical sections are short, then
+// gives the processor to whoever holds the lock
+void backOff(unsigned& attempts) {
+    if (++attempts > 16) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace
+
+void NodeLock::lockSlow() {
+    unsigned attempts = 0;
+    for (;;) {
+        uint32_t current = state.load(std::memory_order_relaxed);
+        if ((current & ~kWriterWaiting) == 0) {
+            // Taking the lock clears the waiting flag; other waiting
+            // writers set it again on their next attempt
+            if (state.compare_exchange_weak(current, kWriter, std::memory_order_acquire)) {
+                return;
+            }
+        } else if (!(current & kWriterWaiting)) {
+            state.compare_exchange_weak(current, current | kWriterWaiting, std::memory_order_relaxed);
+        }
+        backOff(attempts);
+    }
+}
+
+void NodeLock::lockSharedSlow() {
+    unsigned attempts = 0;
+    while (!try_lock_shared()) {
+        backOff(attempts);
+    }
+}
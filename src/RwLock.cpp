@@ -0,0 +1,67 @@
+#include "../include/RwLock.h"
+
+RwLock::RwLock()
+    : readers(0), waitingReaders(0), waitingWriters(0), readerBatch(0), writer(false) {
+}
+
+void RwLock::lock() {
+    std::unique_lock<std::mutex> guard(mutex);
+    waitingWriters++;
+    writerCanEnter.wait(guard, [this] { return writerMayEnter(); });
+    waitingWriters--;
+    writer = true;
+}
+
+bool RwLock::try_lock() {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!writerMayEnter()) {
+        return false;
+    }
+    writer = true;
+    return true;
+}
+
+void RwLock::unlock() {
+    std::lock_guard<std::mutex> guard(mutex);
+    writer = false;
+    
+    // Readers that queued behind this writer go before the next one
+    if (waitingReaders > 0) {
+        readerBatch = waitingReaders;
+        readersCanEnter.notify_all();
+    } else if (waitingWriters > 0) {
+        writerCanEnter.notify_one();
+    }
+}
+
+void RwLock::lock_shared() {
+    std::unique_lock<std::mutex> guard(mutex);
+    waitingReaders++;
+    readersCanEnter.wait(guard, [this] { return readerMayEnter(); });
+    waitingReaders--;
+    admitReader();
+}
+
+bool RwLock::try_lock_shared() {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!readerMayEnter()) {
+        return false;
+    }
+    admitReader();
+    return true;
+}
+
+void RwLock::admitReader() {
+    if (readerBatch > 0) {
+        readerBatch--;
+    }
+    readers++;
+}
+
+void RwLock::unlock_shared() {
+    std::lock_guard<std::mutex> guard(mutex);
+    readers--;
+    if (readers == 0 && waitingWriters > 0 && readerBatch == 0) {
+        writerCanEnter.notify_one();
+    }
+}
@@ -3,6 +3,7 @@
 #include "../include/PluginManager.h"
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
@@ -21,13 +22,21 @@ Shell::Shell() : running(true) {
     commands["cd"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCd(args); };
     commands["ls"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdLs(args); };
     commands["cat"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCat(args); };
+    commands["head"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdHead(args); };
+    commands["tail"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdTail(args); };
     commands["write"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdWrite(args); };
+    commands["append"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdAppend(args); };
+    commands["truncate"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdTruncate(args); };
+    commands["import"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdImport(args); };
     commands["rm"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdRm(args); };
     commands["help"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdHelp(args); };
     commands["exit"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdExit(args); };
     commands["save"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdSave(args); };
     commands["load"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdLoad(args); };
     commands["diskinfo"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDiskInfo(args); };
+    commands["compact"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCompact(args); };
+    commands["dedup"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDedup(args); };
+    commands["dcache"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDcache(args); };
     commands["pwd"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdPwd(args); };
     commands["cp"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCp(args); };
     commands["mv"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdMv(args); };
@@ -84,13 +93,21 @@ Shell::Shell(std::shared_ptr<VirtualFileSystem> vfsPtr) : running(true), sharedV
     commands["cd"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCd(args); };
     commands["ls"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdLs(args); };
     commands["cat"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCat(args); };
+    commands["head"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdHead(args); };
+    commands["tail"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdTail(args); };
     commands["write"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdWrite(args); };
+    commands["append"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdAppend(args); };
+    commands["truncate"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdTruncate(args); };
+    commands["import"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdImport(args); };
     commands["rm"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdRm(args); };
     commands["help"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdHelp(args); };
     commands["exit"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdExit(args); };
     commands["save"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdSave(args); };
     commands["load"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdLoad(args); };
     commands["diskinfo"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDiskInfo(args); };
+    commands["compact"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCompact(args); };
+    commands["dedup"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDedup(args); };
+    commands["dcache"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdDcache(args); };
     commands["pwd"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdPwd(args); };
     commands["cp"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdCp(args); };
     commands["mv"] = [this](Shell* shell, const std::vector<std::string>& args) { cmdMv(args); };
@@ -236,7 +253,7 @@ void Shell::cmdLs(const std::vector<std::string>& args) {
         }
     }
     
-    std::vector<std::string> entries = vfs.ls(path);
+    std::vector<DirEntry> entries = vfs.list(path);
     
     if (entries.empty()) {
         std::cout << "Directory is empty or doesn't exist" << std::endl;
@@ -246,7 +263,7 @@ void Shell::cmdLs(const std::vector<std::string>& args) {
     if (!showMetadata) {
         std::cout << "Contents of directory:" << std::endl;
         for (const auto& entry : entries) {
-            std::cout << "  " << entry << std::endl;
+            std::cout << "  " << entry.name << (entry.isMountPoint ? "@" : entry.isDirectory ? "/" : "") << std::endl;
         }
     } else {
         std::cout << "Detailed contents of directory:" << std::endl;
@@ -257,50 +274,30 @@ void Shell::cmdLs(const std::vector<std::string>& args) {
         std::cout << std::string(60, '-') << std::endl;
         
         for (const auto& entry : entries) {
-            // Extract the base name without trailing / or @
-            std::string baseName = entry;
-            bool isDir = false;
-            bool isMount = false;
-            
-            if (baseName.back() == '/') {
-                isDir = true;
-                baseName.pop_back();
-            } else if (baseName.back() == '@') {
-                isMount = true;
-                baseName.pop_back();
-            }
-            
-            std::string fullPath = path.empty() ? baseName : path + "/" + baseName;
-            FileNode* node = vfs.resolvePath(fullPath);
-            
-            if (!node) {
-                // This might be a mount point
+            if (entry.isMountPoint) {
                 std::cout << std::left << std::setw(10) << "<mount>"
                           << std::setw(20) << "-" 
                           << std::setw(15) << "mount-point"
-                          << entry << std::endl;
+                          << entry.name << "@" << std::endl;
                 continue;
             }
             
-            size_t size = node->getSize();
-            std::time_t modTime = getNodeModificationTime(node);
-            
             std::string attrs;
-            attrs += isDir ? "d" : "-";
+            attrs += entry.isDirectory ? "d" : "-";
             attrs += "rw-";  // Assume read/write permissions
             
-            if (node && !node->isDirectory()) {
-                attrs += node->isCompressed() ? "c" : "-";
-                attrs += node->isEncrypted() ? "e" : "-";
-                attrs += (node->getVersionCount() > 0) ? "v" : "-";
+            if (!entry.isDirectory) {
+                attrs += entry.compressed ? "c" : "-";
+                attrs += entry.encrypted ? "e" : "-";
+                attrs += (entry.versions > 0) ? "v" : "-";
             } else {
                 attrs += "---";
             }
             
-            std::cout << std::left << std::setw(10) << (isDir ? "<DIR>" : formatSize(size))
-                      << std::setw(20) << formatTimestamp(modTime)
+            std::cout << std::left << std::setw(10) << (entry.isDirectory ? "<DIR>" : formatSize(entry.size))
+                      << std::setw(20) << formatTimestamp(entry.modified)
                       << std::setw(15) << attrs 
-                      << entry << std::endl;
+                      << entry.name << (entry.isDirectory ? "/" : "") << std::endl;
         }
     }
 }
@@ -319,6 +316,60 @@ void Shell::cmdCat(const std::vector<std::string>& args) {
     }
 }
 
+void Shell::cmdHead(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cout << "Usage: head <file_path> [bytes]" << std::endl;
+        return;
+    }
+    
+    size_t count = 512;
+    if (args.size() > 1) {
+        try {
+            count = std::stoull(args[1]);
+        } catch (const std::exception&) {
+            std::cout << "Invalid byte count: " << args[1] << std::endl;
+            return;
+        }
+    }
+    
+    // Only the extents holding the requested bytes are decoded
+    std::string content;
+    if (!vfs.read(args[0], 0, count, content)) {
+        std::cout << "File doesn't exist: " << args[0] << std::endl;
+        return;
+    }
+    std::cout << content << std::endl;
+}
+
+void Shell::cmdTail(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cout << "Usage: tail <file_path> [bytes]" << std::endl;
+        return;
+    }
+    
+    size_t count = 512;
+    if (args.size() > 1) {
+        try {
+            count = std::stoull(args[1]);
+        } catch (const std::exception&) {
+            std::cout << "Invalid byte count: " << args[1] << std::endl;
+            return;
+        }
+    }
+    
+    auto handle = vfs.open(args[0]);
+    if (!handle) {
+        std::cout << "File doesn't exist: " << args[0] << std::endl;
+        return;
+    }
+    
+    size_t size = handle->size();
+    count = std::min(count, size);
+    std::string content(count, '\0');
+    content.resize(handle->pread(&content[0], count, size - count));
+    std::cout << content << std::endl;
+}
+
 void Shell::cmdWrite(const std::vector<std::string>& args) {
     if (args.size() < 2) {
         std::cout << "Usage: write <file_path> <content>" << std::endl;
@@ -345,6 +396,97 @@ void Shell::cmdWrite(const std::vector<std::string>& args) {
     }
 }
 
+void Shell::cmdAppend(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cout << "Usage: append <file_path> <content>" << std::endl;
+        return;
+    }
+    
+    std::string path = args[0];
+    std::string content;
+    
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (i > 1) {
+            content += " ";
+        }
+        content += args[i];
+    }
+    
+    if (vfs.append(path, content)) {
+        std::cout << "Successfully appended to " << path << std::endl;
+        if (sharedVfs) {
+            sharedVfs->append(path, content);
+        }
+    } else {
+        std::cout << "Failed to append to " << path << std::endl;
+    }
+}
+
+void Shell::cmdImport(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cout << "Usage: import <host_file> <file_path>" << std::endl;
+        return;
+    }
+    
+    std::ifstream in(args[0], std::ios::binary);
+    if (!in.is_open()) {
+        std::cout << "Cannot open host file: " << args[0] << std::endl;
+        return;
+    }
+    
+    auto writer = vfs.createWriter(args[1]);
+    auto mirror = sharedVfs ? sharedVfs->createWriter(args[1]) : nullptr;
+    if (!writer) {
+        std::cout << "Failed to import into " << args[1] << std::endl;
+        return;
+    }
+    
+    // The host file is streamed through in chunks, never held whole
+    std::string chunk(64 * 1024, '\0');
+    while (in.read(&chunk[0], chunk.size()) || in.gcount() > 0) {
+        writer->write(chunk.data(), static_cast<size_t>(in.gcount()));
+        if (mirror) {
+            mirror->write(chunk.data(), static_cast<size_t>(in.gcount()));
+        }
+    }
+    
+    size_t imported = writer->size();
+    if (writer->close()) {
+        if (mirror) {
+            mirror->close();
+        }
+        std::cout << "Imported " << formatSize(imported) << " from " << args[0] << " to " << args[1] << std::endl;
+    } else {
+        std::cout << "Failed to import into " << args[1] << std::endl;
+    }
+}
+
+void Shell::cmdTruncate(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cout << "Usage: truncate <file_path> <size>" << std::endl;
+        return;
+    }
+    
+    std::string path = args[0];
+    size_t newSize;
+    
+    try {
+        newSize = std::stoull(args[1]);
+    } catch (const std::exception&) {
+        std::cout << "Invalid size: " << args[1] << std::endl;
+        return;
+    }
+    
+    if (vfs.truncate(path, newSize)) {
+        std::cout << "Truncated " << path << " to " << formatSize(newSize) << std::endl;
+        if (sharedVfs) {
+            sharedVfs->truncate(path, newSize);
+        }
+    } else {
+        std::cout << "Failed to truncate " << path << std::endl;
+    }
+}
+
 void Shell::cmdRm(const std::vector<std::string>& args) {
     if (args.empty()) {
         std::cout << "Usage: rm <path>" << std::endl;
@@ -374,9 +516,14 @@ void Shell::cmdHelp(const std::vector<std::string>& args) {
     std::cout << "  ls [path]           - List contents of a directory" << std::endl;
     std::cout << "  ls -l [path]        - List contents with details" << std::endl;
     std::cout << "  cat <file>          - Display the contents of a file" << std::endl;
+    std::cout << "  head <file> [bytes] - Display the first bytes of a file (default 512)" << std::endl;
+    std::cout << "  tail <file> [bytes] - Display the last bytes of a file (default 512)" << std::endl;
     std::cout << "  write <file> <text> - Write text to a file" << std::endl;
-    std::cout << "  cp <src> <dest>     - Copy a file" << std::endl;
-    std::cout << "  mv <src> <dest>     - Move or rename a file" << std::endl;
+    std::cout << "  append <file> <text> - Append text to a file" << std::endl;
+    std::cout << "  truncate <file> <size> - Shrink or zero-extend a file" << std::endl;
+    std::cout << "  import <host_file> <file> - Copy a file from the host into the VFS" << std::endl;
+    std::cout << "  cp <src> <dest>     - Copy a file or directory" << std::endl;
+    std::cout << "  mv <src> <dest>     - Move or rename a file or directory" << std::endl;
     std::cout << "  rm <path>           - Remove a file or directory" << std::endl;
     std::cout << std::endl;
     
@@ -384,6 +531,9 @@ void Shell::cmdHelp(const std::vector<std::string>& args) {
     std::cout << "  save [filename]     - Save the file system to disk" << std::endl;
     std::cout << "  load [filename]     - Load the file system from disk" << std::endl;
     std::cout << "  diskinfo            - Display disk usage information" << std::endl;
+    std::cout << "  compact             - Reclaim fragmented node storage" << std::endl;
+    std::cout << "  dedup [on|off]      - Show or toggle content deduplication" << std::endl;
+    std::cout << "  dcache [capacity]   - Show or resize the path lookup cache" << std::endl;
     std::cout << std::endl;
     
     std::cout << "Search Commands:" << std::endl;
@@ -499,6 +649,79 @@ void Shell::cmdDiskInfo(const std::vector<std::string>& args) {
     std::cout << "  Total Space: " << formatSize(totalSpace) << std::endl;
     std::cout << "  Used Space: " << formatSize(usedSpace) << " (" << std::fixed << std::setprecision(2) << percentUsed << "%)" << std::endl;
     std::cout << "  Free Space: " << formatSize(freeSpace) << std::endl;
+    
+    FileNode* root = vfs.resolvePath("/");
+    if (root) {
+        const FileNode::Totals& totals = root->getTotals();
+        std::cout << "  Files: " << totals.files << std::endl;
+        std::cout << "  Directories: " << (totals.directories - 1) << std::endl;
+        std::cout << "  Content: " << formatSize(totals.logicalBytes) << " ("
+                  << formatSize(totals.storedBytes) << " stored)" << std::endl;
+    }
+    
+    if (vfs.isDeduplicationEnabled()) {
+        VirtualFileSystem::DedupStats stats = vfs.getDedupStats();
+        std::cout << "  Dedup Ratio: " << std::fixed << std::setprecision(2) << stats.ratio << "x" << std::endl;
+    }
+}
+
+void Shell::cmdCompact(const std::vector<std::string>& args) {
+    (void)args;
+    
+    NodeArena::Stats before = vfs.getNodeStorageStats();
+    size_t released = vfs.compactNodes();
+    NodeArena::Stats after = vfs.getNodeStorageStats();
+    
+    std::cout << "Compacted node storage: released " << released << " slab(s)" << std::endl;
+    std::cout << "  Nodes: " << after.liveNodes << " in " << after.slabs << " slab(s)" << std::endl;
+    std::cout << "  Reserved: " << formatSize(before.bytesReserved) << " -> "
+              << formatSize(after.bytesReserved) << std::endl;
+}
+
+void Shell::cmdDedup(const std::vector<std::string>& args) {
+    if (!args.empty()) {
+        if (args[0] != "on" && args[0] != "off") {
+            std::cout << "Usage: dedup [on|off]" << std::endl;
+            return;
+        }
+        
+        bool enable = args[0] == "on";
+        vfs.setDeduplication(enable);
+        if (sharedVfs) {
+            sharedVfs->setDeduplication(enable);
+        }
+    }
+    
+    VirtualFileSystem::DedupStats stats = vfs.getDedupStats();
+    std::cout << "Deduplication: " << (stats.enabled ? "on" : "off") << std::endl;
+    std::cout << "  Stored: " << formatSize(stats.referencedBytes) << std::endl;
+    std::cout << "  Unique: " << formatSize(stats.uniqueBytes) << " in " << stats.blocks << " block(s)" << std::endl;
+    std::cout << "  Ratio: " << std::fixed << std::setprecision(2) << stats.ratio << "x" << std::endl;
+}
+
+void Shell::cmdDcache(const std::vector<std::string>& args) {
+    if (!args.empty()) {
+        try {
+            size_t capacity = std::stoul(args[0]);
+            vfs.setDentryCacheCapacity(capacity);
+            if (sharedVfs) {
+                sharedVfs->setDentryCacheCapacity(capacity);
+            }
+        } catch (const std::exception&) {
+            std::cout << "Usage: dcache [capacity]" << std::endl;
+            return;
+        }
+    }
+    
+    DentryCache::Stats stats = vfs.getDentryCacheStats();
+    size_t lookups = stats.hits + stats.misses;
+    double hitRate = lookups ? (static_cast<double>(stats.hits) / lookups) * 100 : 0.0;
+    
+    std::cout << "Path lookup cache:" << std::endl;
+    std::cout << "  Entries: " << stats.entries << " / " << stats.capacity << std::endl;
+    std::cout << "  Hits: " << stats.hits << " (" << stats.negativeHits << " negative), Misses: "
+              << stats.misses << " (" << std::fixed << std::setprecision(1) << hitRate << "% hit rate)" << std::endl;
+    std::cout << "  Evictions: " << stats.evictions << ", Invalidations: " << stats.invalidations << std::endl;
 }
 
 std::string Shell::formatSize(size_t sizeInBytes) const {
@@ -740,8 +963,7 @@ void Shell::cmdListVersions(const std::vector<std::string>& args) {
 }
 
 void Shell::cmdPwd(const std::vector<std::string>& args) {
-    std::string currentPath = vfs.getCurrentPath();
-    std::cout << currentPath << std::endl;
+    std::cout << vfs.getCurrentPath() << std::endl;
 }
 
 void Shell::cmdCp(const std::vector<std::string>& args) {
@@ -775,20 +997,15 @@ void Shell::cmdCp(const std::vector<std::string>& args) {
         finalDestPath += sourceBaseName;
     }
     
-    if (!sourceNode->isDirectory()) {
-        std::string content = vfs.cat(sourcePath);
+    if (vfs.copy(sourcePath, finalDestPath)) {
+        std::cout << (sourceNode->isDirectory() ? "Directory" : "File") << " copied from "
+                  << sourcePath << " to " << finalDestPath << std::endl;
         
-        if (vfs.write(finalDestPath, content)) {
-            std::cout << "File copied from " << sourcePath << " to " << finalDestPath << std::endl;
-            
-            if (sharedVfs) {
-                sharedVfs->write(finalDestPath, content);
-            }
-        } else {
-            std::cout << "Failed to copy file to " << finalDestPath << std::endl;
+        if (sharedVfs) {
+            sharedVfs->copy(sourcePath, finalDestPath);
         }
     } else {
-        std::cout << "Copying directories not supported yet" << std::endl;
+        std::cout << "Failed to copy to " << finalDestPath << std::endl;
     }
 }
 
@@ -823,25 +1040,16 @@ void Shell::cmdMv(const std::vector<std::string>& args) {
         finalDestPath += sourceBaseName;
     }
     
-    if (!sourceNode->isDirectory()) {
-        std::string content = vfs.cat(sourcePath);
+    bool isDirectory = sourceNode->isDirectory();
+    if (vfs.move(sourcePath, finalDestPath)) {
+        std::cout << (isDirectory ? "Directory" : "File") << " moved from "
+                  << sourcePath << " to " << finalDestPath << std::endl;
         
-        if (vfs.write(finalDestPath, content)) {
-            if (vfs.remove(sourcePath)) {
-                std::cout << "File moved from " << sourcePath << " to " << finalDestPath << std::endl;
-                
-                if (sharedVfs) {
-                    sharedVfs->write(finalDestPath, content);
-                    sharedVfs->remove(sourcePath);
-                }
-            } else {
-                std::cout << "Copied to destination, but failed to remove source: " << sourcePath << std::endl;
-            }
-        } else {
-            std::cout << "Failed to move file: could not write to " << finalDestPath << std::endl;
+        if (sharedVfs) {
+            sharedVfs->move(sourcePath, finalDestPath);
         }
     } else {
-        std::cout << "Moving directories not supported yet" << std::endl;
+        std::cout << "Failed to move " << sourcePath << " to " << finalDestPath << std::endl;
     }
 }
 
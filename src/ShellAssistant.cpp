@@ -211,9 +211,9 @@ std::string ShellAssistant::findLargestFile(const std::string& path) const {
         return "Sorry, I can't access the file system information right now.";
     }
     
-    std::vector<std::string> entries;
+    std::vector<DirEntry> entries;
     try {
-        entries = vfs->ls(path);
+        entries = vfs->list(path);
     } catch (...) {
         return "I couldn't access directory '" + path + "'. Please make sure it exists and you have permission to access it.";
     }
@@ -226,20 +226,9 @@ std::string ShellAssistant::findLargestFile(const std::string& path) const {
     size_t largestSize = 0;
     
     for (const auto& entry : entries) {
-        if (entry.back() == '/') {
-            continue;
-        }
-        
-        std::string filePath = (path == "." || path == "./") ? entry : 
-                              (path == "/") ? "/" + entry : path + "/" + entry;
-        
-        FileNode* node = vfs->resolvePath(filePath);
-        if (node && !node->isDirectory()) {
-            size_t size = node->getSize();
-            if (size > largestSize) {
-                largestSize = size;
-                largestFileName = entry;
-            }
+        if (!entry.isDirectory && entry.size > largestSize) {
+            largestSize = entry.size;
+            largestFileName = entry.name;
         }
     }
     
@@ -288,13 +277,21 @@ std::string ShellAssistant::explainCommand(const std::string& command) const {
         {"cd", "Changes the current directory (location) in the file system.\nUsage: cd <directory_path>"},
         {"ls", "Lists the contents of a directory.\nUsage: ls [directory_path]"},
         {"cat", "Displays the contents of a file.\nUsage: cat <file_path>"},
+        {"head", "Displays the first bytes of a file without reading the rest.\nUsage: head <file_path> [bytes]"},
+        {"tail", "Displays the last bytes of a file without reading the rest.\nUsage: tail <file_path> [bytes]"},
         {"write", "Writes text content to a file.\nUsage: write <file_path> <content>"},
+        {"append", "Appends text to the end of a file, creating it if needed.\nUsage: append <file_path> <content>"},
+        {"truncate", "Shrinks a file to the given size, or extends it with zero bytes.\nUsage: truncate <file_path> <size>"},
+        {"import", "Copies a file from the host system into the virtual file system.\nUsage: import <host_file> <file_path>"},
         {"rm", "Removes (deletes) a file or directory from the file system.\nUsage: rm <path>"},
         {"help", "Displays help information about available commands.\nUsage: help"},
         {"exit", "Exits the shell.\nUsage: exit"},
         {"save", "Saves the current state of the file system to disk.\nUsage: save [filename]"},
         {"load", "Loads a file system from disk.\nUsage: load [filename]"},
         {"diskinfo", "Displays information about disk usage.\nUsage: diskinfo"},
+        {"compact", "Reclaims node storage left fragmented by mass deletions.\nUsage: compact"},
+        {"dedup", "Shows deduplication statistics, or turns content-addressed block sharing on or off.\nUsage: dedup [on|off]"},
+        {"dcache", "Shows hit and miss counters of the path lookup cache, or changes how many entries it keeps.\nUsage: dcache [capacity]"},
         {"createvolume", "Creates a new virtual disk volume.\nUsage: createvolume <volume_name> <size_in_mb>"},
         {"mount", "Mounts a virtual disk image at a specified mount point.\nUsage: mount <disk_image> <mount_point>"},
         {"unmount", "Unmounts a previously mounted volume.\nUsage: unmount <mount_point>"},
@@ -0,0 +1,143 @@
+#include "../include/TreeIterator.h"
+#include "../include/FileNode.h"
+#include <limits>
+
+TreeIterator::TreeIterator(const FileNode* start, int order)
+    : start(start), current(start), currentDepth(0), order(order),
+      maxDepth(std::numeric_limits<size_t>::max()), directoriesOnly(false),
+      pruned(false), tracking(false), locking(false), startPathLength(0) {
+}
+
+TreeIterator::~TreeIterator() {
+    // A walk abandoned halfway still holds the directories it is inside of
+    for (const Frame& frame : stack) {
+        unlockDirectory(frame.directory);
+    }
+}
+
+void TreeIterator::setMaxDepth(size_t depth) {
+    maxDepth = depth;
+}
+
+void TreeIterator::setDirectoriesOnly(bool only) {
+    directoriesOnly = only;
+}
+
+void TreeIterator::trackPath() {
+    trackPath(start ? start->getPath() : std::string());
+}
+
+void TreeIterator::trackPath(const std::string& startPath) {
+    tracking = true;
+    pathBuffer = startPath;
+    startPathLength = startPath.size();
+}
+
+void TreeIterator::lockDirectories() {
+    locking = true;
+}
+
+void TreeIterator::unlockDirectory(const FileNode* directory) const {
+    if (locking && directory != start) {
+        directory->getLock().unlock_shared();
+    }
+}
+
+void TreeIterator::appendName(std::string& path, const std::string& name) {
+    if (!path.empty() && path.back() != '/') {
+        path += '/';
+    }
+    path += name;
+}
+
+bool TreeIterator::wanted(const FileNode* node) const {
+    return !directoriesOnly || node->isDirectory();
+}
+
+void TreeIterator::next() {
+    if (!current) {
+        return;
+    }
+    
+    if (order == BreadthFirst) {
+        nextBreadthFirst();
+    } else {
+        nextDepthFirst();
+    }
+    pruned = false;
+}
+
+void TreeIterator::nextDepthFirst() {
+    // Descend into the node just visited, unless told not to
+    if (current->isDirectory() && !pruned && currentDepth < maxDepth) {
+        if (locking && current != start) {
+            current->getLock().lock_shared();
+        }
+        if (!current->getChildren().empty()) {
+            stack.push_back(Frame{current, 0, pathBuffer.size()});
+        } else {
+            unlockDirectory(current);
+        }
+    }
+    
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const auto& children = frame.directory->getChildren();
+        
+        while (frame.nextChild < children.size() && !wanted(children[frame.nextChild].get())) {
+            frame.nextChild++;
+        }
+        
+        if (frame.nextChild < children.size()) {
+            current = children[frame.nextChild++].get();
+            currentDepth = stack.size();
+            if (tracking) {
+                pathBuffer.resize(frame.pathLength);
+                appendName(pathBuffer, current->getName());
+            }
+            return;
+        }
+        
+        unlockDirectory(frame.directory);
+        stack.pop_back();
+    }
+    
+    current = nullptr;
+}
+
+void TreeIterator::nextBreadthFirst() {
+    if (current->isDirectory() && !pruned && currentDepth < maxDepth) {
+        for (const auto& child : current->getChildren()) {
+            if (wanted(child.get())) {
+                queue.push_back(Pending{child.get(), currentDepth + 1});
+            }
+        }
+    }
+    
+    if (queue.empty()) {
+        current = nullptr;
+        return;
+    }
+    
+    current = queue.front().node;
+    currentDepth = queue.front().depth;
+    queue.pop_front();
+    
+    if (tracking) {
+        buildPath();
+    }
+}
+
+void TreeIterator::buildPath() {
+    // Breadth-first neighbours share no prefix, so the path is rebuilt from
+    // the start node down, reusing the buffers
+    chain.clear();
+    for (const FileNode* node = current; node != start; node = node->getParent()) {
+        chain.push_back(node);
+    }
+    
+    pathBuffer.resize(startPathLength);
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        appendName(pathBuffer, (*it)->getName());
+    }
+}
@@ -0,0 +1,106 @@
+#include "../include/VfsPath.h"
+#include "../include/FileNode.h"
+#include <algorithm>
+
+VfsPath::VfsPath() : first(0), count(0), absolute(false) {
+}
+
+VfsPath::VfsPath(const std::string& path) : VfsPath(std::string_view(path)) {
+}
+
+VfsPath::VfsPath(const char* path) : VfsPath(std::string_view(path ? path : "")) {
+}
+
+VfsPath::VfsPath(std::string_view path) : first(0), count(0), absolute(!path.empty() && path[0] == '/') {
+    // Components go inline until one of the buffers would overflow; from
+    // then on the whole path lives on the heap
+    std::shared_ptr<Parsed> data;
+    if (path.size() <= kInlineText) {
+        path.copy(inlineText, path.size());
+    } else {
+        data = std::make_shared<Parsed>();
+        data->text.assign(path);
+    }
+    
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+        
+        std::string_view part = path.substr(start, end - start);
+        if (!part.empty() && part != ".") {
+            Component parsedPart{static_cast<uint32_t>(start), static_cast<uint32_t>(part.size()), FileNode::hashName(part)};
+            if (!data && count == kInlineComponents) {
+                data = std::make_shared<Parsed>();
+                data->text.assign(path);
+                data->components.assign(inlineComponents, inlineComponents + count);
+            }
+            if (data) {
+                data->components.push_back(parsedPart);
+            } else {
+                inlineComponents[count] = parsedPart;
+            }
+            count++;
+        }
+        start = end + 1;
+    }
+    
+    parsed = std::move(data);
+}
+
+const VfsPath::Component& VfsPath::component(size_t index) const {
+    return parsed ? parsed->components[first + index] : inlineComponents[first + index];
+}
+
+std::string_view VfsPath::operator[](size_t index) const {
+    const Component& part = component(index);
+    return std::string_view(text() + part.offset, part.length);
+}
+
+size_t VfsPath::hash(size_t index) const {
+    return component(index).hash;
+}
+
+bool VfsPath::isParentRef(size_t index) const {
+    return (*this)[index] == "..";
+}
+
+std::string_view VfsPath::name() const {
+    if (count == 0) {
+        return std::string_view();
+    }
+    return (*this)[count - 1];
+}
+
+VfsPath VfsPath::parent() const {
+    VfsPath result(*this);
+    if (result.count > 0) {
+        result.count--;
+    }
+    return result;
+}
+
+VfsPath VfsPath::suffix(size_t skip) const {
+    VfsPath result(*this);
+    skip = std::min(skip, count);
+    result.first += skip;
+    result.count -= skip;
+    result.absolute = true;
+    return result;
+}
+
+std::string VfsPath::str() const {
+    std::string result;
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0 || absolute) {
+            result += '/';
+        }
+        result += (*this)[i];
+    }
+    if (absolute && count == 0) {
+        result = "/";
+    }
+    return result;
+}
@@ -1,47 +1,171 @@
 #include "../include/VirtualFileSystem.h"
 #include "../include/Compression.h"
 #include "../include/Encryption.h"
+#include "../include/TreeIterator.h"
 #include <sstream>
 #include <algorithm>
 #include <iterator>
 #include <stack>
 #include <filesystem>
+#include <cassert>
+#include <unordered_set>
+#include <unordered_map>
+#include <thread>
+
+namespace {
+
+void lockNode(const FileNode* node, bool exclusive) {
+    if (exclusive) {
+        node->getLock().lock();
+    } else {
+        node->getLock().lock_shared();
+    }
+}
+
+bool tryLockNode(const FileNode* node, bool exclusive) {
+    return exclusive ? node->getLock().try_lock() : node->getLock().try_lock_shared();
+}
+
+void unlockNode(const FileNode* node, bool exclusive) {
+    if (exclusive) {
+        node->getLock().unlock();
+    } else {
+        node->getLock().unlock_shared();
+    }
+}
+
+// The parent directory of a batch operation's path, hashed and compared
+// by its components so that grouping a batch builds no strings
+struct BatchParent {
+    const VfsPath* path;
+
+    size_t depth() const { return path->size() - 1; }
+
+    bool operator==(const BatchParent& other) const {
+        if (path->isAbsolute() != other.path->isAbsolute() || depth() != other.depth()) {
+            return false;
+        }
+        for (size_t i = 0; i < depth(); ++i) {
+            if (path->hash(i) != other.path->hash(i) || (*path)[i] != (*other.path)[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct BatchParentHash {
+    size_t operator()(const BatchParent& parent) const {
+        size_t hash = parent.path->isAbsolute();
+        for (size_t i = 0; i < parent.depth(); ++i) {
+            hash = hash * 31 + parent.path->hash(i);
+        }
+        return hash;
+    }
+};
+
+} // namespace
 
 VirtualFileSystem::VirtualFileSystem(size_t diskSize)
-    : diskSize(diskSize), usedSpace(0) {
+    : treeLock(&nodeArena), currentDirectory(nullptr), anyTags(false), diskSize(diskSize) {
     // Create the root directory
-    root = std::make_unique<FileNode>("/", true);
-    currentDirectory = root.get();
+    root = makeNode("/", true, nullptr);
+    std::lock_guard<std::mutex> guard(cwdLock);
+    setCwd(root.get());
 }
 
 VirtualFileSystem::~VirtualFileSystem() {
+    {
+        std::lock_guard<std::mutex> guard(handlesLock);
+        for (FileHandle* handle : openHandles) {
+            handle->volume = nullptr;
+        }
+        for (FileWriter* writer : openWriters) {
+            writer->volume = nullptr; // Its close() will fail
+            writer->staged.reset();   // The staging arena goes away with the volume
+        }
+        openWriters.clear();
+    }
+    closeHandles();
+    
     // Unmount all volumes before destruction
     auto volumesCopy = listMountedVolumes();
     for (const auto& mountPoint : volumesCopy) {
         unmountVolume(mountPoint);
     }
+    
+    // Retired nodes and names still point into this volume's arenas
+    Epoch::synchronize(&nodeArena);
+    Epoch::synchronize(&stagingArena);
     // FileNode cleanup is handled by smart pointers
 }
 
+void VirtualFileSystem::TreeLock::lock() {
+    rw.lock();
+    excludeReaders();
+}
+
+bool VirtualFileSystem::TreeLock::try_lock() {
+    if (!rw.try_lock()) {
+        return false;
+    }
+    excludeReaders();
+    return true;
+}
+
+void VirtualFileSystem::TreeLock::unlock() {
+    exclusive.store(false, std::memory_order_release);
+    rw.unlock();
+}
+
+void VirtualFileSystem::TreeLock::excludeReaders() {
+    // A reader checks the flag after pinning the epoch, so one that missed
+    // it is still pinned when synchronize() looks, and is waited for.
+    // Readers of other volumes are left alone
+    exclusive.store(true);
+    Epoch::synchronize(readers);
+}
+
+VirtualFileSystem::ReadSection::ReadSection(const VirtualFileSystem& volume, const VfsPath& path)
+    : target(nullptr), position(volume.mountTable.root()) {
+    guard.emplace(&volume.nodeArena);
+    if (volume.treeLock.isExclusive() || !volume.lookupUnlocked(path, target, position)) {
+        guard.reset();
+    }
+}
+
 VirtualFileSystem& VirtualFileSystem::operator=(const VirtualFileSystem& other) {
     if (this != &other) {
+        // The other volume's path operations modify it under its shared
+        // lock, so copying it needs the exclusive one
+        WriteLock lock(treeLock, std::defer_lock);
+        WriteLock otherLock(other.treeLock, std::defer_lock);
+        std::lock(lock, otherLock);
+        
+        nodeArena.blocks().setEnabled(other.nodeArena.blocks().isEnabled());
+        {
+            std::lock_guard<std::mutex> cacheLock(dentryLock);
+            dentries.clear();
+        }
+        closeHandles();
+        
+        mountedVolumes.clear();
+        mountTable.clear();
+        
         if (other.root) {
-            root = std::make_unique<FileNode>(*other.root);
+            root = std::unique_ptr<FileNode>(new (nodeArena) FileNode(nodeArena, *other.root));
             
-            std::string currentPath = other.getCurrentPath();
-            currentDirectory = resolvePath(currentPath);
-            if (!currentDirectory) {
-                currentDirectory = root.get();
-            }
+            FileNode* cwd = lookupPath(VfsPath(other.cwdPath));
+            std::lock_guard<std::mutex> guard(cwdLock);
+            setCwd(cwd ? cwd : root.get());
         } else {
             root = nullptr;
+            std::lock_guard<std::mutex> guard(cwdLock);
             currentDirectory = nullptr;
         }
         
         diskSize = other.diskSize;
-        usedSpace = other.usedSpace;
         
-        mountedVolumes.clear();
         for (const auto& [path, info] : other.mountedVolumes) {
             MountInfo newInfo;
             newInfo.diskImage = info.diskImage;
@@ -49,196 +173,524 @@ VirtualFileSystem& VirtualFileSystem::operator=(const VirtualFileSystem& other)
             newInfo.fs->loadFromDisk(info.diskImage);
             
             std::string mountPath = path;
-            newInfo.mountPoint = resolvePath(mountPath);
+            newInfo.mountPoint = lookupPath(mountPath);
             
+            mountTable.insert(VfsPath(path), newInfo.fs.get());
             mountedVolumes[path] = std::move(newInfo);
         }
+        if (currentDirectory) {
+            std::lock_guard<std::mutex> guard(cwdLock);
+            setCwd(currentDirectory); // The cwd may be under one of the mounts
+        }
         
+        std::lock_guard<std::mutex> tagGuard(tagsLock);
         fileTags = other.fileTags;
+        anyTags.store(!fileTags.empty(), std::memory_order_release);
     }
     return *this;
 }
 
-VirtualFileSystem* VirtualFileSystem::getResponsibleFS(const std::string& path, std::string& localPath) {
-    std::string volumePath = getVolumeForPath(path);
+VirtualFileSystem* VirtualFileSystem::getResponsibleFS(const VfsPath& path, VfsPath& localPath) {
+    size_t consumed = 0;
+    VirtualFileSystem* volume = findMount(path, consumed);
     
-    if (volumePath.empty()) {
+    if (!volume) {
         localPath = path;
         return this;
-    } else {
-        localPath = path.substr(volumePath.length());
-        if (localPath.empty()) {
-            localPath = "/";
-        }
-        return mountedVolumes[volumePath].fs.get();
     }
+    
+    // The rest of the path is absolute within the mounted volume
+    localPath = path.suffix(consumed);
+    return volume;
 }
 
-bool VirtualFileSystem::isMountPoint(const std::string& path) const {
-    return mountedVolumes.find(path) != mountedVolumes.end();
+bool VirtualFileSystem::isMountPoint(const VfsPath& path) const {
+    ReadLock lock(treeLock);
+    return hasMountAt(path);
 }
 
-std::string VirtualFileSystem::getVolumeForPath(const std::string& path) const {
-    std::string normalized = path;
+bool VirtualFileSystem::hasMountAt(const VfsPath& path) const {
+    if (mountTable.empty()) {
+        return false;
+    }
     
-    // Ensure path starts with /
-    if (path.empty() || path[0] != '/') {
-        normalized = currentDirectory->getPath() + 
-                    (path.empty() || path[0] != '/' ? "/" : "") + 
-                    path;
+    MountTable::Cursor cursor = path.isAbsolute() ? mountTable.root() : cwdMountCursor();
+    for (size_t i = 0; i < path.size(); ++i) {
+        cursor = path.isParentRef(i) ? mountTable.up(cursor) : mountTable.advance(cursor, path[i], path.hash(i));
+    }
+    return mountTable.volumeAt(cursor) != nullptr;
+}
+
+VirtualFileSystem* VirtualFileSystem::findMount(const VfsPath& path, size_t& consumed) const {
+    if (mountTable.empty()) {
+        return nullptr;
     }
     
-    // Find the longest matching mount point
-    std::string matchedVolume;
-    for (const auto& [mountPoint, _] : mountedVolumes) {
-        if (normalized.find(mountPoint) == 0) {
-            if (mountPoint.length() > matchedVolume.length()) {
-                matchedVolume = mountPoint;
-            }
+    // The first mount point on the way down is the longest prefix, since
+    // everything below it belongs to the mounted volume
+    MountTable::Cursor cursor = path.isAbsolute() ? mountTable.root() : cwdMountCursor();
+    for (size_t i = 0; i < path.size(); ++i) {
+        cursor = path.isParentRef(i) ? mountTable.up(cursor) : mountTable.advance(cursor, path[i], path.hash(i));
+        
+        if (VirtualFileSystem* volume = mountTable.volumeAt(cursor)) {
+            consumed = i + 1;
+            return volume;
         }
     }
     
-    return matchedVolume;
+    return nullptr;
 }
 
+MountTable::Cursor VirtualFileSystem::mountCursorOf(const FileNode* node) const {
+    // Only consulted while something is mounted; mounting recomputes the cwd's
+    if (mountTable.empty()) {
+        return mountTable.root();
+    }
+    
+    // Ancestors are collected first so deep trees don't recurse
+    std::vector<const FileNode*> chain;
+    for (const FileNode* current = node; current->getParent(); current = current->getParent()) {
+        chain.push_back(current);
+    }
+    MountTable::Cursor cursor = mountTable.root();
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        cursor = mountTable.advance(cursor, (*it)->getName(), (*it)->getNameHash());
+    }
+    return cursor;
+}
 
-bool VirtualFileSystem::mkdir(const std::string& path) {
-    std::string localPath;
-    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+MountTable::Cursor VirtualFileSystem::cwdMountCursor() const {
+    // Kept up to date by cd, moves, removals and mount table changes
+    std::lock_guard<std::mutex> guard(cwdLock);
+    return cwdCursor;
+}
+
+bool VirtualFileSystem::containsMount(const FileNode* node) const {
+    return !mountTable.empty() && mountTable.hasMountsAt(mountCursorOf(node));
+}
+
+FileNode* VirtualFileSystem::resolveParent(const VfsPath& path) {
+    if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+        return nullptr;
+    }
     
-    if (responsibleFS != this) {
-        return responsibleFS->mkdir(localPath);
+    FileNode* parent = lookupPath(path.parent());
+    if (!parent || !parent->isDirectory()) {
+        return nullptr;
+    }
+    return parent;
+}
+
+FileNode* VirtualFileSystem::lookupChild(const FileNode* parent, std::string_view name, size_t hash) const {
+    // Lookups run in parallel, so the cache has a lock of its own; one
+    // that finds it taken looks the name up directly instead of waiting
+    std::unique_lock<std::mutex> cacheLock(dentryLock, std::try_to_lock);
+    if (!cacheLock.owns_lock()) {
+        return parent->findChild(name, hash);
     }
     
-    FileNode* targetParent = currentDirectory;
-    std::string dirName = path;
+    FileNode* child;
+    if (dentries.lookup(parent, name, hash, child)) {
+        return child;
+    }
     
-    if (path.find('/') != std::string::npos) {
-        size_t lastSlash = path.find_last_of('/');
-        std::string parentPath = path.substr(0, lastSlash);
-        dirName = path.substr(lastSlash + 1);
-        
-        if (parentPath.empty() && path[0] == '/') {
-            // Path starts with '/', use root as parent
-            targetParent = root.get();
-        } else {
-            targetParent = resolvePath(parentPath);
-            if (!targetParent || !targetParent->isDirectory()) {
+    // Misses are cached too, so repeated probes for absent names stay cheap
+    child = parent->findChild(name, hash);
+    dentries.insert(parent, name, hash, child);
+    return child;
+}
+
+bool VirtualFileSystem::lookupUnlocked(const VfsPath& path, FileNode*& node, MountTable::Cursor& cursor) const {
+    // The cwd's mount table position is only kept under cwdLock
+    if (!path.isAbsolute() && !mountTable.empty()) {
+        return false;
+    }
+    
+    // Mounts, the root and the mount table only change with the volume
+    // held exclusively, which waits for this walk. The dentry cache is
+    // skipped: updating it would be a write every reader shares
+    FileNode* current = path.isAbsolute() ? root.get() : currentDirectory.load(std::memory_order_acquire);
+    cursor = mountTable.root();
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path.isParentRef(i)) {
+            return false;
+        }
+        if (!mountTable.empty()) {
+            cursor = mountTable.advance(cursor, path[i], path.hash(i));
+            if (mountTable.volumeAt(cursor)) {
                 return false;
             }
         }
+        if (current) {
+            current = current->findChild(path[i], path.hash(i));
+        }
     }
     
-    if (targetParent->findChild(dirName)) {
-        return false;
-    }
+    node = current;
+    return true;
+}
+
+FileNode* VirtualFileSystem::lockChild(FileNode* parent, bool parentExclusive, std::string_view name, size_t hash,
+                                        bool exclusive, bool keepParent) const {
+    // The parent is released only once the child is locked, so nothing can
+    // remove or move the child in between
+    FileNode* child = lookupChild(parent, name, hash);
+    if (child) {
+        lockNode(child, exclusive);
+    }
+    if (!keepParent) {
+        unlockNode(parent, parentExclusive);
+    }
+    return child;
+}
+
+FileNode* VirtualFileSystem::lockRoute(const std::vector<std::string>& route, size_t depth, bool exclusive) const {
+    FileNode* current = root.get();
+    bool currentExclusive = exclusive && depth == 0;
+    lockNode(current, currentExclusive);
     
-    auto newDir = std::make_unique<FileNode>(dirName, true, targetParent);
-    targetParent->addChild(std::move(newDir));
-    updateUsedSpace();
+    for (size_t i = 0; i < depth && current; ++i) {
+        bool last = i + 1 == depth;
+        current = lockChild(current, currentExclusive, route[i], FileNode::hashName(route[i]), last && exclusive);
+        currentExclusive = last && exclusive;
+    }
+    return current;
+}
+
+std::vector<std::string> VirtualFileSystem::absoluteRoute(const VfsPath& path, size_t depth) const {
+    std::vector<std::string> route;
+    if (!path.isAbsolute()) {
+        std::string cwd;
+        {
+            std::lock_guard<std::mutex> guard(cwdLock);
+            cwd = cwdPath;
+        }
+        VfsPath cwdRoute(cwd);
+        for (size_t i = 0; i < cwdRoute.size(); ++i) {
+            route.emplace_back(cwdRoute[i]);
+        }
+    }
     
-    return true;
+    // There are no links, so ".." can be resolved by name
+    for (size_t i = 0; i < depth; ++i) {
+        if (!path.isParentRef(i)) {
+            route.emplace_back(path[i]);
+        } else if (!route.empty()) {
+            route.pop_back();
+        }
+    }
+    return route;
 }
 
-bool VirtualFileSystem::touch(const std::string& path) {
-    std::string localPath;
-    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+FileNode* VirtualFileSystem::lockPath(const VfsPath& path, size_t depth, bool exclusive, NodeLocks& locks) const {
+    bool climbs = false;
+    for (size_t i = 0; i < depth && !climbs; ++i) {
+        climbs = path.isParentRef(i);
+    }
+    if (climbs) {
+        // Going up would lock a parent after its child, so such paths are
+        // resolved to names and walked down from the root instead
+        std::vector<std::string> route = absoluteRoute(path, depth);
+        FileNode* node = lockRoute(route, route.size(), exclusive);
+        if (node) {
+            locks.adopt(node, exclusive);
+        }
+        return node;
+    }
     
-    if (responsibleFS != this) {
-        return responsibleFS->touch(localPath);
+    FileNode* current = nullptr;
+    bool currentExclusive = exclusive && depth == 0;
+    if (path.isAbsolute()) {
+        current = root.get();
+        lockNode(current, currentExclusive);
+    } else {
+        // Waiting for the cwd with cwdLock held could deadlock against
+        // whoever is moving it, so a busy cwd is reached by its path instead
+        std::string cwd;
+        {
+            std::lock_guard<std::mutex> guard(cwdLock);
+            if (tryLockNode(currentDirectory, currentExclusive)) {
+                current = currentDirectory;
+            } else {
+                cwd = cwdPath;
+            }
+        }
+        if (!current) {
+            VfsPath cwdRoute(cwd);
+            std::vector<std::string> route = absoluteRoute(cwdRoute, cwdRoute.size());
+            current = lockRoute(route, route.size(), currentExclusive);
+            if (!current) {
+                return nullptr;
+            }
+        }
+    }
+    
+    for (size_t i = 0; i < depth && current; ++i) {
+        // Components carry their hash, so lookups don't rehash the name
+        bool last = i + 1 == depth;
+        current = lockChild(current, currentExclusive, path[i], path.hash(i), last && exclusive);
+        currentExclusive = last && exclusive;
     }
     
-    FileNode* targetParent = currentDirectory;
-    std::string fileName = path;
+    if (current) {
+        locks.adopt(current, exclusive);
+    }
+    return current;
+}
+
+FileNode* VirtualFileSystem::lockTarget(const VfsPath& path, bool exclusive, NodeLocks& locks) const {
+    return lockPath(path, path.size(), exclusive, locks);
+}
+
+FileNode* VirtualFileSystem::lockParent(const VfsPath& path, NodeLocks& locks) const {
+    if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+        return nullptr;
+    }
+    
+    FileNode* parent = lockPath(path, path.size() - 1, true, locks);
+    if (!parent || !parent->isDirectory()) {
+        return nullptr;
+    }
+    return parent;
+}
+
+void VirtualFileSystem::lockSubtree(const FileNode* node, bool exclusive, NodeLocks& locks) const {
+    // Pre-order, so each directory is locked before its children are read
+    // and every node after its parent
+    TreeIterator walk(node);
+    for (walk.next(); !walk.done(); walk.next()) {
+        locks.lock(walk.node(), exclusive);
+    }
+}
+
+void VirtualFileSystem::NodeLocks::lock(const FileNode* node, bool exclusive) {
+    lockNode(node, exclusive);
+    held.emplace_back(node, exclusive);
+}
+
+void VirtualFileSystem::NodeLocks::adopt(const FileNode* node, bool exclusive) {
+    held.emplace_back(node, exclusive);
+}
+
+bool VirtualFileSystem::NodeLocks::holds(const FileNode* node) const {
+    for (const auto& [heldNode, _] : held) {
+        if (heldNode == node) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void VirtualFileSystem::NodeLocks::releaseAll() {
+    while (!held.empty()) {
+        unlockNode(held.back().first, held.back().second);
+        held.pop_back();
+    }
+}
+
+void VirtualFileSystem::forgetSubtree(const FileNode* node, const NodeLocks* subtree) {
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        if (node->getParent()) {
+            dentries.invalidate(node->getParent(), node->getName(), node->getNameHash());
+        }
+        
+        // Only directories have cached child entries
+        TreeIterator walk(node);
+        walk.setDirectoriesOnly(true);
+        for (; !walk.done(); walk.next()) {
+            dentries.invalidateChildren(walk.node());
+        }
+    }
     
-    if (path.find('/') != std::string::npos) {
-        size_t lastSlash = path.find_last_of('/');
-        std::string parentPath = path.substr(0, lastSlash);
-        fileName = path.substr(lastSlash + 1);
+    closeHandles(node, subtree);
+}
+
+void VirtualFileSystem::closeHandles(const FileNode* node, const NodeLocks* subtree) {
+    std::lock_guard<std::mutex> guard(handlesLock);
+    for (auto it = openHandles.begin(); it != openHandles.end();) {
+        FileHandle* handle = *it;
+        
+        // Other handles' nodes may be moving, so under node locks their
+        // parents can't be followed; the subtree's own locks tell instead
+        bool inside = !node;
+        if (!inside && subtree) {
+            inside = subtree->holds(handle->node);
+        }
+        for (const FileNode* current = handle->node; current && !inside && !subtree; current = current->getParent()) {
+            inside = current == node;
+        }
         
-        if (parentPath.empty() && path[0] == '/') {
-            targetParent = root.get();
+        if (inside) {
+            // The volume pointer stays, since the handle's own thread may be
+            // reading it; the handle fails once it sees the node is gone
+            handle->node = nullptr;
+            it = openHandles.erase(it);
         } else {
-            targetParent = resolvePath(parentPath);
-            if (!targetParent || !targetParent->isDirectory()) {
-                return false;
+            ++it;
+        }
+    }
+}
+
+void VirtualFileSystem::releaseHandle(FileHandle* handle) {
+    std::lock_guard<std::mutex> guard(handlesLock);
+    openHandles.erase(handle);
+}
+
+FileNode* VirtualFileSystem::pinHandle(const FileHandle* handle, bool exclusive) {
+    // Removal locks the node before it takes handlesLock to close the
+    // handle, so waiting for the node here would deadlock; try and back off
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(handlesLock);
+            if (!handle->node) {
+                return nullptr;
+            }
+            if (tryLockNode(handle->node, exclusive)) {
+                return handle->node;
             }
         }
+        std::this_thread::yield();
+    }
+}
+
+void VirtualFileSystem::releaseWriter(FileWriter* writer) {
+    std::lock_guard<std::mutex> guard(handlesLock);
+    openWriters.erase(writer);
+    writer->staged.reset(); // Frees into the staging arena, which writers share
+}
+
+void VirtualFileSystem::retagSubtree(const std::string& oldPath, const std::string& newPath) {
+    std::lock_guard<std::mutex> guard(tagsLock);
+    std::map<std::string, std::vector<std::string>> moved;
+    for (auto it = fileTags.begin(); it != fileTags.end();) {
+        const std::string& taggedPath = it->first;
+        bool inside = taggedPath.compare(0, oldPath.size(), oldPath) == 0 &&
+                      (taggedPath.size() == oldPath.size() || taggedPath[oldPath.size()] == '/');
+        if (inside) {
+            moved[newPath + taggedPath.substr(oldPath.size())] = std::move(it->second);
+            it = fileTags.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    for (auto& [taggedPath, tags] : moved) {
+        fileTags[taggedPath] = std::move(tags);
+    }
+}
+
+
+bool VirtualFileSystem::mkdir(const VfsPath& path) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->mkdir(localPath);
     }
     
-    if (targetParent->findChild(fileName)) {
+    NodeLocks locks;
+    FileNode* targetParent = lockParent(path, locks);
+    if (!targetParent || !createChild(targetParent, path, true)) {
         return false;
     }
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::touch(const VfsPath& path) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
-    auto newFile = std::make_unique<FileNode>(fileName, false, targetParent);
-    targetParent->addChild(std::move(newFile));
-    updateUsedSpace();
+    if (responsibleFS != this) {
+        return responsibleFS->touch(localPath);
+    }
     
+    NodeLocks locks;
+    FileNode* targetParent = lockParent(path, locks);
+    if (!targetParent || !createChild(targetParent, path, false)) {
+        return false;
+    }
+    checkUsedSpace();
     return true;
 }
 
-bool VirtualFileSystem::cd(const std::string& path) {
-    if (path == "/") {
-        currentDirectory = root.get();
-        return true;
-    } else if (path == "..") {
-        if (currentDirectory->getParent()) {
-            currentDirectory = currentDirectory->getParent();
-            return true;
-        }
+bool VirtualFileSystem::createChild(FileNode* parent, const VfsPath& path, bool isDirectory) {
+    std::string name(path.name());
+    size_t nameHash = path.hash(path.size() - 1);
+    if (parent->findChild(name, nameHash)) {
         return false;
     }
     
-    std::string fullPath = path[0] == '/' ? path : (currentDirectory->getPath() + "/" + path);
-    if (isMountPoint(fullPath)) {
-        // We can't cd into a mount point, as it's a different filesystem
+    parent->addChild(makeNode(name, isDirectory, parent));
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.invalidate(parent, name, nameHash);
+    return true;
+}
+
+bool VirtualFileSystem::cd(const VfsPath& path) {
+    ReadLock lock(treeLock);
+    if (!path.isAbsolute() && path.size() == 1 && path.isParentRef(0) && getCurrentPath() == "/") {
         return false;
     }
     
-    std::string localPath;
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
-        // Can't cd across filesystems
+        // Mount points and everything under them belong to another file system
         return false;
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, false, locks);
     if (target && target->isDirectory()) {
-        currentDirectory = target;
+        std::lock_guard<std::mutex> guard(cwdLock);
+        setCwd(target);
         return true;
     }
     
     return false;
 }
 
-std::vector<std::string> VirtualFileSystem::ls(const std::string& path) {
-    std::string localPath;
+std::vector<std::string> VirtualFileSystem::ls(const VfsPath& path) {
+    {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            return listNames(read.node());
+        }
+    }
+    
+    ReadLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->ls(localPath);
     }
     
-    FileNode* target = currentDirectory;
-    
-    if (!path.empty()) {
-        target = resolvePath(path);
-        if (!target || !target->isDirectory()) {
-            return {};
-        }
+    NodeLocks locks;
+    return listNames(lockTarget(path, false, locks));
+}
+
+std::vector<std::string> VirtualFileSystem::listNames(const FileNode* directory) const {
+    if (!directory || !directory->isDirectory()) {
+        return {};
     }
     
     std::vector<std::string> result;
-    for (const auto& child : target->getChildren()) {
-        std::string entry = child->getName();
+    Epoch::Guard guard(&nodeArena);
+    directory->forEachChild([&](FileNode* child, const std::string& name, size_t) {
+        std::string entry = name;
         if (child->isDirectory()) {
             entry += "/";
         }
         result.push_back(entry);
-    }
+    });
     
-    if (target == root.get()) {
+    if (directory == root.get()) {
         for (const auto& [mountPoint, _] : mountedVolumes) {
             std::string mountName = mountPoint;
             if (mountPoint.length() > 1) {  // Skip the root
@@ -257,95 +709,808 @@ std::vector<std::string> VirtualFileSystem::ls(const std::string& path) {
     return result;
 }
 
-std::string VirtualFileSystem::cat(const std::string& path) {
-    std::string localPath;
+std::vector<DirEntry> VirtualFileSystem::list(const VfsPath& path) {
+    {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            return listEntries(read.node(), read.cursor());
+        }
+    }
+    
+    ReadLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->list(localPath);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, false, locks);
+    if (!target || !target->isDirectory()) {
+        return {};
+    }
+    
+    MountTable::Cursor cursor = mountTable.root();
+    if (!mountTable.empty()) {
+        std::lock_guard<std::mutex> guard(cwdLock);
+        cursor = target == currentDirectory ? cwdCursor : mountCursorOf(target);
+    }
+    return listEntries(target, cursor);
+}
+
+std::vector<DirEntry> VirtualFileSystem::listEntries(const FileNode* directory, MountTable::Cursor cursor) const {
+    if (!directory || !directory->isDirectory()) {
+        return {};
+    }
+    
+    // Files are read through their published snapshots, so none of them
+    // needs locking even on the locked route
+    std::vector<DirEntry> result;
+    Epoch::Guard guard(&nodeArena);
+    directory->forEachChild([&](FileNode* child, const std::string& name, size_t hash) {
+        DirEntry entry;
+        entry.name = name;
+        entry.isDirectory = child->isDirectory();
+        
+        FileNode::Attributes attributes = child->getAttributes();
+        entry.modified = attributes.modified; // Directories have no versions
+        if (entry.isDirectory) {
+            entry.isMountPoint = !mountTable.empty() &&
+                mountTable.volumeAt(mountTable.advance(cursor, name, hash)) != nullptr;
+        } else {
+            entry.versions = attributes.versions;
+            entry.size = attributes.size;
+            entry.storedSize = attributes.storedSize;
+            entry.compressed = attributes.compressed;
+            entry.encrypted = attributes.encrypted;
+        }
+        result.push_back(entry);
+    });
+    
+    return result;
+}
+
+std::string VirtualFileSystem::cat(const VfsPath& path) {
+    {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            const FileNode* target = read.node();
+            return target && !target->isDirectory() ? target->getContent() : "";
+        }
+    }
+    
+    ReadLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->cat(localPath);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, false, locks);
+    
+    if (target && !target->isDirectory()) {
+        return target->getContent();
+    }
+    
+    return "";
+}
+
+bool VirtualFileSystem::read(const VfsPath& path, size_t offset, size_t length, std::string& out) {
+    {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            const FileNode* target = read.node();
+            if (!target || target->isDirectory()) {
+                return false;
+            }
+            out = target->readAt(offset, length);
+            return true;
+        }
+    }
+    
+    ReadLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->read(localPath, offset, length, out);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, false, locks);
+    if (!target || target->isDirectory()) {
+        return false;
+    }
+    
+    out = target->readAt(offset, length);
+    return true;
+}
+
+bool VirtualFileSystem::write(const VfsPath& path, const std::string& content) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->write(localPath, content);
+    }
+    
+    if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+        return false;
+    }
+    
+    // Existing files are written with only themselves locked exclusively,
+    // so writers of different files in one directory don't serialize
+    NodeLocks locks;
+    if (FileNode* target = lockTarget(path, true, locks)) {
+        if (target->isDirectory()) {
+            return false;
+        }
+        target->setContent(content);
+        checkUsedSpace();
+        return true;
+    }
+    
+    FileNode* targetParent = lockParent(path, locks);
+    if (!targetParent || !writeChild(targetParent, path, content, true)) {
+        return false;
+    }
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::writeChild(FileNode* parent, const VfsPath& path, const std::string& content, bool lockNodes) {
+    size_t nameHash = path.hash(path.size() - 1);
+    FileNode* target = lookupChild(parent, path.name(), nameHash);
+    if (target) {
+        if (target->isDirectory()) {
+            return false;
+        }
+        std::unique_lock<NodeLock> targetLock;
+        if (lockNodes) {
+            targetLock = std::unique_lock<NodeLock>(target->getLock());
+        }
+        target->setContent(content);
+        return true;
+    }
+    
+    auto newFile = makeNode(std::string(path.name()), false, parent);
+    newFile->setContent(content);
+    parent->addChild(std::move(newFile));
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.invalidate(parent, path.name(), nameHash);
+    return true;
+}
+
+bool VirtualFileSystem::writeAt(const VfsPath& path, size_t offset, const std::string& data) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->writeAt(localPath, offset, data);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
+    if (!target || target->isDirectory()) {
+        return false;
+    }
+    
+    target->writeAt(offset, data);
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::append(const VfsPath& path, const std::string& data) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->append(localPath, data);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
+    if (!target) {
+        // Appending to a missing file creates it, unless someone else
+        // created it after the first lookup
+        FileNode* targetParent = lockParent(path, locks);
+        if (!targetParent) {
+            return false;
+        }
+        target = targetParent->findChild(path.name(), path.hash(path.size() - 1));
+        if (!target) {
+            if (!writeChild(targetParent, path, data, true)) {
+                return false;
+            }
+            checkUsedSpace();
+            return true;
+        }
+        locks.lock(target, true);
+    }
+    
+    if (target->isDirectory()) {
+        return false;
+    }
+    
+    target->append(data);
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::truncate(const VfsPath& path, size_t newSize) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->truncate(localPath, newSize);
+    }
+    
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
+    if (!target || target->isDirectory()) {
+        return false;
+    }
+    
+    target->truncate(newSize);
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::remove(const VfsPath& path) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
-    if (responsibleFS != this) {
-        return responsibleFS->cat(localPath);
+    if (responsibleFS != this) {
+        return responsibleFS->remove(localPath);
+    }
+    
+    if (!unlink(path)) {
+        return false;
+    }
+    checkUsedSpace();
+    return true;
+}
+
+bool VirtualFileSystem::unlink(const VfsPath& path) {
+    // Paths naming their target by ".", ".." or nothing at all are spelled
+    // out, so the parent can be locked before the target
+    if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+        std::string absolute;
+        for (const std::string& name : absoluteRoute(path, path.size())) {
+            absolute += "/" + name;
+        }
+        return !absolute.empty() && unlink(VfsPath(absolute));
+    }
+    
+    NodeLocks locks;
+    FileNode* parent = lockParent(path, locks);
+    if (!parent) {
+        return false;
+    }
+    
+    FileNode* target = lookupChild(parent, path.name(), path.hash(path.size() - 1));
+    return target && removeNode(target, true);
+}
+
+bool VirtualFileSystem::removeNode(FileNode* target, bool lockNodes) {
+    // Mount points, and directories holding them, stay until unmounted
+    if (containsMount(target)) {
+        return false;
+    }
+    
+    FileNode* parent = target->getParent();
+    if (!parent) {
+        return false;
+    }
+    
+    // With the parent locked nobody new can get in; locking the whole
+    // subtree waits for everyone still inside it
+    NodeLocks subtree;
+    if (lockNodes) {
+        subtree.lock(target, true);
+        lockSubtree(target, true, subtree);
+    }
+    
+    // Removing the cwd or one of its ancestors leaves the cwd at the parent
+    {
+        std::lock_guard<std::mutex> guard(cwdLock);
+        bool inside = lockNodes && subtree.holds(currentDirectory);
+        for (FileNode* node = currentDirectory; node && !inside && !lockNodes; node = node->getParent()) {
+            inside = node == target;
+        }
+        if (inside) {
+            setCwd(parent);
+        }
+    }
+    
+    forgetSubtree(target, lockNodes ? &subtree : nullptr);
+    subtree.releaseAll(); // Unreachable now, so nobody can be waiting for these
+    parent->removeChild(target->getName());
+    return true;
+}
+
+
+std::vector<bool> VirtualFileSystem::applyBatch(const std::vector<BatchOp>& ops) {
+    WriteLock lock(treeLock);
+    std::vector<bool> results(ops.size(), false);
+    
+    // Operations are grouped by parent directory before anything runs.
+    // They still run in order, since later ones may depend on earlier ones
+    // (a mkdir, then files inside it), but each group resolves its parent
+    // once, on its first operation, and grows the parent's child index
+    // once for every entry the group may add
+    struct Group {
+        VirtualFileSystem* volume = nullptr;
+        FileNode* parent = nullptr; // Null until resolved
+        size_t additions = 0;
+    };
+    constexpr size_t kNoGroup = static_cast<size_t>(-1);
+    std::vector<Group> groups;
+    std::vector<size_t> groupOf(ops.size(), kNoGroup);
+    std::unordered_map<BatchParent, size_t, BatchParentHash> groupIndex;
+    
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const VfsPath& path = ops[i].path;
+        if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+            continue;
+        }
+        
+        auto it = groupIndex.emplace(BatchParent{&path}, groups.size()).first;
+        if (it->second == groups.size()) {
+            groups.emplace_back();
+        }
+        groupOf[i] = it->second;
+        
+        BatchOp::Type type = ops[i].type;
+        if (type == BatchOp::Type::Mkdir || type == BatchOp::Type::Touch || type == BatchOp::Type::Write) {
+            groups[it->second].additions++;
+        }
+    }
+    
+    std::unordered_set<VirtualFileSystem*> touched;
+    
+    // Mounted volumes are locked, after this one, the first time the batch
+    // routes an operation to them, and stay locked until it is done
+    std::vector<WriteLock> volumeLocks;
+    auto enter = [&](VirtualFileSystem* volume) {
+        if (volume != this && touched.insert(volume).second) {
+            volumeLocks.emplace_back(volume->treeLock);
+        }
+    };
+    
+    for (size_t i = 0; i < ops.size(); ++i) {
+        if (groupOf[i] == kNoGroup) {
+            continue;
+        }
+        const BatchOp& op = ops[i];
+        const VfsPath& path = op.path;
+        
+        if (hasMountAt(path)) {
+            // The path is the root of the mounted volume, which can only be
+            // tagged; it can't be created, written or removed
+            if (op.type == BatchOp::Type::AddTag) {
+                VfsPath localPath;
+                VirtualFileSystem* volume = getResponsibleFS(path, localPath);
+                enter(volume);
+                volume->tagNode(volume->root.get(), op.data);
+                results[i] = true;
+            }
+            continue;
+        }
+        
+        // Failed lookups aren't kept, since a later mkdir may fix them
+        Group& group = groups[groupOf[i]];
+        if (!group.parent) {
+            VfsPath localPath;
+            VirtualFileSystem* volume = getResponsibleFS(path.parent(), localPath);
+            enter(volume);
+            FileNode* parent = volume->lookupPath(localPath);
+            if (!parent || !parent->isDirectory()) {
+                continue;
+            }
+            parent->reserveChildren(group.additions);
+            group.additions = 0;
+            group.volume = volume;
+            group.parent = parent;
+        }
+        
+        VirtualFileSystem* volume = group.volume;
+        FileNode* parent = group.parent;
+        touched.insert(volume);
+        
+        switch (op.type) {
+            case BatchOp::Type::Mkdir:
+                results[i] = volume->createChild(parent, path, true);
+                break;
+            case BatchOp::Type::Touch:
+                results[i] = volume->createChild(parent, path, false);
+                break;
+            case BatchOp::Type::Write:
+                results[i] = volume->writeChild(parent, path, op.data, false);
+                break;
+            case BatchOp::Type::Remove: {
+                FileNode* target = volume->lookupChild(parent, path.name(), path.hash(path.size() - 1));
+                bool isDirectory = target && target->isDirectory();
+                results[i] = target && volume->removeNode(target, false);
+                if (results[i] && isDirectory) {
+                    // Resolved parents may have been inside it
+                    for (Group& other : groups) {
+                        other.parent = nullptr;
+                    }
+                }
+                break;
+            }
+            case BatchOp::Type::AddTag: {
+                FileNode* target = volume->lookupChild(parent, path.name(), path.hash(path.size() - 1));
+                if (target) {
+                    volume->tagNode(target, op.data);
+                    results[i] = true;
+                }
+                break;
+            }
+        }
+    }
+    
+    for (VirtualFileSystem* volume : touched) {
+        volume->checkUsedSpace();
+    }
+    return results;
+}
+
+bool VirtualFileSystem::copy(const VfsPath& sourcePath, const VfsPath& destPath) {
+    PathLock lock(treeLock);
+    VfsPath sourceLocal;
+    VfsPath destLocal;
+    VirtualFileSystem* sourceFS = getResponsibleFS(sourcePath, sourceLocal);
+    VirtualFileSystem* destFS = getResponsibleFS(destPath, destLocal);
+    
+    return transfer(sourceFS, sourceLocal, destFS, destLocal, false);
+}
+
+bool VirtualFileSystem::transfer(VirtualFileSystem* sourceFS, const VfsPath& sourceLocal,
+                                 VirtualFileSystem* destFS, const VfsPath& destLocal, bool removeSource) {
+    if (destLocal.size() == 0 || destLocal.isParentRef(destLocal.size() - 1)) {
+        return false;
+    }
+    
+    // This volume is already locked; mounted ones are locked after it, the
+    // two of them in address order
+    VirtualFileSystem* first = sourceFS != this ? sourceFS : nullptr;
+    VirtualFileSystem* second = destFS != this && destFS != sourceFS ? destFS : nullptr;
+    if (first && second && second < first) {
+        std::swap(first, second);
+    }
+    PathLock firstLock;
+    PathLock secondLock;
+    if (first) {
+        firstLock = PathLock(first->treeLock);
+    }
+    if (second) {
+        secondLock = PathLock(second->treeLock);
+    }
+    
+    // The copy is taken before anything is replaced or linked, so copying a
+    // directory into itself or over one of its own files stays well defined
+    std::unique_ptr<FileNode> copy = sourceFS->snapshotNode(sourceLocal, destFS->nodeArena, std::string(destLocal.name()));
+    if (!copy || !destFS->linkCopy(std::move(copy), destLocal)) {
+        return false;
+    }
+    destFS->checkUsedSpace();
+    
+    if (removeSource) {
+        if (!sourceFS->unlink(sourceLocal)) {
+            return false;
+        }
+        sourceFS->checkUsedSpace();
+    }
+    return true;
+}
+
+std::unique_ptr<FileNode> VirtualFileSystem::snapshotNode(const VfsPath& path, NodeArena& arena, const std::string& name) {
+    NodeLocks locks;
+    FileNode* source = lockTarget(path, false, locks);
+    if (!source || !source->getParent()) {
+        return nullptr;
+    }
+    
+    lockSubtree(source, false, locks);
+    return std::unique_ptr<FileNode>(new (arena) FileNode(arena, *source, name));
+}
+
+bool VirtualFileSystem::linkCopy(std::unique_ptr<FileNode> copy, const VfsPath& path) {
+    NodeLocks locks;
+    FileNode* targetParent = lockParent(path, locks);
+    if (!targetParent) {
+        return false;
+    }
+    std::string name(path.name());
+    size_t nameHash = path.hash(path.size() - 1);
+    
+    FileNode* existing = targetParent->findChild(name, nameHash);
+    if (existing) {
+        if (existing->isDirectory() || copy->isDirectory()) {
+            return false;
+        }
+        NodeLocks replaced;
+        replaced.lock(existing, true);
+        forgetSubtree(existing, &replaced);
+        replaced.releaseAll();
+        targetParent->removeChild(name);
+    }
+    
+    targetParent->addChild(std::move(copy));
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.invalidate(targetParent, name, nameHash);
+    return true;
+}
+
+bool VirtualFileSystem::move(const VfsPath& sourcePath, const VfsPath& destPath) {
+    PathLock lock(treeLock);
+    VfsPath sourceLocal;
+    VfsPath destLocal;
+    VirtualFileSystem* sourceFS = getResponsibleFS(sourcePath, sourceLocal);
+    VirtualFileSystem* destFS = getResponsibleFS(destPath, destLocal);
+    
+    if (sourceFS != destFS) {
+        // Nodes can't be relinked across volumes
+        return transfer(sourceFS, sourceLocal, destFS, destLocal, true);
+    }
+    
+    if (sourceFS != this) {
+        return sourceFS->move(sourceLocal, destLocal);
+    }
+    
+    if (destPath.size() == 0 || destPath.isParentRef(destPath.size() - 1)) {
+        return false;
+    }
+    
+    // Both directories are spelled out from the root, so the walk can go
+    // down to where they part and then down each branch (see the lock
+    // ordering in the header)
+    std::vector<std::string> sourceRoute = absoluteRoute(sourcePath, sourcePath.size());
+    std::vector<std::string> destRoute = absoluteRoute(destPath, destPath.size() - 1);
+    if (sourceRoute.empty()) {
+        return false;
+    }
+    std::string sourceName = sourceRoute.back();
+    sourceRoute.pop_back();
+    
+    size_t common = 0;
+    while (common < sourceRoute.size() && common < destRoute.size() && sourceRoute[common] == destRoute[common]) {
+        common++;
+    }
+    
+    std::lock_guard<std::mutex> renaming(renameLock);
+    NodeLocks locks;
+    
+    bool topIsParent = common == sourceRoute.size() || common == destRoute.size();
+    FileNode* top = lockRoute(sourceRoute, common, topIsParent);
+    if (!top) {
+        return false;
+    }
+    locks.adopt(top, topIsParent);
+    
+    auto lockBranch = [&](const std::vector<std::string>& route) -> FileNode* {
+        if (route.size() == common) {
+            return top;
+        }
+        FileNode* current = lockChild(top, topIsParent, route[common], FileNode::hashName(route[common]),
+                                      common + 1 == route.size(), true);
+        for (size_t i = common + 1; i < route.size() && current; ++i) {
+            current = lockChild(current, false, route[i], FileNode::hashName(route[i]), i + 1 == route.size());
+        }
+        if (current) {
+            locks.adopt(current, true);
+        }
+        return current;
+    };
+    
+    FileNode* sourceParent = lockBranch(sourceRoute);
+    FileNode* targetParent = sourceParent ? lockBranch(destRoute) : nullptr;
+    if (!targetParent || !sourceParent->isDirectory() || !targetParent->isDirectory()) {
+        return false;
+    }
+    
+    FileNode* source = lookupChild(sourceParent, sourceName, FileNode::hashName(sourceName));
+    if (!source) {
+        return false;
+    }
+    
+    // A directory can't move into its own subtree, and mounted volumes stay put
+    for (FileNode* node = targetParent; node; node = node->getParent()) {
+        if (node == source) {
+            return false;
+        }
+    }
+    if (containsMount(source)) {
+        return false;
+    }
+    
+    std::string name(destPath.name());
+    size_t nameHash = destPath.hash(destPath.size() - 1);
+    FileNode* existing = targetParent->findChild(name, nameHash);
+    if (existing == source) {
+        return true;
+    }
+    
+    // Everyone inside the moved subtree has to be out of it before paths
+    // under it change
+    NodeLocks moved;
+    moved.lock(source, true);
+    lockSubtree(source, true, moved);
+    
+    if (existing) {
+        if (existing->isDirectory() || source->isDirectory()) {
+            return false;
+        }
+        NodeLocks replaced;
+        replaced.lock(existing, true);
+        forgetSubtree(existing, &replaced);
+        replaced.releaseAll();
+        targetParent->removeChild(name);
     }
     
-    FileNode* target = resolvePath(path);
+    std::string oldPath = source->getPath();
+    FileNode* oldParent = source->getParent();
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        dentries.invalidate(oldParent, source->getName(), source->getNameHash());
+    }
     
-    if (target && !target->isDirectory()) {
-        return target->getContent();
+    std::unique_ptr<FileNode> node = oldParent->detachChild(source->getName());
+    node->setName(name);
+    targetParent->addChild(std::move(node));
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        dentries.invalidate(targetParent, name, nameHash);
     }
     
-    return "";
+    retagSubtree(oldPath, source->getPath());
+    {
+        std::lock_guard<std::mutex> guard(cwdLock);
+        if (moved.holds(currentDirectory)) {
+            setCwd(currentDirectory); // Its path changed
+        }
+    }
+    checkUsedSpace();
+    return true;
 }
 
-bool VirtualFileSystem::write(const std::string& path, const std::string& content) {
-    std::string localPath;
+std::unique_ptr<FileHandle> VirtualFileSystem::open(const VfsPath& path, unsigned flags) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
-        return responsibleFS->write(localPath, content);
+        // The handle belongs to the volume that owns the node
+        return responsibleFS->open(localPath, flags);
     }
     
-    FileNode* target = resolvePath(path);
-    
-    if (!target) {
-        size_t lastSlash = path.find_last_of('/');
-        if (lastSlash != std::string::npos) {
-            std::string dirPath = path.substr(0, lastSlash);
-            std::string fileName = path.substr(lastSlash + 1);
-            
-            FileNode* parent = resolvePath(dirPath);
-            if (parent && parent->isDirectory()) {
-                auto newFile = std::make_unique<FileNode>(fileName, false, parent);
-                newFile->setContent(content);
-                parent->addChild(std::move(newFile));
-                updateUsedSpace();
-                return true;
-            }
-            return false;
-        } else {
-            auto newFile = std::make_unique<FileNode>(path, false, currentDirectory);
-            newFile->setContent(content);
-            currentDirectory->addChild(std::move(newFile));
-            updateUsedSpace();
-            return true;
+    bool truncating = (flags & FileHandle::Truncate) && (flags & FileHandle::Write);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, truncating, locks);
+    if (!target && (flags & FileHandle::Create)) {
+        FileNode* parent = lockParent(path, locks);
+        if (!parent) {
+            return nullptr;
+        }
+        // Someone else may have created it since the first lookup
+        createChild(parent, path, false);
+        target = parent->findChild(path.name(), path.hash(path.size() - 1));
+        if (target) {
+            locks.lock(target, truncating);
         }
+        checkUsedSpace();
+    }
+    if (!target || target->isDirectory()) {
+        return nullptr;
     }
     
-    if (!target->isDirectory()) {
-        size_t oldSize = target->getSize();
-        target->setContent(content);
-        usedSpace = usedSpace - oldSize + content.size();
-        return true;
+    if (truncating && target->getSize() > 0) {
+        target->truncate(0);
+        checkUsedSpace();
     }
     
-    return false;
+    std::unique_ptr<FileHandle> handle(new FileHandle(target, this, flags));
+    std::lock_guard<std::mutex> guard(handlesLock);
+    openHandles.insert(handle.get());
+    return handle;
 }
 
-bool VirtualFileSystem::remove(const std::string& path) {
-    std::string localPath;
+std::unique_ptr<FileWriter> VirtualFileSystem::createWriter(const VfsPath& path) {
+    ReadLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
-        return responsibleFS->remove(localPath);
+        return responsibleFS->createWriter(localPath);
     }
     
-    FileNode* target = resolvePath(path);
-    if (!target) {
-        return false;
+    if (path.size() == 0 || path.isParentRef(path.size() - 1)) {
+        return nullptr;
+    }
+    NodeLocks locks;
+    FileNode* parent = lockPath(path, path.size() - 1, false, locks);
+    if (!parent || !parent->isDirectory()) {
+        return nullptr;
+    }
+    std::string name(path.name());
+    FileNode* target = lockChild(parent, false, name, path.hash(path.size() - 1), false, true);
+    if (target) {
+        locks.adopt(target, false);
+    }
+    if (target && target->isDirectory()) {
+        return nullptr;
     }
     
-    if (isMountPoint(target->getPath())) {
-        return false;
+    // Content is staged outside the volume, encoded the way the file
+    // already is so committing can share the payloads
+    std::unique_ptr<FileNode> staged(new (stagingArena) FileNode(stagingArena, name, false, nullptr));
+    if (target && target->isCompressed()) {
+        staged->setCompressed(true, target->getCompressionAlgorithm());
+    }
+    if (target && target->isEncrypted()) {
+        staged->setEncrypted(true, target->getEncryptionKey(), target->getEncryptionAlgorithm());
     }
     
-    FileNode* parent = target->getParent();
+    // Anchored to the directory as it is now, whatever the cwd is later
+    std::string parentPath = parent->getPath();
+    VfsPath absolutePath(parentPath + (parentPath == "/" ? "" : "/") + name);
+    
+    std::unique_ptr<FileWriter> writer(new FileWriter(this, absolutePath, std::move(staged)));
+    std::lock_guard<std::mutex> guard(handlesLock);
+    openWriters.insert(writer.get());
+    return writer;
+}
+
+bool VirtualFileSystem::commitWriter(const VfsPath& path, const FileNode& staged) {
+    PathLock lock(treeLock);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
+    if (target) {
+        if (target->isDirectory()) {
+            return false;
+        }
+        target->adoptContent(staged);
+        checkUsedSpace();
+        return true;
+    }
+    
+    FileNode* parent = lockParent(path, locks);
     if (!parent) {
         return false;
     }
     
-    parent->removeChild(target->getName());
-    updateUsedSpace();
+    if (FileNode* existing = parent->findChild(path.name(), path.hash(path.size() - 1))) {
+        // Created since the first lookup
+        if (existing->isDirectory()) {
+            return false;
+        }
+        locks.lock(existing, true);
+        existing->adoptContent(staged);
+        checkUsedSpace();
+        return true;
+    }
+    
+    auto newFile = makeNode(std::string(path.name()), false, parent);
+    newFile->adoptContent(staged);
+    parent->addChild(std::move(newFile));
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        dentries.invalidate(parent, path.name(), path.hash(path.size() - 1));
+    }
+    checkUsedSpace();
     return true;
 }
 
-
 bool VirtualFileSystem::createVolume(const std::string& volumeName, size_t volumeSize) {
     auto newFS = std::make_unique<VirtualFileSystem>(volumeSize);
     
@@ -356,26 +1521,29 @@ bool VirtualFileSystem::createVolume(const std::string& volumeName, size_t volum
     return true;
 }
 
-bool VirtualFileSystem::mountVolume(const std::string& diskImage, const std::string& mountPoint) {
+bool VirtualFileSystem::mountVolume(const std::string& diskImage, const VfsPath& mountPoint) {
+    WriteLock lock(treeLock);
+    return attachVolume(diskImage, mountPoint);
+}
+
+bool VirtualFileSystem::attachVolume(const std::string& diskImage, const VfsPath& mountPoint) {
     if (!std::filesystem::exists(diskImage)) {
         return false;
     }
     
-    if (isMountPoint(mountPoint)) {
+    // Neither on an existing mount point nor inside a mounted volume
+    size_t consumed = 0;
+    if (findMount(mountPoint, consumed)) {
         return false;
     }
     
-    std::string normalizedMountPoint = mountPoint;
-    if (normalizedMountPoint.empty() || normalizedMountPoint.back() != '/') {
-        normalizedMountPoint += '/';
-    }
-    
-    FileNode* mountDir = resolvePath(mountPoint);
+    FileNode* mountDir = lookupPath(mountPoint);
     if (!mountDir) {
-        if (!mkdir(mountPoint)) {
+        FileNode* parent = resolveParent(mountPoint);
+        if (!parent || !createChild(parent, mountPoint, true)) {
             return false;
         }
-        mountDir = resolvePath(mountPoint);
+        mountDir = lookupPath(mountPoint);
     }
     
     if (!mountDir || !mountDir->isDirectory()) {
@@ -392,30 +1560,52 @@ bool VirtualFileSystem::mountVolume(const std::string& diskImage, const std::str
     mountInfo.fs = std::move(newFS);
     mountInfo.mountPoint = mountDir;
     
-    mountedVolumes[mountDir->getPath()] = std::move(mountInfo);
+    std::string mountPath = mountDir->getPath();
+    mountTable.insert(VfsPath(mountPath), mountInfo.fs.get());
+    mountedVolumes[mountPath] = std::move(mountInfo);
+    {
+        std::lock_guard<std::mutex> guard(cwdLock);
+        setCwd(currentDirectory); // The cwd's mount table position may change
+    }
+    
+    // The local directory's entries are shadowed by the volume from now on
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.invalidateChildren(mountDir);
     
     return true;
 }
 
-bool VirtualFileSystem::unmountVolume(const std::string& mountPoint) {
-    std::string normalizedMountPoint = mountPoint;
-    if (!normalizedMountPoint.empty() && normalizedMountPoint.back() != '/') {
-        normalizedMountPoint += '/';
+bool VirtualFileSystem::unmountVolume(const VfsPath& mountPoint) {
+    WriteLock lock(treeLock);
+    FileNode* mountDir = lookupPath(mountPoint);
+    if (!mountDir) {
+        return false;
     }
     
-    auto it = mountedVolumes.find(normalizedMountPoint);
+    auto it = mountedVolumes.begin();
+    while (it != mountedVolumes.end() && it->second.mountPoint != mountDir) {
+        ++it;
+    }
     if (it == mountedVolumes.end()) {
         return false;
     }
     
     it->second.fs->saveToDisk(it->second.diskImage);
     
+    mountTable.erase(VfsPath(it->first));
     mountedVolumes.erase(it);
+    {
+        std::lock_guard<std::mutex> guard(cwdLock);
+        setCwd(currentDirectory);
+    }
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.invalidateChildren(mountDir);
     
     return true;
 }
 
 std::vector<std::string> VirtualFileSystem::listMountedVolumes() const {
+    ReadLock lock(treeLock);
     std::vector<std::string> result;
     for (const auto& [mountPoint, info] : mountedVolumes) {
         result.push_back(mountPoint);
@@ -423,138 +1613,99 @@ std::vector<std::string> VirtualFileSystem::listMountedVolumes() const {
     return result;
 }
 
-bool VirtualFileSystem::compressFile(const std::string& path, bool compress, const std::string& algorithm) {
-    std::string localPath;
+bool VirtualFileSystem::compressFile(const VfsPath& path, bool compress, const std::string& algorithm) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->compressFile(localPath, compress, algorithm);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
     
     target->setCompressed(compress, algorithm);
+    checkUsedSpace();
     return true;
 }
 
-bool VirtualFileSystem::isFileCompressed(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->isFileCompressed(localPath);
-    }
-    
-    FileNode* target = nonConstThis->resolvePath(path);
-    if (!target || target->isDirectory()) {
-        return false;
-    }
-    
-    return target->isCompressed();
+bool VirtualFileSystem::isFileCompressed(const VfsPath& path) const {
+    FileStat info = stat(path);
+    return !info.isDirectory && info.compressed;
 }
 
-std::string VirtualFileSystem::getFileCompressionAlgorithm(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->getFileCompressionAlgorithm(localPath);
-    }
-    
-    FileNode* target = nonConstThis->resolvePath(path);
-    if (!target || target->isDirectory() || !target->isCompressed()) {
-        return "";
-    }
-    
-    return target->getCompressionAlgorithm();
+std::string VirtualFileSystem::getFileCompressionAlgorithm(const VfsPath& path) const {
+    return stat(path).compressionAlgorithm;
 }
 
 std::vector<std::string> VirtualFileSystem::listCompressionAlgorithms() const {
     return CompressionFactory::listAvailableAlgorithms();
 }
 
-bool VirtualFileSystem::encryptFile(const std::string& path, const std::string& key, const std::string& algorithm) {
-    std::string localPath;
+bool VirtualFileSystem::encryptFile(const VfsPath& path, const std::string& key, const std::string& algorithm) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->encryptFile(localPath, key, algorithm);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
     
     target->setEncrypted(true, key, algorithm);
+    checkUsedSpace();
     return true;
 }
 
-bool VirtualFileSystem::decryptFile(const std::string& path) {
-    std::string localPath;
+bool VirtualFileSystem::decryptFile(const VfsPath& path) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->decryptFile(localPath);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
     
     target->setEncrypted(false);
+    checkUsedSpace();
     return true;
 }
 
-bool VirtualFileSystem::isFileEncrypted(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->isFileEncrypted(localPath);
-    }
-    
-    FileNode* target = nonConstThis->resolvePath(path);
-    if (!target || target->isDirectory()) {
-        return false;
-    }
-    
-    return target->isEncrypted();
+bool VirtualFileSystem::isFileEncrypted(const VfsPath& path) const {
+    FileStat info = stat(path);
+    return !info.isDirectory && info.encrypted;
 }
 
-std::string VirtualFileSystem::getFileEncryptionAlgorithm(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->getFileEncryptionAlgorithm(localPath);
-    }
-    
-    FileNode* target = nonConstThis->resolvePath(path);
-    if (!target || target->isDirectory() || !target->isEncrypted()) {
-        return "";
-    }
-    
-    return target->getEncryptionAlgorithm();
+std::string VirtualFileSystem::getFileEncryptionAlgorithm(const VfsPath& path) const {
+    return stat(path).encryptionAlgorithm;
 }
 
-bool VirtualFileSystem::changeEncryptionKey(const std::string& path, const std::string& newKey) {
-    std::string localPath;
+bool VirtualFileSystem::changeEncryptionKey(const VfsPath& path, const std::string& newKey) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->changeEncryptionKey(localPath, newKey);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
@@ -564,6 +1715,7 @@ bool VirtualFileSystem::changeEncryptionKey(const std::string& path, const std::
     }
     
     target->setEncryptionKey(newKey);
+    checkUsedSpace();
     return true;
 }
 
@@ -571,15 +1723,17 @@ std::vector<std::string> VirtualFileSystem::listEncryptionAlgorithms() const {
     return EncryptionFactory::listAvailableAlgorithms();
 }
 
-bool VirtualFileSystem::saveFileVersion(const std::string& path) {
-    std::string localPath;
+bool VirtualFileSystem::saveFileVersion(const VfsPath& path) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->saveFileVersion(localPath);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
@@ -588,144 +1742,202 @@ bool VirtualFileSystem::saveFileVersion(const std::string& path) {
     return true;
 }
 
-bool VirtualFileSystem::restoreFileVersion(const std::string& path, size_t versionIndex) {
-    std::string localPath;
+bool VirtualFileSystem::restoreFileVersion(const VfsPath& path, size_t versionIndex) {
+    PathLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->restoreFileVersion(localPath, versionIndex);
     }
     
-    FileNode* target = resolvePath(path);
+    NodeLocks locks;
+    FileNode* target = lockTarget(path, true, locks);
     if (!target || target->isDirectory()) {
         return false;
     }
     
-    return target->restoreVersion(versionIndex);
+    bool restored = target->restoreVersion(versionIndex);
+    checkUsedSpace();
+    return restored;
 }
 
-size_t VirtualFileSystem::getFileVersionCount(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->getFileVersionCount(localPath);
+size_t VirtualFileSystem::getFileVersionCount(const VfsPath& path) const {
+    return stat(path).versions;
+}
+
+std::vector<std::time_t> VirtualFileSystem::getFileVersionTimestamps(const VfsPath& path) const {
+    ReadLock lock(treeLock);
+    size_t consumed = 0;
+    if (const VirtualFileSystem* volume = findMount(path, consumed)) {
+        return volume->getFileVersionTimestamps(path.suffix(consumed));
     }
     
-    FileNode* target = nonConstThis->resolvePath(path);
+    NodeLocks locks;
+    const FileNode* target = lockTarget(path, false, locks);
     if (!target || target->isDirectory()) {
-        return 0;
+        return {};
     }
     
-    return target->getVersionCount();
+    return target->getVersionTimestamps();
 }
 
-std::vector<std::time_t> VirtualFileSystem::getFileVersionTimestamps(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
+FileStat VirtualFileSystem::stat(const VfsPath& path) const {
+    // Tags are keyed by path handle under tagsLock, so only an untagged
+    // volume is answered without locking
+    if (!anyTags.load(std::memory_order_acquire)) {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            return statNode(read.node());
+        }
+    }
     
-    if (responsibleFS != this) {
-        return responsibleFS->getFileVersionTimestamps(localPath);
+    ReadLock lock(treeLock);
+    size_t consumed = 0;
+    if (const VirtualFileSystem* volume = findMount(path, consumed)) {
+        return volume->stat(path.suffix(consumed));
     }
     
-    FileNode* target = nonConstThis->resolvePath(path);
-    if (!target || target->isDirectory()) {
-        return {};
+    NodeLocks locks;
+    const FileNode* node = lockTarget(path, false, locks);
+    FileStat info = statNode(node);
+    if (!node) {
+        return info;
     }
     
-    return target->getVersionTimestamps();
+    std::lock_guard<std::mutex> guard(tagsLock);
+    if (!fileTags.empty()) {
+        auto it = fileTags.find(node->getPathHandle());
+        if (it != fileTags.end()) {
+            info.tags = it->second;
+        }
+    }
+    
+    return info;
 }
 
-FileNode* VirtualFileSystem::resolvePath(const std::string& path) {
-    if (path.empty()) {
-        return currentDirectory;
+FileStat VirtualFileSystem::statNode(const FileNode* node) const {
+    FileStat info;
+    if (!node) {
+        return info;
+    }
+    
+    info.exists = true;
+    info.isDirectory = node->isDirectory();
+    
+    FileNode::Attributes attributes = node->getAttributes();
+    info.modified = attributes.modified;
+    if (info.isDirectory) {
+        FileNode::Totals totals = node->getTotals();
+        info.size = totals.logicalBytes;
+        info.storedSize = totals.storedBytes;
+        info.files = totals.files;
+        info.directories = totals.directories;
+    } else {
+        info.size = attributes.size;
+        info.storedSize = attributes.storedSize;
+        info.compressed = attributes.compressed;
+        info.encrypted = attributes.encrypted;
+        if (info.compressed) {
+            info.compressionAlgorithm = attributes.compressionAlgorithm;
+        }
+        if (info.encrypted) {
+            info.encryptionAlgorithm = attributes.encryptionAlgorithm;
+        }
+        info.versions = attributes.versions;
     }
     
-    FileNode* startNode = currentDirectory;
-    if (path[0] == '/') {
-        // Absolute path
-        startNode = root.get();
+    return info;
+}
+
+FileNode* VirtualFileSystem::resolvePath(const VfsPath& path) {
+    {
+        ReadSection read(*this, path);
+        if (read.resolved()) {
+            return read.node();
+        }
     }
     
-    std::vector<std::string> pathParts = splitPath(path);
-    FileNode* current = startNode;
+    ReadLock lock(treeLock);
+    NodeLocks locks;
+    return lockTarget(path, false, locks);
+}
+
+FileNode* VirtualFileSystem::lookupPath(const VfsPath& path) const {
+    FileNode* current = path.isAbsolute() ? root.get() : currentDirectory.load();
     
-    for (const auto& part : pathParts) {
-        if (part.empty() || part == ".") {
-            continue;
-        } else if (part == "..") {
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path.isParentRef(i)) {
             if (current->getParent()) {
                 current = current->getParent();
             }
-        } else {
-            FileNode* next = current->findChild(part);
-            if (!next) {
-                return nullptr;
-            }
-            current = next;
+            continue;
         }
+        
+        // Components carry their hash, so lookups don't rehash the name
+        FileNode* next = lookupChild(current, path[i], path.hash(i));
+        if (!next) {
+            return nullptr;
+        }
+        current = next;
     }
     
     return current;
 }
 
 std::string VirtualFileSystem::getCurrentPath() const {
-    return currentDirectory->getPath();
+    std::lock_guard<std::mutex> guard(cwdLock);
+    return cwdPath;
 }
 
-std::vector<std::string> VirtualFileSystem::splitPath(const std::string& path) {
-    std::vector<std::string> parts;
-    std::string normalizedPath = path;
-    
-    // Skip leading slash for absolute paths
-    if (!normalizedPath.empty() && normalizedPath[0] == '/') {
-        normalizedPath = normalizedPath.substr(1);
-    }
-    
-    std::istringstream iss(normalizedPath);
-    std::string part;
+void VirtualFileSystem::setCwd(FileNode* directory) {
+    // The caller holds the directory's lock or the whole volume, so its
+    // path can't change while it is built
+    currentDirectory = directory;
+    cwdPath = directory->getPath();
+    cwdCursor = mountCursorOf(directory);
+}
+
+bool VirtualFileSystem::verifyUsedSpace() const {
+    WriteLock lock(treeLock);
+    return usedSpaceMatches();
+}
+
+bool VirtualFileSystem::usedSpaceMatches() const {
+    // Full recount of what every node reports, plus each distinct payload
+    // once, compared with the running total
+    size_t recounted = 0;
+    std::unordered_set<const std::string*> seen;
     
-    while (std::getline(iss, part, '/')) {
-        parts.push_back(part);
+    for (TreeIterator walk(root.get()); !walk.done(); walk.next()) {
+        recounted += walk.node()->getFootprint();
+        walk.node()->countUniquePayloads(seen, recounted);
     }
     
-    return parts;
+    return recounted == nodeArena.getAccountedBytes();
 }
 
-void VirtualFileSystem::updateUsedSpace() {
-    usedSpace = 0;
-    
-    std::function<void(FileNode*)> calculateSize;
-    calculateSize = [this, &calculateSize](FileNode* node) {
-        usedSpace += sizeof(FileNode);
-        usedSpace += node->getName().size();
-        
-        if (!node->isDirectory()) {
-            usedSpace += node->getContent().size();
-        } else {
-            for (const auto& child : node->getChildren()) {
-                calculateSize(child.get());
-            }
-        }
-    };
-    
-    calculateSize(root.get());
+void VirtualFileSystem::checkUsedSpace() const {
+#ifdef VFS_DEBUG_ACCOUNTING
+    assert(usedSpaceMatches() && "incremental used-space accounting drifted");
+#endif
 }
 
 
 bool VirtualFileSystem::saveToDisk(const std::string& filename) {
+    WriteLock lock(treeLock);
     std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
+    size_t usedSpace = nodeArena.getAccountedBytes();
     file.write(reinterpret_cast<char*>(&diskSize), sizeof(diskSize));
     file.write(reinterpret_cast<char*>(&usedSpace), sizeof(usedSpace));
     
-    std::function<void(FileNode*, std::ofstream&)> serializeNode;
-    serializeNode = [&serializeNode](FileNode* node, std::ofstream& out) {
+    // Nodes are written in pre-order; a directory's child count tells the
+    // reader how many of the following subtrees belong to it
+    auto serializeNode = [](const FileNode* node, std::ofstream& out) {
         size_t nameLen = node->getName().size();
         out.write(reinterpret_cast<char*>(&nameLen), sizeof(nameLen));
         out.write(node->getName().c_str(), nameLen);
@@ -734,10 +1946,16 @@ bool VirtualFileSystem::saveToDisk(const std::string& filename) {
         out.write(reinterpret_cast<char*>(&isDir), sizeof(isDir));
         
         if (!isDir) {
-            std::string content = node->getContent();
-            size_t contentLen = content.size();
+            // Written extent by extent, so large plain files aren't joined first
+            std::vector<ContentView> content = node->getContentViews();
+            size_t contentLen = 0;
+            for (const ContentView& extent : content) {
+                contentLen += extent.size();
+            }
             out.write(reinterpret_cast<char*>(&contentLen), sizeof(contentLen));
-            out.write(content.c_str(), contentLen);
+            for (const ContentView& extent : content) {
+                out.write(extent.data(), extent.size());
+            }
             
             bool compressed = node->isCompressed();
             out.write(reinterpret_cast<char*>(&compressed), sizeof(compressed));
@@ -779,16 +1997,14 @@ bool VirtualFileSystem::saveToDisk(const std::string& filename) {
         } else {
             size_t childCount = node->getChildren().size();
             out.write(reinterpret_cast<char*>(&childCount), sizeof(childCount));
-            
-            for (const auto& child : node->getChildren()) {
-                serializeNode(child.get(), out);
-            }
         }
     };
     
-    serializeNode(root.get(), file);
+    for (TreeIterator walk(root.get()); !walk.done(); walk.next()) {
+        serializeNode(walk.node(), file);
+    }
     
-    std::string currentPath = currentDirectory->getPath();
+    std::string currentPath = getCurrentPath();
     size_t pathLen = currentPath.size();
     file.write(reinterpret_cast<char*>(&pathLen), sizeof(pathLen));
     file.write(currentPath.c_str(), pathLen);
@@ -808,20 +2024,27 @@ bool VirtualFileSystem::saveToDisk(const std::string& filename) {
         info.fs->saveToDisk(info.diskImage);
     }
     
+    bool dedup = nodeArena.blocks().isEnabled();
+    file.write(reinterpret_cast<char*>(&dedup), sizeof(dedup));
+    
     return true;
 }
 
 bool VirtualFileSystem::loadFromDisk(const std::string& filename) {
+    WriteLock lock(treeLock);
     std::ifstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
+    // The stored used space is only informational; the arena keeps the real total
+    size_t storedUsedSpace;
     file.read(reinterpret_cast<char*>(&diskSize), sizeof(diskSize));
-    file.read(reinterpret_cast<char*>(&usedSpace), sizeof(usedSpace));
+    file.read(reinterpret_cast<char*>(&storedUsedSpace), sizeof(storedUsedSpace));
     
-    std::function<std::unique_ptr<FileNode>(FileNode*, std::ifstream&)> deserializeNode;
-    deserializeNode = [&deserializeNode](FileNode* parent, std::ifstream& in) {
+    // Reads one node in the pre-order saveToDisk() writes; a directory's
+    // children follow it, and childCount says how many subtrees that is
+    auto deserializeNode = [this](FileNode* parent, std::ifstream& in, size_t& childCount) {
         size_t nameLen;
         in.read(reinterpret_cast<char*>(&nameLen), sizeof(nameLen));
         std::string name(nameLen, '\0');
@@ -830,7 +2053,7 @@ bool VirtualFileSystem::loadFromDisk(const std::string& filename) {
         bool isDir;
         in.read(reinterpret_cast<char*>(&isDir), sizeof(isDir));
         
-        auto node = std::make_unique<FileNode>(name, isDir, parent);
+        auto node = makeNode(name, isDir, parent);
         
         if (!isDir) {
             size_t contentLen;
@@ -889,29 +2112,59 @@ bool VirtualFileSystem::loadFromDisk(const std::string& filename) {
             if (encrypted && !key.empty()) {
                 node->setEncrypted(true, key, encryptionAlg);
             }
-        } else {
-            size_t childCount;
-            in.read(reinterpret_cast<char*>(&childCount), sizeof(childCount));
-            
-            for (size_t i = 0; i < childCount; ++i) {
-                auto child = deserializeNode(node.get(), in);
-                node->addChild(std::move(child));
-            }
         }
         
+        childCount = 0;
+        if (isDir) {
+            in.read(reinterpret_cast<char*>(&childCount), sizeof(childCount));
+        }
         return node;
     };
     
-    root = deserializeNode(nullptr, file);
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        dentries.clear();
+    }
+    closeHandles();
+    
+    // Directories still waiting for children, innermost last, so a deep
+    // tree is read without recursing
+    struct Pending {
+        FileNode* directory;
+        size_t remaining;
+    };
+    std::vector<Pending> pending;
+    
+    size_t childCount;
+    root = deserializeNode(nullptr, file, childCount);
+    pending.push_back({root.get(), childCount});
+    while (!pending.empty() && file) {
+        Pending& top = pending.back();
+        if (top.remaining == 0) {
+            pending.pop_back();
+            continue;
+        }
+        top.remaining--;
+        
+        FileNode* directory = top.directory;
+        std::unique_ptr<FileNode> child = deserializeNode(directory, file, childCount);
+        FileNode* added = child.get();
+        directory->addChild(std::move(child));
+        if (added->isDirectory()) {
+            pending.push_back({added, childCount});
+        }
+    }
+    checkUsedSpace();
     
     size_t pathLen;
     file.read(reinterpret_cast<char*>(&pathLen), sizeof(pathLen));
     std::string currentPath(pathLen, '\0');
     file.read(&currentPath[0], pathLen);
     
-    currentDirectory = resolvePath(currentPath);
-    if (!currentDirectory) {
-        currentDirectory = root.get();
+    {
+        FileNode* cwd = lookupPath(VfsPath(currentPath));
+        std::lock_guard<std::mutex> guard(cwdLock);
+        setCwd(cwd && cwd->isDirectory() ? cwd : root.get());
     }
     
     size_t mountCount;
@@ -927,94 +2180,217 @@ bool VirtualFileSystem::loadFromDisk(const std::string& filename) {
             std::string diskImage(diskImageLen, '\0');
             file.read(&diskImage[0], diskImageLen);
             
-            mountVolume(diskImage, mountPoint);
+            attachVolume(diskImage, mountPoint);
         }
     }
     
+    // Older images end before the deduplication flag
+    bool dedup;
+    if (file.read(reinterpret_cast<char*>(&dedup), sizeof(dedup))) {
+        applyDeduplication(dedup);
+    }
+    
     return true;
 }
 
 size_t VirtualFileSystem::getFreeSpace() const {
-    return diskSize - usedSpace;
+    ReadLock lock(treeLock);
+    return diskSize - nodeArena.getAccountedBytes();
 }
 
 size_t VirtualFileSystem::getTotalSpace() const {
+    ReadLock lock(treeLock);
     return diskSize;
 }
 
 size_t VirtualFileSystem::getUsedSpace() const {
-    return usedSpace;
+    // Maintained incrementally by the nodes themselves as they change; the
+    // counter is atomic, so reading it needs no lock. Removed nodes stop
+    // counting when they are unlinked, not when they are freed
+    return nodeArena.getAccountedBytes();
 }
 
-std::vector<std::string> VirtualFileSystem::search(const SearchFilter& filter, const std::string& startPath) {
-    std::string localPath;
-    VirtualFileSystem* responsibleFS = getResponsibleFS(startPath, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->search(filter, localPath);
+std::unique_ptr<FileNode> VirtualFileSystem::makeNode(const std::string& name, bool isDirectory, FileNode* parent) {
+    return std::unique_ptr<FileNode>(new (nodeArena) FileNode(nodeArena, name, isDirectory, parent));
+}
+
+size_t VirtualFileSystem::compactNodes() {
+    WriteLock lock(treeLock);
+    if (nodeArena.beginCompaction() == 0) {
+        return nodeArena.endCompaction();
     }
     
-    FileNode* startNode = currentDirectory;
-    if (!startPath.empty()) {
-        startNode = resolvePath(startPath);
-        if (!startNode) {
-            return {};
+    // Relocated nodes change address, so cached entries would dangle
+    {
+        std::lock_guard<std::mutex> cacheLock(dentryLock);
+        dentries.clear();
+    }
+    std::lock_guard<std::mutex> guard(cwdLock);
+    std::lock_guard<std::mutex> handlesGuard(handlesLock);
+    relocateNodes(root);
+    return nodeArena.endCompaction();
+}
+
+void VirtualFileSystem::relocateNodes(std::unique_ptr<FileNode>& rootSlot) {
+    // Parents are moved before their children, so the move constructor
+    // re-points the children at the relocated parent. Child indexes still
+    // point at the evacuated children until every node has moved, so they
+    // are rebuilt at the end
+    std::vector<std::unique_ptr<FileNode>*> pending{&rootSlot};
+    std::vector<FileNode*> directories;
+    while (!pending.empty()) {
+        std::unique_ptr<FileNode>& slot = *pending.back();
+        pending.pop_back();
+        FileNode* node = slot.get();
+        
+        if (nodeArena.isEvacuating(node)) {
+            std::unique_ptr<FileNode> moved(new (nodeArena) FileNode(std::move(*node)));
+            
+            if (currentDirectory == node) {
+                currentDirectory = moved.get();
+            }
+            for (FileHandle* handle : openHandles) {
+                if (handle->node == node) {
+                    handle->node = moved.get();
+                }
+            }
+            for (auto& [_, info] : mountedVolumes) {
+                if (info.mountPoint == node) {
+                    info.mountPoint = moved.get();
+                }
+            }
+            
+            slot = std::move(moved);
+            node = slot.get();
+        }
+        
+        if (!node->getChildren().empty()) {
+            directories.push_back(node);
+        }
+        for (auto& child : node->getChildren()) {
+            pending.push_back(&child);
         }
     }
     
-    std::vector<std::string> results;
-    
-    std::string basePath = startPath.empty() ? getCurrentPath() : startPath;
-    searchRecursive(startNode, basePath, filter, results);
-    
-    return results;
+    for (FileNode* directory : directories) {
+        directory->refreshChildIndex();
+    }
 }
 
-void VirtualFileSystem::searchRecursive(FileNode* node, const std::string& currentPath, 
-                                        const SearchFilter& filter, 
-                                        std::vector<std::string>& results) {
-    if (!node) {
+NodeArena::Stats VirtualFileSystem::getNodeStorageStats() const {
+    ReadLock lock(treeLock);
+    return nodeArena.getStats();
+}
+
+DentryCache::Stats VirtualFileSystem::getDentryCacheStats() const {
+    ReadLock lock(treeLock);
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    return dentries.getStats();
+}
+
+void VirtualFileSystem::setDentryCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> cacheLock(dentryLock);
+    dentries.setCapacity(capacity);
+}
+
+void VirtualFileSystem::setDeduplication(bool enabled) {
+    WriteLock lock(treeLock);
+    applyDeduplication(enabled);
+}
+
+void VirtualFileSystem::applyDeduplication(bool enabled) {
+    if (enabled == nodeArena.blocks().isEnabled()) {
         return;
     }
     
-    bool isMatch = matchesFilter(node, currentPath, filter);
-    
-    if (isMatch) {
-        std::string relativePath = (currentPath == "/" || currentPath.empty()) 
-                                  ? "/" + node->getName() 
-                                  : currentPath + "/" + node->getName();
-        
-        if (node == root.get()) {
-            relativePath = "/";
+    nodeArena.blocks().setEnabled(enabled);
+    if (enabled && root) {
+        repackFiles(root.get());
+    }
+    checkUsedSpace();
+}
+
+void VirtualFileSystem::repackFiles(FileNode* start) {
+    std::vector<FileNode*> pending{start};
+    while (!pending.empty()) {
+        FileNode* node = pending.back();
+        pending.pop_back();
+        if (!node->isDirectory()) {
+            node->repack();
+            continue;
         }
-        
-        while (relativePath.find("//") != std::string::npos) {
-            relativePath.replace(relativePath.find("//"), 2, "/");
+        for (auto& child : node->getChildren()) {
+            pending.push_back(child.get());
         }
-        
-        results.push_back(relativePath);
+    }
+}
+
+bool VirtualFileSystem::isDeduplicationEnabled() const {
+    ReadLock lock(treeLock);
+    return nodeArena.blocks().isEnabled();
+}
+
+VirtualFileSystem::DedupStats VirtualFileSystem::getDedupStats() const {
+    ReadLock lock(treeLock);
+    DedupStats stats;
+    BlockStore::Stats blocks = nodeArena.blocks().getStats();
+    stats.enabled = nodeArena.blocks().isEnabled();
+    stats.blocks = blocks.blocks;
+    if (!root) {
+        return stats;
     }
     
-    if (node->isDirectory() && !filter.filesOnly) {
-        std::string newPath = (currentPath == "/" || currentPath.empty()) 
-                             ? "/" + node->getName() 
-                             : currentPath + "/" + node->getName();
-        
-        if (node == root.get()) {
-            newPath = "/";
-        }
-        
-        while (newPath.find("//") != std::string::npos) {
-            newPath.replace(newPath.find("//"), 2, "/");
+    // What the files reference against what the volume is charged for,
+    // which also credits sharing between copies
+    stats.referencedBytes = root->getTotals().storedBytes;
+    stats.uniqueBytes = blocks.chargedBytes;
+    
+    if (stats.uniqueBytes > 0) {
+        stats.ratio = static_cast<double>(stats.referencedBytes) / stats.uniqueBytes;
+    }
+    return stats;
+}
+
+std::vector<std::string> VirtualFileSystem::search(const SearchFilter& filter, const VfsPath& startPath) {
+    ReadLock lock(treeLock);
+    VfsPath localPath;
+    VirtualFileSystem* responsibleFS = getResponsibleFS(startPath, localPath);
+    
+    if (responsibleFS != this) {
+        return responsibleFS->search(filter, localPath);
+    }
+    
+    NodeLocks locks;
+    FileNode* startNode = lockTarget(startPath, false, locks);
+    if (!startNode) {
+        return {};
+    }
+    
+    std::vector<std::string> results;
+    
+    // filesOnly only filters matches; the walk still descends into every
+    // directory to reach the files below it. Only the directories on the
+    // way to the current node are locked, so writers elsewhere in the
+    // subtree aren't held up for the whole search
+    TreeIterator walk(startNode);
+    walk.setDirectoriesOnly(filter.directoriesOnly);
+    walk.lockDirectories();
+    walk.trackPath();
+    for (; !walk.done(); walk.next()) {
+        const FileNode* node = walk.node();
+        std::shared_lock<NodeLock> fileLock;
+        if (!node->isDirectory() && node != startNode) {
+            fileLock = std::shared_lock<NodeLock>(node->getLock());
         }
-        
-        for (const auto& child : node->getChildren()) {
-            searchRecursive(child.get(), newPath, filter, results);
+        if (matchesFilter(node, filter)) {
+            results.push_back(walk.path());
         }
     }
+    
+    return results;
 }
 
-bool VirtualFileSystem::matchesFilter(FileNode* node, const std::string& filePath, const SearchFilter& filter) {
+bool VirtualFileSystem::matchesFilter(const FileNode* node, const SearchFilter& filter) {
     if (!node) {
         return false;
     }
@@ -1033,7 +2409,7 @@ bool VirtualFileSystem::matchesFilter(FileNode* node, const std::string& filePat
     }
     
     if (filter.namePattern.has_value()) {
-        std::string name = node->getName();
+        const std::string& name = node->getName();
         if (!std::regex_search(name, filter.namePattern.value())) {
             return false;
         }
@@ -1076,13 +2452,8 @@ bool VirtualFileSystem::matchesFilter(FileNode* node, const std::string& filePat
     }
     
     if (!filter.tags.empty()) {
-        std::string normalizedPath = filePath;
-        if (normalizedPath.empty() || normalizedPath[0] != '/') {
-            normalizedPath = "/" + normalizedPath;
-        }
-        normalizedPath += "/" + node->getName();
-        
-        auto it = fileTags.find(normalizedPath);
+        std::lock_guard<std::mutex> guard(tagsLock);
+        auto it = fileTags.find(node->getPathHandle());
         if (it == fileTags.end()) {
             return false; // No tags for this file
         }
@@ -1106,27 +2477,27 @@ bool VirtualFileSystem::matchesFilter(FileNode* node, const std::string& filePat
     return true;
 }
 
-bool VirtualFileSystem::contentMatches(FileNode* node, const std::string& pattern, bool isRegex) {
+bool VirtualFileSystem::contentMatches(const FileNode* node, const std::string& pattern, bool isRegex) {
     if (!node || node->isDirectory()) {
         return false;
     }
     
-    std::string content = node->getContent();
+    ContentView content = node->getContentView();
     
     if (isRegex) {
         try {
             std::regex regex(pattern);
-            return std::regex_search(content, regex);
+            return std::regex_search(content.data(), content.data() + content.size(), regex);
         } catch (const std::regex_error&) {
             return false;
         }
     } else {
-        return content.find(pattern) != std::string::npos;
+        return content.view().find(pattern) != std::string_view::npos;
     }
 }
 
 
-std::vector<std::string> VirtualFileSystem::searchByName(const std::string& namePattern, bool useRegex, const std::string& startPath) {
+std::vector<std::string> VirtualFileSystem::searchByName(const std::string& namePattern, bool useRegex, const VfsPath& startPath) {
     SearchFilter filter;
     
     if (useRegex) {
@@ -1142,7 +2513,7 @@ std::vector<std::string> VirtualFileSystem::searchByName(const std::string& name
     return search(filter, startPath);
 }
 
-std::vector<std::string> VirtualFileSystem::searchByContent(const std::string& contentPattern, bool useRegex, const std::string& startPath) {
+std::vector<std::string> VirtualFileSystem::searchByContent(const std::string& contentPattern, bool useRegex, const VfsPath& startPath) {
     SearchFilter filter;
     filter.filesOnly = true; 
     
@@ -1159,14 +2530,14 @@ std::vector<std::string> VirtualFileSystem::searchByContent(const std::string& c
     return search(filter, startPath);
 }
 
-std::vector<std::string> VirtualFileSystem::searchByTag(const std::string& tag, const std::string& startPath) {
+std::vector<std::string> VirtualFileSystem::searchByTag(const std::string& tag, const VfsPath& startPath) {
     SearchFilter filter;
     filter.tags.push_back(tag);
     
     return search(filter, startPath);
 }
 
-std::vector<std::string> VirtualFileSystem::searchBySize(size_t minSize, size_t maxSize, const std::string& startPath) {
+std::vector<std::string> VirtualFileSystem::searchBySize(size_t minSize, size_t maxSize, const VfsPath& startPath) {
     SearchFilter filter;
     filter.filesOnly = true;
     filter.minSize = minSize;
@@ -1175,7 +2546,7 @@ std::vector<std::string> VirtualFileSystem::searchBySize(size_t minSize, size_t
     return search(filter, startPath);
 }
 
-std::vector<std::string> VirtualFileSystem::searchByDate(time_t modifiedAfter, time_t modifiedBefore, const std::string& startPath) {
+std::vector<std::string> VirtualFileSystem::searchByDate(time_t modifiedAfter, time_t modifiedBefore, const VfsPath& startPath) {
     SearchFilter filter;
     filter.modifiedAfter = modifiedAfter;
     filter.modifiedBefore = modifiedBefore;
@@ -1184,51 +2555,51 @@ std::vector<std::string> VirtualFileSystem::searchByDate(time_t modifiedAfter, t
 }
 
 
-bool VirtualFileSystem::addTag(const std::string& path, const std::string& tag) {
-    std::string localPath;
+bool VirtualFileSystem::addTag(const VfsPath& path, const std::string& tag) {
+    ReadLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->addTag(localPath, tag);
     }
     
-    FileNode* node = resolvePath(path);
+    NodeLocks locks;
+    FileNode* node = lockTarget(path, false, locks);
     if (!node) {
         return false;
     }
     
-    std::string normalizedPath = path;
-    if (normalizedPath.empty() || normalizedPath[0] != '/') {
-        normalizedPath = "/" + normalizedPath;
-    }
-    
-    auto& tags = fileTags[normalizedPath];
+    tagNode(node, tag);
+    return true;
+}
+
+void VirtualFileSystem::tagNode(const FileNode* node, const std::string& tag) {
+    std::lock_guard<std::mutex> guard(tagsLock);
+    auto& tags = fileTags[node->getPath()];
+    anyTags.store(true, std::memory_order_release);
     if (std::find(tags.begin(), tags.end(), tag) == tags.end()) {
         tags.push_back(tag);
     }
-    
-    return true;
 }
 
-bool VirtualFileSystem::removeTag(const std::string& path, const std::string& tag) {
-    std::string localPath;
+bool VirtualFileSystem::removeTag(const VfsPath& path, const std::string& tag) {
+    ReadLock lock(treeLock);
+    VfsPath localPath;
     VirtualFileSystem* responsibleFS = getResponsibleFS(path, localPath);
     
     if (responsibleFS != this) {
         return responsibleFS->removeTag(localPath, tag);
     }
     
-    FileNode* node = resolvePath(path);
+    NodeLocks locks;
+    FileNode* node = lockTarget(path, false, locks);
     if (!node) {
         return false;
     }
     
-    std::string normalizedPath = path;
-    if (normalizedPath.empty() || normalizedPath[0] != '/') {
-        normalizedPath = "/" + normalizedPath;
-    }
-    
-    auto it = fileTags.find(normalizedPath);
+    std::lock_guard<std::mutex> guard(tagsLock);
+    auto it = fileTags.find(node->getPathHandle());
     if (it != fileTags.end()) {
         auto& tags = it->second;
         tags.erase(std::remove(tags.begin(), tags.end(), tag), tags.end());
@@ -1238,34 +2609,12 @@ bool VirtualFileSystem::removeTag(const std::string& path, const std::string& ta
     return false;
 }
 
-std::vector<std::string> VirtualFileSystem::getFileTags(const std::string& path) const {
-    std::string localPath;
-    VirtualFileSystem* nonConstThis = const_cast<VirtualFileSystem*>(this);
-    VirtualFileSystem* responsibleFS = nonConstThis->getResponsibleFS(path, localPath);
-    
-    if (responsibleFS != this) {
-        return responsibleFS->getFileTags(localPath);
-    }
-    
-    FileNode* node = nonConstThis->resolvePath(path);
-    if (!node) {
-        return {};
-    }
-    
-    std::string normalizedPath = path;
-    if (normalizedPath.empty() || normalizedPath[0] != '/') {
-        normalizedPath = "/" + normalizedPath;
-    }
-    
-    auto it = fileTags.find(normalizedPath);
-    if (it != fileTags.end()) {
-        return it->second;
-    }
-    
-    return {};
+std::vector<std::string> VirtualFileSystem::getFileTags(const VfsPath& path) const {
+    return stat(path).tags;
 }
 
 std::vector<std::string> VirtualFileSystem::getAllTags() const {
+    std::lock_guard<std::mutex> guard(tagsLock);
     std::vector<std::string> allTags;
     std::set<std::string> uniqueTags;
     
@@ -0,0 +1,135 @@
+#include "Test.h"
+#include "../include/Epoch.h"
+#include "../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(removeGivesSpaceBackRightAway) {
+    VirtualFileSystem vfs;
+    size_t empty = vfs.getUsedSpace();
+    
+    CHECK(vfs.write("/big", std::string(1024 * 1024, 'x')));
+    CHECK(vfs.getUsedSpace() > empty + 1024 * 1024);
+    
+    CHECK(vfs.remove("/big"));
+    CHECK(vfs.getUsedSpace() == empty);
+    CHECK(vfs.getFreeSpace() == vfs.getTotalSpace() - empty);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(removeGivesSpaceBackForWholeSubtrees) {
+    VirtualFileSystem vfs;
+    size_t empty = vfs.getUsedSpace();
+    
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.mkdir("/dir/sub"));
+    for (int i = 0; i < 100; ++i) {
+        CHECK(vfs.write("/dir/sub/f" + std::to_string(i), std::string(1000, 'y')));
+    }
+    CHECK(vfs.remove("/dir"));
+    CHECK(vfs.getUsedSpace() == empty);
+}
+
+TEST(replacingAFileGivesTheOldOneBack) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.write("/a", std::string(5000, 'a')));
+    size_t one = vfs.getUsedSpace();
+    
+    CHECK(vfs.write("/b", std::string(5000, 'b')));
+    CHECK(vfs.move("/b", "/a")); // Replaces the old /a
+    CHECK(vfs.getUsedSpace() == one);
+    CHECK(vfs.cat("/a") == std::string(5000, 'b'));
+}
+
+// A reader elsewhere holds reclamation back; the used space must not wait
+// for it
+TEST(removeGivesSpaceBackWhileReadersHoldTheEpoch) {
+    VirtualFileSystem vfs;
+    size_t empty = vfs.getUsedSpace();
+    CHECK(vfs.write("/file", std::string(100000, 'z')));
+    
+    int otherVolume = 0;
+    std::promise<void> entered;
+    std::promise<void> leave;
+    std::thread reader([&] {
+        Epoch::Guard guard(&otherVolume);
+        entered.set_value();
+        leave.get_future().wait();
+    });
+    entered.get_future().wait();
+    
+    CHECK(vfs.remove("/file"));
+    CHECK(vfs.getUsedSpace() == empty);
+    
+    leave.set_value();
+    reader.join();
+}
+
+// Every kind of mutation updates the used space as it goes; a recount of
+// the whole tree must agree after each one
+TEST(everyMutationKeepsUsedSpaceExact) {
+    VirtualFileSystem vfs;
+    std::vector<std::function<bool()>> steps = {
+        [&] { return vfs.mkdir("/docs"); },
+        [&] { return vfs.write("/docs/a", std::string(70000, 'a')); },
+        [&] { return vfs.writeAt("/docs/a", 65000, std::string(10000, 'b')); },
+        [&] { return vfs.append("/docs/a", "tail"); },
+        [&] { return vfs.truncate("/docs/a", 100); },
+        [&] { return vfs.truncate("/docs/a", 200000); },
+        [&] { return vfs.saveFileVersion("/docs/a"); },
+        [&] { return vfs.write("/docs/a", "rewritten"); },
+        [&] { return vfs.restoreFileVersion("/docs/a", 0); },
+        [&] { return vfs.copy("/docs", "/copy"); },
+        [&] { return vfs.compressFile("/copy/a"); },
+        [&] { return vfs.encryptFile("/docs/a", "key"); },
+        [&] { return vfs.decryptFile("/docs/a"); },
+        [&] { return vfs.move("/copy/a", "/moved"); },
+        [&] { return vfs.addTag("/moved", "tag"); },
+        [&] { return vfs.remove("/copy"); },
+        [&] { return vfs.remove("/docs"); },
+    };
+    
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (!steps[i]()) {
+            test::fail(__FILE__, __LINE__, "step " + std::to_string(i) + " failed");
+        }
+        if (!vfs.verifyUsedSpace()) {
+            test::fail(__FILE__, __LINE__, "used space is off after step " + std::to_string(i));
+        }
+    }
+    CHECK(vfs.remove("/moved"));
+    CHECK(vfs.ls("/").empty());
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Whole-volume operations replace the tree and must leave the counter
+// matching what they built
+TEST(usedSpaceSurvivesSaveLoadAndCompaction) {
+    std::string image = "accounting_test.bin";
+    size_t saved;
+    {
+        VirtualFileSystem vfs;
+        for (int i = 0; i < 200; ++i) {
+            CHECK(vfs.write("/f" + std::to_string(i), std::string(i * 10, 'c')));
+        }
+        saved = vfs.getUsedSpace();
+        CHECK(vfs.saveToDisk(image));
+    }
+    
+    VirtualFileSystem loaded;
+    CHECK(loaded.loadFromDisk(image));
+    std::remove(image.c_str());
+    CHECK(loaded.getUsedSpace() == saved);
+    
+    for (int i = 0; i < 200; i += 2) {
+        CHECK(loaded.remove("/f" + std::to_string(i)));
+    }
+    size_t beforeCompaction = loaded.getUsedSpace();
+    loaded.compactNodes();
+    CHECK(loaded.getUsedSpace() == beforeCompaction);
+    CHECK(loaded.verifyUsedSpace());
+}
@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+using Type = BatchOp::Type;
+
+} // namespace
+
+TEST(batchReportsEachOperationInOrder) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::vector<BatchOp> ops = {
+        {Type::Mkdir, "/a", ""},
+        {Type::Touch, "/a/x", ""},
+        {Type::Write, "/a/y", "content"},
+        {Type::Touch, "/a/x", ""},        // Already exists
+        {Type::Touch, "/missing/z", ""},  // No such parent
+        {Type::AddTag, "/a/y", "keep"},
+        {Type::Remove, "/a/x", ""},
+        {Type::Remove, "/a/x", ""},       // Already gone
+        {Type::Touch, "/a/..", ""},       // Names no entry
+    };
+    std::vector<bool> results = vfs.applyBatch(ops);
+
+    CHECK((results == std::vector<bool>{true, true, true, false, false, true, true, false, false}));
+    CHECK(vfs.ls("/a") == std::vector<std::string>{"y"});
+    CHECK(vfs.cat("/a/y") == "content");
+    CHECK(vfs.getFileTags("/a/y") == std::vector<std::string>{"keep"});
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Operations of one parent depend on earlier operations of another: the
+// parent of a group can appear only after the group's first operation
+TEST(batchRunsInterleavedParentsInOrder) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::vector<BatchOp> ops = {
+        {Type::Touch, "/q/early", ""},
+        {Type::Mkdir, "/p", ""},
+        {Type::Mkdir, "/q", ""},
+        {Type::Touch, "/q/late", ""},
+    };
+    for (int i = 0; i < 500; ++i) {
+        ops.push_back({Type::Touch, "/p/f" + std::to_string(i), ""});
+        ops.push_back({Type::Write, "/q/f" + std::to_string(i), std::to_string(i)});
+    }
+    std::vector<bool> results = vfs.applyBatch(ops);
+
+    CHECK(!results[0]);
+    for (size_t i = 1; i < results.size(); ++i) {
+        CHECK(results[i]);
+    }
+    CHECK(vfs.ls("/p").size() == 500);
+    CHECK(vfs.ls("/q").size() == 501);
+    CHECK(vfs.cat("/q/f499") == "499");
+    CHECK(vfs.ls("/q").front() == "late"); // Listing keeps creation order
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(batchRemovingADirectoryForgetsParentsInsideIt) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::vector<BatchOp> ops = {
+        {Type::Mkdir, "/d", ""},
+        {Type::Mkdir, "/d/inner", ""},
+        {Type::Touch, "/d/inner/f", ""},
+        {Type::Remove, "/d", ""},
+        {Type::Touch, "/d/inner/g", ""}, // Its parent went with /d
+        {Type::Mkdir, "/d", ""},
+        {Type::Mkdir, "/d/inner", ""},
+        {Type::Touch, "/d/inner/g", ""},
+    };
+    std::vector<bool> results = vfs.applyBatch(ops);
+
+    CHECK((results == std::vector<bool>{true, true, true, true, false, true, true, true}));
+    CHECK(vfs.ls("/d/inner") == std::vector<std::string>{"g"});
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Spellings of one directory land in one group
+TEST(batchGroupsEquivalentParentPaths) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.cd("/dir"));
+    std::vector<BatchOp> ops = {
+        {Type::Touch, "/dir/a", ""},
+        {Type::Touch, "//dir/./b", ""},
+        {Type::Touch, "c", ""},
+        {Type::Touch, "./d", ""},
+    };
+    std::vector<bool> results = vfs.applyBatch(ops);
+
+    CHECK((results == std::vector<bool>{true, true, true, true}));
+    CHECK((vfs.ls("/dir") == std::vector<std::string>{"a", "b", "c", "d"}));
+}
@@ -0,0 +1,131 @@
+#include "Test.h"
+#include "../include/BlockStore.h"
+#include "../include/VirtualFileSystem.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string randomBytes(std::mt19937& random, size_t length) {
+    std::string bytes(length, '\0');
+    for (char& c : bytes) {
+        c = static_cast<char>(random());
+    }
+    return bytes;
+}
+
+std::string hex(const BlockStore::Digest& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    for (uint8_t byte : digest) {
+        text += digits[byte >> 4];
+        text += digits[byte & 15];
+    }
+    return text;
+}
+
+} // namespace
+
+TEST(blockStoreSha256MatchesKnownDigests) {
+    CHECK(hex(BlockStore::sha256("")) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(hex(BlockStore::sha256("abc")) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(hex(BlockStore::sha256(std::string(1000000, 'a'))) ==
+          "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(blockStoreKeepsEachPayloadOnce) {
+    BlockStore store;
+    auto first = store.intern("same payload");
+    auto second = store.intern("same payload");
+    auto other = store.intern("other payload");
+    CHECK(first == second);
+    CHECK(first != other);
+
+    BlockStore::Stats stats = store.getStats();
+    CHECK(stats.blocks == 2);
+    CHECK(stats.lookups == 3);
+    CHECK(stats.hits == 1);
+    CHECK(stats.uniqueBytes == first->size() + other->size());
+
+    // A block goes away with its last reference
+    first.reset();
+    second.reset();
+    CHECK(store.getStats().blocks == 1);
+    CHECK(store.intern("same payload").use_count() == 1);
+}
+
+TEST(blockStoreChargesABufferOnce) {
+    BlockStore store;
+    std::string payload(100, 'p');
+    CHECK(store.reference(&payload) == 100);
+    CHECK(store.reference(&payload) == 0);
+    CHECK(store.getStats().chargedBytes == 100);
+    CHECK(store.release(&payload) == 0);
+    CHECK(store.release(&payload) == 100);
+    CHECK(store.getStats().chargedBytes == 0);
+}
+
+// Cut points depend on the content around them, so an insert near the
+// start only changes the chunks close to it
+TEST(chunkBoundariesFollowTheContent) {
+    std::mt19937 random(11);
+    std::string data = randomBytes(random, 512 * 1024);
+    std::vector<size_t> lengths = BlockStore::chunkLengths(data, FileNode::kExtentSize);
+    size_t total = 0;
+    for (size_t length : lengths) {
+        CHECK(length > 0 && length <= FileNode::kExtentSize);
+        total += length;
+    }
+    CHECK(total == data.size());
+    CHECK(lengths.size() > 8);
+
+    std::string shifted = "inserted" + data;
+    std::vector<size_t> after = BlockStore::chunkLengths(shifted, FileNode::kExtentSize);
+    CHECK(after.back() == lengths.back());
+    CHECK(after[after.size() - 2] == lengths[lengths.size() - 2]);
+}
+
+TEST(dedupStoresIdenticalFilesOnce) {
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    vfs.setDeduplication(true);
+    std::mt19937 random(5);
+    std::string content = randomBytes(random, 300 * 1024);
+    for (int i = 0; i < 5; ++i) {
+        CHECK(vfs.write("/copy" + std::to_string(i), content));
+    }
+    // The same data shifted by a few bytes still shares most chunks
+    CHECK(vfs.write("/shifted", "xyz" + content));
+
+    VirtualFileSystem::DedupStats stats = vfs.getDedupStats();
+    CHECK(stats.enabled);
+    CHECK(stats.referencedBytes >= 6 * content.size());
+    CHECK(stats.uniqueBytes < 2 * content.size());
+    CHECK(stats.ratio > 3.0);
+    CHECK(vfs.cat("/copy3") == content);
+    CHECK(vfs.cat("/shifted") == "xyz" + content);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Switching dedup either way repacks the files and keeps them readable
+TEST(dedupCanBeSwitchedWithFilesPresent) {
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    std::mt19937 random(9);
+    std::string content = randomBytes(random, 200 * 1024);
+    CHECK(vfs.write("/a", content));
+    CHECK(vfs.write("/b", content));
+
+    vfs.setDeduplication(true);
+    CHECK(vfs.getDedupStats().uniqueBytes < 2 * content.size());
+    CHECK(vfs.cat("/b") == content);
+    CHECK(vfs.verifyUsedSpace());
+
+    vfs.setDeduplication(false);
+    CHECK(!vfs.isDeduplicationEnabled());
+    CHECK(vfs.cat("/a") == content);
+    CHECK(vfs.verifyUsedSpace());
+
+    CHECK(vfs.remove("/a"));
+    CHECK(vfs.remove("/b"));
+    CHECK(vfs.getDedupStats().uniqueBytes == 0);
+}
@@ -0,0 +1,142 @@
+#include "Test.h"
+#include "../include/ChildIndex.h"
+#include "../include/FileNode.h"
+#include "../include/NodeArena.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Children of a directory as the index sees them, with every name
+// interned in the arena the nodes live in
+struct Directory {
+    NodeArena& arena = NodeArena::shared();
+    ChildIndex::Children children;
+    std::vector<NameTable::NameId> names;
+
+    ~Directory() {
+        for (NameTable::NameId name : names) {
+            arena.names().release(name);
+        }
+    }
+
+    // Adds a child, optionally under a forced hash to make probes collide
+    FileNode* add(ChildIndex& index, const std::string& name, size_t hash) {
+        children.emplace_back(new (arena) FileNode(arena, name, false));
+        names.push_back(arena.names().acquire(name, hash));
+        CHECK(index.insert(children.back().get(), names.back(), hash, children.size() - 1));
+        return children.back().get();
+    }
+
+    FileNode* add(ChildIndex& index, const std::string& name) {
+        return add(index, name, FileNode::hashName(name));
+    }
+};
+
+} // namespace
+
+TEST(childIndexSmallDirectoriesHaveNoSlots) {
+    Directory dir;
+    ChildIndex small(ChildIndex::kFlatLimit);
+    CHECK(!small.isHashed());
+    ChildIndex large(ChildIndex::kFlatLimit + 1);
+    CHECK(large.isHashed());
+
+    FileNode* a = dir.add(small, "a");
+    FileNode* b = dir.add(small, "b");
+    CHECK(small.find("a", FileNode::hashName("a"), dir.arena.names()) == a);
+    CHECK(small.find("b", FileNode::hashName("b"), dir.arena.names()) == b);
+    CHECK(small.find("c", FileNode::hashName("c"), dir.arena.names()) == nullptr);
+}
+
+TEST(childIndexFindsEveryChildOfALargeDirectory) {
+    Directory dir;
+    ChildIndex index(1000);
+    std::vector<FileNode*> added;
+    for (int i = 0; i < 1000; ++i) {
+        added.push_back(dir.add(index, "file" + std::to_string(i)));
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        std::string name = "file" + std::to_string(i);
+        CHECK(index.find(name, FileNode::hashName(name), dir.arena.names()) == added[i]);
+    }
+    CHECK(index.find("missing", FileNode::hashName("missing"), dir.arena.names()) == nullptr);
+    CHECK(!index.insert(added[0], dir.names[0], FileNode::hashName("file0"), 0)); // Full
+}
+
+// A removed child leaves a tombstone: probes for colliding names must run
+// through it, and the walk order of the others must not change
+TEST(childIndexTombstonesKeepProbeChainsAndOrder) {
+    for (size_t capacity : {size_t(8), size_t(64)}) {
+        Directory dir;
+        ChildIndex index(capacity);
+        FileNode* first = dir.add(index, "first", 42);
+        FileNode* middle = dir.add(index, "middle", 42);
+        FileNode* last = dir.add(index, "last", 42);
+
+        CHECK(index.erase(middle, 42) == 1);
+        CHECK(index.size() == 2);
+        CHECK(index.end() == 3);
+        CHECK(index.child(1) == nullptr);
+        CHECK(index.find("middle", 42, dir.arena.names()) == nullptr);
+        CHECK(index.find("last", 42, dir.arena.names()) == last);
+        CHECK(index.child(0) == first);
+        CHECK(index.child(2) == last);
+        CHECK(index.erase(middle, 42) == ChildIndex::npos);
+    }
+}
+
+TEST(childIndexCompactedCopyDropsTombstones) {
+    Directory dir;
+    ChildIndex index(64);
+    const int added = 2 * ChildIndex::kFlatLimit;
+    for (int i = 0; i < added; ++i) {
+        dir.add(index, "n" + std::to_string(i));
+    }
+    for (int i = 0; i < added; i += 2) {
+        index.erase(dir.children[i].get(), FileNode::hashName("n" + std::to_string(i)));
+    }
+
+    // Half survive, which is small enough to go back to a flat list
+    ChildIndex compacted(index, dir.children, added / 2);
+    CHECK(compacted.size() == added / 2);
+    CHECK(compacted.end() == added / 2);
+    CHECK(!compacted.isHashed());
+    for (size_t i = 0; i < compacted.end(); ++i) {
+        CHECK(compacted.child(i) == dir.children[2 * i + 1].get());
+    }
+}
+
+TEST(childIndexRelocatePointsAtTheNewPosition) {
+    Directory dir;
+    ChildIndex index(4);
+    FileNode* a = dir.add(index, "a");
+    dir.add(index, "b");
+    index.relocate(a, FileNode::hashName("a"), 1);
+    CHECK(index.erase(a, FileNode::hashName("a")) == 1);
+}
+
+TEST(directoryLookupsAcrossTheFlatLimit) {
+    NodeArena& arena = NodeArena::shared();
+    std::unique_ptr<FileNode> dir(new FileNode(arena, "dir", true));
+    for (size_t i = 0; i < 3 * ChildIndex::kFlatLimit; ++i) {
+        dir->addChild(std::unique_ptr<FileNode>(new FileNode(arena, "c" + std::to_string(i), false)));
+        for (size_t j = 0; j <= i; ++j) {
+            CHECK(dir->findChild("c" + std::to_string(j)) != nullptr);
+        }
+    }
+
+    // Removal keeps the listing order of the rest
+    for (size_t i = 0; i < 3 * ChildIndex::kFlatLimit; i += 3) {
+        dir->removeChild("c" + std::to_string(i));
+    }
+    std::vector<std::string> listed;
+    dir->forEachChild([&](FileNode*, const std::string& name, size_t) { listed.push_back(name); });
+    CHECK(listed.size() == 2 * ChildIndex::kFlatLimit);
+    CHECK(listed.front() == "c1");
+    CHECK(listed.back() == "c" + std::to_string(3 * ChildIndex::kFlatLimit - 1));
+    CHECK(dir->findChild("c0") == nullptr);
+    CHECK(dir->findChild("c1") != nullptr);
+}
@@ -0,0 +1,270 @@
+#include "Test.h"
+#include "../include/Epoch.h"
+#include "../include/NodeLock.h"
+#include "../include/RwLock.h"
+#include "../include/VirtualFileSystem.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t kThreads = 8;
+
+// Two counters a writer bumps together; a reader that ever sees them
+// differ was let in while the writer was inside
+struct Pair {
+    long first = 0;
+    long second = 0;
+};
+
+template <typename Lock>
+void checkReadersExcludeWriters() {
+    Lock lock;
+    Pair pair;
+    std::atomic<size_t> torn{0};
+
+    test::parallel(kThreads, [&](size_t index) {
+        for (int i = 0; i < 20000; ++i) {
+            if (index % 4 == 0) {
+                std::unique_lock<Lock> guard(lock);
+                pair.first++;
+                pair.second++;
+            } else {
+                std::shared_lock<Lock> guard(lock);
+                if (pair.first != pair.second) {
+                    torn++;
+                }
+            }
+        }
+    });
+
+    CHECK(torn.load() == 0);
+    CHECK(pair.first == 2 * 20000);
+}
+
+// Readers keep overlapping so the lock is never free; a writer must still
+// get in instead of waiting for a gap that never comes
+template <typename Lock>
+void checkWriterNotStarved() {
+    Lock lock;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < kThreads; ++i) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                std::shared_lock<Lock> guard(lock);
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    auto writer = std::async(std::launch::async, [&] {
+        for (int i = 0; i < 100; ++i) {
+            std::unique_lock<Lock> guard(lock);
+        }
+    });
+    CHECK(writer.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+}
+
+// Content a writer stores whole; a reader seeing anything else saw a torn write
+std::string uniform(char fill, size_t length) {
+    return std::string(length, fill);
+}
+
+bool isUniform(const std::string& content) {
+    return content.find_first_not_of(content.empty() ? '\0' : content[0]) == std::string::npos;
+}
+
+} // namespace
+
+TEST(rwLockReadersExcludeWriters) {
+    checkReadersExcludeWriters<RwLock>();
+}
+
+TEST(rwLockWriterGetsInPastSteadyReaders) {
+    checkWriterNotStarved<RwLock>();
+}
+
+TEST(rwLockTryLockRespectsHolders) {
+    RwLock lock;
+    lock.lock_shared();
+    CHECK(!lock.try_lock());
+    CHECK(lock.try_lock_shared());
+    lock.unlock_shared();
+    lock.unlock_shared();
+
+    CHECK(lock.try_lock());
+    CHECK(!lock.try_lock_shared());
+    lock.unlock();
+}
+
+TEST(nodeLockReadersExcludeWriters) {
+    checkReadersExcludeWriters<NodeLock>();
+}
+
+TEST(nodeLockWriterGetsInPastSteadyReaders) {
+    checkWriterNotStarved<NodeLock>();
+}
+
+TEST(nodeLockTryLockRespectsHolders) {
+    NodeLock lock;
+    lock.lock_shared();
+    CHECK(!lock.try_lock());
+    CHECK(lock.try_lock_shared());
+    lock.unlock_shared();
+    lock.unlock_shared();
+
+    CHECK(lock.try_lock());
+    CHECK(!lock.try_lock_shared());
+    lock.unlock();
+    CHECK(lock.try_lock_shared());
+    lock.unlock_shared();
+}
+
+TEST(epochKeepsRetiredDataForOpenGuards) {
+    int domain = 0;
+    std::promise<void> entered;
+    std::promise<void> leave;
+    std::thread reader([&] {
+        Epoch::Guard guard(&domain);
+        entered.set_value();
+        leave.get_future().wait();
+    });
+    entered.get_future().wait();
+
+    // Enough to fill several batches, so collection runs meanwhile
+    std::atomic<size_t> reclaimed{0};
+    for (int i = 0; i < 500; ++i) {
+        Epoch::retire(&domain, [&reclaimed] { reclaimed++; });
+    }
+    CHECK(reclaimed.load() == 0);
+
+    leave.set_value();
+    reader.join();
+    Epoch::synchronize(&domain);
+    CHECK(reclaimed.load() == 500);
+}
+
+TEST(epochSynchronizeOnlyWaitsForItsDomain) {
+    int mine = 0;
+    int other = 0;
+    std::promise<void> entered;
+    std::promise<void> leave;
+    std::thread reader([&] {
+        Epoch::Guard guard(&other);
+        entered.set_value();
+        leave.get_future().wait();
+    });
+    entered.get_future().wait();
+
+    bool reclaimed = false;
+    Epoch::retire(&mine, [&reclaimed] { reclaimed = true; });
+    auto synchronized = std::async(std::launch::async, [&] { Epoch::synchronize(&mine); });
+    CHECK(synchronized.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    CHECK(reclaimed);
+
+    leave.set_value();
+    reader.join();
+}
+
+TEST(epochReadersNeverSeeReclaimedData) {
+    struct Box {
+        std::atomic<unsigned> canary{0xA11CE};
+    };
+
+    int domain = 0;
+    std::atomic<Box*> published{new Box()};
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> dead{0};
+
+    test::parallel(kThreads, [&](size_t index) {
+        if (index == 0) {
+            for (int i = 0; i < 20000; ++i) {
+                Box* previous = published.exchange(new Box());
+                Epoch::retire(&domain, [previous] {
+                    previous->canary = 0xDEAD;
+                    delete previous;
+                });
+            }
+            stop = true;
+            return;
+        }
+        while (!stop.load()) {
+            Epoch::Guard guard(&domain);
+            Box* box = published.load();
+            for (int i = 0; i < 16; ++i) {
+                if (box->canary.load() != 0xA11CE) {
+                    dead++;
+                }
+            }
+        }
+    });
+
+    CHECK(dead.load() == 0);
+    Epoch::synchronize(&domain);
+    delete published.load();
+}
+
+// Threads create, write, read, list, move and remove files at the same
+// time, partly in a directory of their own and partly in one they share.
+// Reads must never see a write half done, and the volume's incremental
+// accounting must agree with a recount afterwards
+TEST(vfsConcurrentMutationsStayConsistent) {
+    VirtualFileSystem vfs(256 * 1024 * 1024);
+    CHECK(vfs.mkdir("/shared"));
+    for (size_t t = 0; t < kThreads; ++t) {
+        CHECK(vfs.mkdir("/t" + std::to_string(t)));
+    }
+
+    std::atomic<size_t> torn{0};
+    test::parallel(kThreads, [&](size_t index) {
+        std::string own = "/t" + std::to_string(index);
+        char fill = static_cast<char>('a' + index);
+        for (int i = 0; i < 300; ++i) {
+            std::string file = own + "/f" + std::to_string(i % 20);
+            std::string common = "/shared/f" + std::to_string(i % 10);
+
+            vfs.write(file, uniform(fill, 100 + i * 37));
+            vfs.write(common, uniform(fill, 70000 + i)); // Spans two extents
+
+            if (!isUniform(vfs.cat(common)) || !isUniform(vfs.cat(file))) {
+                torn++;
+            }
+            std::string part;
+            if (vfs.read(common, 65000, 2000, part) && !isUniform(part)) {
+                torn++;
+            }
+            vfs.list("/shared");
+            vfs.stat(common);
+
+            if (i % 7 == 0) {
+                vfs.move(file, own + "/moved" + std::to_string(i));
+            }
+            if (i % 5 == 0) {
+                vfs.remove(own + "/moved" + std::to_string(i - 5));
+                vfs.remove(common);
+            }
+        }
+    });
+
+    CHECK(torn.load() == 0);
+    CHECK(vfs.verifyUsedSpace());
+
+    for (size_t t = 0; t < kThreads; ++t) {
+        CHECK(vfs.remove("/t" + std::to_string(t)));
+    }
+    CHECK(vfs.remove("/shared"));
+    CHECK(vfs.verifyUsedSpace());
+    CHECK(vfs.ls("/").empty());
+}
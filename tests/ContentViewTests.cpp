@@ -0,0 +1,102 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Content that differs at every position, so misplaced bytes show up
+std::string pattern(size_t length) {
+    std::string content(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+        content[i] = static_cast<char>('a' + (i * 7 + i / 251) % 26);
+    }
+    return content;
+}
+
+std::string join(const std::vector<ContentView>& views) {
+    std::string result;
+    for (const ContentView& view : views) {
+        result += view.view();
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(contentViewsOfASmallFileMatchTheSingleView) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.write("/small", "hello"));
+    FileNode* node = vfs.resolvePath("/small");
+
+    std::vector<ContentView> views = node->getContentViews();
+    CHECK(views.size() == 1);
+    CHECK(views[0].view() == "hello");
+    CHECK(views[0].data() == node->getContentView().data());
+
+    CHECK(vfs.touch("/empty"));
+    CHECK(vfs.resolvePath("/empty")->getContentViews().empty());
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.resolvePath("/dir")->getContentViews().empty());
+}
+
+// A plain file larger than one extent is borrowed extent by extent: the
+// views point into the stored payloads rather than into fresh copies
+TEST(contentViewsBorrowEveryExtentOfAPlainFile) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(3 * FileNode::kExtentSize + 123);
+    CHECK(vfs.write("/large", content));
+    FileNode* node = vfs.resolvePath("/large");
+
+    std::vector<ContentView> first = node->getContentViews();
+    std::vector<ContentView> second = node->getContentViews();
+    CHECK(first.size() == 4);
+    CHECK(join(first) == content);
+    for (size_t i = 0; i < first.size(); ++i) {
+        CHECK(first[i].size() <= FileNode::kExtentSize);
+        CHECK(first[i].data() == second[i].data());
+    }
+}
+
+TEST(contentViewsOutliveWritesAndRemoval) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(2 * FileNode::kExtentSize + 5);
+    CHECK(vfs.write("/file", content));
+    std::vector<ContentView> views = vfs.resolvePath("/file")->getContentViews();
+
+    CHECK(vfs.writeAt("/file", 10, "overwritten"));
+    CHECK(vfs.remove("/file"));
+    CHECK(join(views) == content);
+}
+
+TEST(contentViewsDecodeEncodedFilesPerExtent) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(2 * FileNode::kExtentSize + 77);
+    CHECK(vfs.write("/packed", content));
+    CHECK(vfs.compressFile("/packed"));
+    CHECK(vfs.write("/secret", content));
+    CHECK(vfs.encryptFile("/secret", "key"));
+
+    for (const char* path : {"/packed", "/secret"}) {
+        std::vector<ContentView> views = vfs.resolvePath(path)->getContentViews();
+        CHECK(views.size() == 3);
+        CHECK(join(views) == content);
+    }
+}
+
+// saveToDisk writes large files extent by extent
+TEST(contentOfLargeFilesSurvivesSaveAndLoad) {
+    std::string image = "content_view_test.bin";
+    std::string content = pattern(5 * FileNode::kExtentSize / 2);
+    {
+        VirtualFileSystem vfs(16 * 1024 * 1024);
+        CHECK(vfs.write("/large", content));
+        CHECK(vfs.saveToDisk(image));
+    }
+
+    VirtualFileSystem loaded(16 * 1024 * 1024);
+    CHECK(loaded.loadFromDisk(image));
+    CHECK(loaded.cat("/large") == content);
+    std::remove(image.c_str());
+}
@@ -0,0 +1,97 @@
+#include "Test.h"
+#include "../include/Delta.h"
+#include "../include/VirtualFileSystem.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string randomText(std::mt19937& random, size_t length) {
+    std::string text(length, '\0');
+    for (char& c : text) {
+        c = static_cast<char>('a' + random() % 26);
+    }
+    return text;
+}
+
+bool roundTrips(const std::string& base, const std::string& target) {
+    return DeltaCodec::apply(base, DeltaCodec::encode(base, target)) == target;
+}
+
+} // namespace
+
+TEST(deltaRoundTripsEdgeCases) {
+    std::string text = "The quick brown fox jumps over the lazy dog, again and again and again.";
+    CHECK(roundTrips("", ""));
+    CHECK(roundTrips("", text));
+    CHECK(roundTrips(text, ""));
+    CHECK(roundTrips(text, text));
+    CHECK(roundTrips(text, text.substr(10)));
+    CHECK(roundTrips(text, text + text));
+    CHECK(roundTrips(std::string(1000, 'a'), std::string(999, 'a') + "b"));
+    CHECK(roundTrips(std::string(100, '\0'), std::string(50, '\0') + std::string(50, '\xff')));
+}
+
+// Random inserts, deletes and overwrites of a random base
+TEST(deltaRoundTripsRandomEdits) {
+    std::mt19937 random(42);
+    for (int round = 0; round < 200; ++round) {
+        std::string base = randomText(random, random() % 5000);
+        std::string target = base;
+        for (int edit = 0, edits = random() % 8; edit < edits; ++edit) {
+            size_t at = target.empty() ? 0 : random() % target.size();
+            switch (random() % 3) {
+                case 0:
+                    target.insert(at, randomText(random, random() % 200));
+                    break;
+                case 1:
+                    target.erase(at, random() % 200);
+                    break;
+                default:
+                    target.replace(at, std::min<size_t>(10, target.size() - at), randomText(random, 10));
+                    break;
+            }
+        }
+        if (!roundTrips(base, target)) {
+            test::fail(__FILE__, __LINE__, "round " + std::to_string(round) + " did not round-trip");
+        }
+    }
+}
+
+TEST(deltaOfASmallEditIsSmall) {
+    std::mt19937 random(7);
+    std::string base = randomText(random, 100000);
+    std::string target = base;
+    target.replace(50000, 20, "twenty bytes changed");
+    CHECK(DeltaCodec::encode(base, target).size() < 200);
+}
+
+// Every kept version reads back, however its delta chain runs. Each
+// write snapshots the content it replaces
+TEST(versionHistoryReconstructsEveryVersion) {
+    VirtualFileSystem vfs;
+    std::mt19937 random(3);
+    std::string content = randomText(random, 20000);
+    std::vector<std::string> saved; // Newest first, like the history
+    CHECK(vfs.write("/f", content));
+    for (int i = 0; i < 25; ++i) {
+        saved.insert(saved.begin(), content);
+        content.replace(random() % 19000, 30, randomText(random, 30));
+        CHECK(vfs.write("/f", content));
+    }
+
+    FileNode* node = vfs.resolvePath("/f");
+    CHECK(node->getVersionCount() == 10); // Oldest ones dropped
+    for (size_t i = 0; i < node->getVersionCount(); ++i) {
+        if (node->getVersionContent(i) != saved[i]) {
+            test::fail(__FILE__, __LINE__, "version " + std::to_string(i) + " differs");
+        }
+    }
+
+    // Only keyframes hold whole copies: the newest version and one per
+    // keyframe interval, so at most three of the ten here
+    CHECK(node->getVersionStoredSize() < 4 * content.size());
+    CHECK(vfs.restoreFileVersion("/f", 9));
+    CHECK(vfs.cat("/f") == saved[9]);
+}
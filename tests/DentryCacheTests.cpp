@@ -0,0 +1,158 @@
+#include "Test.h"
+#include "../include/DentryCache.h"
+#include "../include/FileNode.h"
+#include "../include/NodeArena.h"
+#include "../include/VirtualFileSystem.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Nodes the cache can point at; it never looks inside them
+struct Nodes {
+    NodeArena& arena = NodeArena::shared();
+    std::vector<std::unique_ptr<FileNode>> owned;
+
+    FileNode* make(const std::string& name, bool isDirectory) {
+        owned.emplace_back(new (arena) FileNode(arena, name, isDirectory));
+        return owned.back().get();
+    }
+};
+
+size_t hashOf(const std::string& name) {
+    return FileNode::hashName(name);
+}
+
+} // namespace
+
+TEST(dentryCacheRemembersHitsAndMisses) {
+    Nodes nodes;
+    FileNode* dir = nodes.make("dir", true);
+    FileNode* file = nodes.make("file", false);
+    DentryCache cache(16);
+
+    FileNode* found = nullptr;
+    CHECK(!cache.lookup(dir, "file", hashOf("file"), found));
+    cache.insert(dir, "file", hashOf("file"), file);
+    cache.insert(dir, "absent", hashOf("absent"), nullptr);
+
+    CHECK(cache.lookup(dir, "file", hashOf("file"), found) && found == file);
+    CHECK(cache.lookup(dir, "absent", hashOf("absent"), found) && found == nullptr);
+
+    DentryCache::Stats stats = cache.getStats();
+    CHECK(stats.entries == 2);
+    CHECK(stats.hits == 2);
+    CHECK(stats.negativeHits == 1);
+    CHECK(stats.misses == 1);
+}
+
+// Equal hashes under different names or parents must not be mixed up
+TEST(dentryCacheKeysOnParentAndName) {
+    Nodes nodes;
+    FileNode* first = nodes.make("first", true);
+    FileNode* second = nodes.make("second", true);
+    FileNode* a = nodes.make("a", false);
+    FileNode* b = nodes.make("b", false);
+    DentryCache cache(16);
+
+    cache.insert(first, "a", 42, a);
+    cache.insert(first, "b", 42, b);
+    FileNode* found = nullptr;
+    CHECK(cache.lookup(first, "a", 42, found) && found == a);
+    CHECK(cache.lookup(first, "b", 42, found) && found == b);
+    CHECK(!cache.lookup(second, "a", 42, found));
+}
+
+TEST(dentryCacheEvictsLeastRecentlyUsed) {
+    Nodes nodes;
+    FileNode* dir = nodes.make("dir", true);
+    DentryCache cache(3);
+    for (std::string name : {"a", "b", "c"}) {
+        cache.insert(dir, name, hashOf(name), nodes.make(name, false));
+    }
+
+    FileNode* found = nullptr;
+    CHECK(cache.lookup(dir, "a", hashOf("a"), found)); // "b" is now the oldest
+    cache.insert(dir, "d", hashOf("d"), nodes.make("d", false));
+
+    CHECK(!cache.lookup(dir, "b", hashOf("b"), found));
+    CHECK(cache.lookup(dir, "a", hashOf("a"), found));
+    CHECK(cache.lookup(dir, "c", hashOf("c"), found));
+    CHECK(cache.lookup(dir, "d", hashOf("d"), found));
+    CHECK(cache.getStats().entries == 3);
+    CHECK(cache.getStats().evictions == 1);
+
+    cache.setCapacity(1);
+    CHECK(cache.getStats().entries == 1);
+    CHECK(cache.lookup(dir, "d", hashOf("d"), found));
+}
+
+TEST(dentryCacheInvalidatesOneNameOrAWholeDirectory) {
+    Nodes nodes;
+    FileNode* dir = nodes.make("dir", true);
+    FileNode* other = nodes.make("other", true);
+    DentryCache cache(16);
+    for (std::string name : {"a", "b", "c"}) {
+        cache.insert(dir, name, hashOf(name), nodes.make(name, false));
+    }
+    cache.insert(other, "a", hashOf("a"), nullptr);
+
+    FileNode* found = nullptr;
+    cache.invalidate(dir, "b", hashOf("b"));
+    CHECK(!cache.lookup(dir, "b", hashOf("b"), found));
+    CHECK(cache.lookup(dir, "a", hashOf("a"), found));
+
+    cache.invalidateChildren(dir);
+    CHECK(!cache.lookup(dir, "a", hashOf("a"), found));
+    CHECK(!cache.lookup(dir, "c", hashOf("c"), found));
+    CHECK(cache.lookup(other, "a", hashOf("a"), found));
+
+    cache.clear();
+    CHECK(cache.getStats().entries == 0);
+}
+
+// A cached miss must not hide a name created later, and a cached hit must
+// not outlive the node it points at
+TEST(vfsLookupsSeeEveryTreeChange) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(!vfs.stat("/dir/file").exists);
+    CHECK(!vfs.stat("/dir").exists);
+
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.stat("/dir").exists);
+    CHECK(vfs.write("/dir/file", "one"));
+    CHECK(vfs.cat("/dir/file") == "one");
+
+    CHECK(vfs.move("/dir/file", "/dir/renamed"));
+    CHECK(!vfs.stat("/dir/file").exists);
+    CHECK(vfs.cat("/dir/renamed") == "one");
+
+    CHECK(vfs.move("/dir", "/elsewhere"));
+    CHECK(!vfs.stat("/dir/renamed").exists);
+    CHECK(vfs.cat("/elsewhere/renamed") == "one");
+
+    CHECK(vfs.remove("/elsewhere"));
+    CHECK(!vfs.stat("/elsewhere/renamed").exists);
+    CHECK(vfs.mkdir("/elsewhere"));
+    CHECK(!vfs.stat("/elsewhere/renamed").exists);
+
+    CHECK(vfs.getDentryCacheStats().hits > 0);
+}
+
+TEST(vfsDentryCacheCapacityCanBeChanged) {
+    VirtualFileSystem vfs(1024 * 1024);
+    vfs.setDentryCacheCapacity(4);
+    for (int i = 0; i < 20; ++i) {
+        CHECK(vfs.write("/f" + std::to_string(i), "x"));
+    }
+    // Rewrites look each existing name up and cache it
+    for (int i = 0; i < 20; ++i) {
+        CHECK(vfs.write("/f" + std::to_string(i), "y"));
+    }
+    DentryCache::Stats stats = vfs.getDentryCacheStats();
+    CHECK(stats.capacity == 4);
+    CHECK(stats.entries <= 4);
+    CHECK(stats.evictions > 0);
+    CHECK(vfs.cat("/f0") == "y");
+}
@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "../include/Compression.h"
+#include "../include/Encryption.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+
+namespace {
+
+std::string sample() {
+    std::string text;
+    for (int i = 0; i < 400; ++i) {
+        text += "line " + std::to_string(i % 7) + " of a fairly repetitive file\n";
+    }
+    return text;
+}
+
+} // namespace
+
+// Every algorithm must give back exactly what it was given, including
+// inputs that trip up simple implementations
+TEST(encodingAlgorithmsRoundTrip) {
+    for (const std::string& input : {std::string(), std::string("a"), std::string(1000, 'z'), sample()}) {
+        for (const std::string& name : CompressionFactory::listAvailableAlgorithms()) {
+            auto algorithm = CompressionFactory::createAlgorithm(name);
+            if (algorithm->decompress(algorithm->compress(input)) != input) {
+                test::fail(__FILE__, __LINE__, name + " changed a " + std::to_string(input.size()) + " byte input");
+            }
+        }
+        for (const std::string& name : EncryptionFactory::listAvailableAlgorithms()) {
+            auto algorithm = EncryptionFactory::createAlgorithm(name);
+            if (algorithm->decrypt(algorithm->encrypt(input, "secret key"), "secret key") != input) {
+                test::fail(__FILE__, __LINE__, name + " changed a " + std::to_string(input.size()) + " byte input");
+            }
+        }
+    }
+}
+
+// A compressed file keeps only its compressed payload
+TEST(compressedFilesStoreOnlyThePayload) {
+    VirtualFileSystem vfs;
+    std::string content = sample();
+    CHECK(vfs.write("/f", content));
+    size_t plainUsed = vfs.getUsedSpace();
+
+    CHECK(vfs.compressFile("/f"));
+    FileStat stat = vfs.stat("/f");
+    CHECK(stat.compressed);
+    CHECK(stat.size == content.size());
+    CHECK(stat.storedSize < content.size());
+    CHECK(vfs.getUsedSpace() < plainUsed);
+    CHECK(vfs.cat("/f") == content);
+
+    CHECK(vfs.compressFile("/f", false));
+    CHECK(vfs.stat("/f").storedSize == content.size());
+    CHECK(vfs.cat("/f") == content);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(compressedAndEncryptedFilesReadBackEveryWay) {
+    VirtualFileSystem vfs;
+    std::string content = sample();
+    for (const std::string& compression : CompressionFactory::listAvailableAlgorithms()) {
+        for (const std::string& encryption : EncryptionFactory::listAvailableAlgorithms()) {
+            std::string path = "/" + compression + "-" + encryption;
+            CHECK(vfs.write(path, content));
+            CHECK(vfs.compressFile(path, true, compression));
+            CHECK(vfs.encryptFile(path, "key", encryption));
+            CHECK(vfs.getFileCompressionAlgorithm(path) == compression);
+            CHECK(vfs.getFileEncryptionAlgorithm(path) == encryption);
+
+            std::string part;
+            CHECK(vfs.read(path, 100, 50, part) && part == content.substr(100, 50));
+            CHECK(vfs.append(path, "more"));
+            CHECK(vfs.cat(path) == content + "more");
+            CHECK(vfs.changeEncryptionKey(path, "other"));
+            CHECK(vfs.cat(path) == content + "more");
+        }
+    }
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Versions keep the logical content, so restoring one after the encoding
+// changed gives back text rather than an old payload
+TEST(versionsSurviveEncodingChanges) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.write("/f", "first"));
+    CHECK(vfs.saveFileVersion("/f"));
+    CHECK(vfs.write("/f", "second"));
+    CHECK(vfs.compressFile("/f"));
+    CHECK(vfs.encryptFile("/f", "key"));
+
+    CHECK(vfs.restoreFileVersion("/f", vfs.getFileVersionCount("/f") - 1));
+    CHECK(vfs.cat("/f") == "first");
+    CHECK(vfs.isFileCompressed("/f"));
+}
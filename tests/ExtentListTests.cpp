@@ -0,0 +1,108 @@
+#include "Test.h"
+#include "../include/ExtentList.h"
+#include "../include/VirtualFileSystem.h"
+#include <memory>
+#include <string>
+
+namespace {
+
+constexpr size_t kChunk = ExtentList::kChunkExtents;
+
+ExtentList::Extent extentAt(size_t index) {
+    return ExtentList::Extent{std::make_shared<const std::string>(std::to_string(index)), index * 10, 10};
+}
+
+ExtentList listOf(size_t count) {
+    ExtentList list;
+    for (size_t i = 0; i < count; ++i) {
+        list.push_back(extentAt(i));
+    }
+    return list;
+}
+
+size_t differences(const ExtentList& a, const ExtentList& b) {
+    size_t visited = 0;
+    ExtentList::forEachDifference(a, b, [&](size_t) { visited++; });
+    return visited;
+}
+
+} // namespace
+
+TEST(extentListKeepsItsOrder) {
+    ExtentList list = listOf(3 * kChunk + 5);
+    CHECK(list.size() == 3 * kChunk + 5);
+    CHECK(list.front().offset == 0);
+    CHECK(list.back().offset == (3 * kChunk + 4) * 10);
+    size_t expected = 0;
+    for (const ExtentList::Extent& extent : list) {
+        CHECK(extent.offset == expected * 10);
+        expected++;
+    }
+    CHECK(expected == list.size());
+
+    for (size_t position : {size_t(0), size_t(9), size_t(10), kChunk * 10 - 1, kChunk * 10, (3 * kChunk + 4) * 10 + 9}) {
+        CHECK(list.find(position) == position / 10);
+    }
+}
+
+// Changing a copy leaves the original alone and unshares only one chunk
+TEST(extentListCopiesShareUntouchedChunks) {
+    ExtentList original = listOf(4 * kChunk);
+    ExtentList copy = original;
+    CHECK(differences(original, copy) == 0);
+
+    copy.set(kChunk + 3, extentAt(999));
+    CHECK(*copy[kChunk + 3].payload == "999");
+    CHECK(*original[kChunk + 3].payload == std::to_string(kChunk + 3));
+    CHECK(differences(original, copy) == kChunk);
+
+    // Appending to a full last chunk starts a new one
+    ExtentList grown = original;
+    grown.push_back(extentAt(4 * kChunk));
+    CHECK(differences(original, grown) == 1);
+    CHECK(original.size() == 4 * kChunk);
+}
+
+TEST(extentListTruncatesWithinAndAcrossChunks) {
+    ExtentList original = listOf(3 * kChunk);
+    ExtentList shorter = original;
+    shorter.truncate(kChunk + 1);
+    CHECK(shorter.size() == kChunk + 1);
+    CHECK(shorter.back().offset == kChunk * 10);
+    CHECK(original.size() == 3 * kChunk);
+    CHECK(original[kChunk + 1].offset == (kChunk + 1) * 10);
+
+    shorter.push_back(extentAt(kChunk + 1));
+    CHECK(shorter.size() == kChunk + 2);
+    CHECK(differences(original, shorter) == 2 * kChunk);
+
+    shorter.truncate(kChunk);
+    CHECK(differences(original, shorter) == 2 * kChunk);
+    shorter.clear();
+    CHECK(shorter.empty());
+    CHECK(original.size() == 3 * kChunk);
+}
+
+// Appends through a writer land in the last chunk, so the accounting stays
+// exact as the file grows past several chunks
+TEST(largeAppendsKeepAccountingExact) {
+    VirtualFileSystem vfs(512 * 1024 * 1024);
+    std::string block(FileNode::kExtentSize, 'a');
+    auto writer = vfs.createWriter("/big");
+    for (size_t i = 0; i < 2 * kChunk + 10; ++i) {
+        block[0] = static_cast<char>('a' + i % 26);
+        CHECK(writer->write(block));
+    }
+    CHECK(writer->close());
+    CHECK(vfs.stat("/big").size == (2 * kChunk + 10) * block.size());
+    CHECK(vfs.verifyUsedSpace());
+
+    CHECK(vfs.append("/big", "tail"));
+    CHECK(vfs.writeAt("/big", kChunk * block.size(), "z"));
+    CHECK(vfs.truncate("/big", kChunk * block.size() + 1));
+    std::string part;
+    CHECK(vfs.read("/big", kChunk * block.size() - 1, 10, part) && part == "az");
+    CHECK(vfs.verifyUsedSpace());
+    CHECK(vfs.remove("/big"));
+    CHECK(vfs.verifyUsedSpace());
+}
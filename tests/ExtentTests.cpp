@@ -0,0 +1,96 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+
+namespace {
+
+constexpr size_t kExtent = FileNode::kExtentSize;
+
+// Content that differs at every position, so misplaced bytes show up
+std::string pattern(size_t length, size_t seed = 0) {
+    std::string content(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+        content[i] = static_cast<char>('a' + (i * 7 + i / 251 + seed) % 26);
+    }
+    return content;
+}
+
+} // namespace
+
+// Partial writes are checked against the same edit on a plain string
+TEST(partialWritesMatchAStringModel) {
+    VirtualFileSystem vfs;
+    std::string model = pattern(3 * kExtent + 500);
+    CHECK(vfs.write("/f", model));
+
+    struct Edit {
+        size_t offset;
+        size_t length;
+    };
+    for (Edit edit : {Edit{0, 10}, Edit{kExtent - 5, 10}, Edit{kExtent, kExtent}, Edit{100, 2 * kExtent + 7},
+                      Edit{model.size() - 3, 20}}) {
+        std::string data = pattern(edit.length, edit.offset);
+        CHECK(vfs.writeAt("/f", edit.offset, data));
+        if (model.size() < edit.offset + edit.length) {
+            model.resize(edit.offset + edit.length);
+        }
+        model.replace(edit.offset, edit.length, data);
+        CHECK(vfs.cat("/f") == model);
+    }
+    CHECK(vfs.stat("/f").size == model.size());
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(writingPastTheEndZeroFillsTheGap) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.write("/f", "head"));
+    CHECK(vfs.writeAt("/f", 2 * kExtent + 10, "tail"));
+
+    std::string expected = "head" + std::string(2 * kExtent + 6, '\0') + "tail";
+    CHECK(vfs.cat("/f") == expected);
+    CHECK(!vfs.writeAt("/missing", 3, "x")); // Unlike append, doesn't create
+    CHECK(vfs.append("/new", "x"));
+    CHECK(vfs.cat("/new") == "x");
+}
+
+TEST(appendsAndTruncatesAcrossExtents) {
+    VirtualFileSystem vfs;
+    std::string model;
+    for (int i = 0; i < 40; ++i) {
+        std::string chunk = pattern(5000 + i * 97, i);
+        CHECK(vfs.append("/log", chunk));
+        model += chunk;
+    }
+    CHECK(vfs.cat("/log") == model);
+
+    for (size_t size : {model.size() - 1, 2 * kExtent + 1, 2 * kExtent, kExtent - 1, size_t(0)}) {
+        CHECK(vfs.truncate("/log", size));
+        model.resize(size);
+        CHECK(vfs.cat("/log") == model);
+        CHECK(vfs.stat("/log").size == size);
+    }
+    CHECK(vfs.truncate("/log", 1000));
+    CHECK(vfs.cat("/log") == std::string(1000, '\0'));
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Extents are encoded one at a time, so a partial write to a compressed or
+// encrypted file only has to re-encode what it touches and still reads back
+TEST(partialWritesToEncodedFiles) {
+    VirtualFileSystem vfs;
+    std::string model = pattern(3 * kExtent);
+    for (const char* path : {"/packed", "/secret"}) {
+        CHECK(vfs.write(path, model));
+    }
+    CHECK(vfs.compressFile("/packed", true, "LZW"));
+    CHECK(vfs.encryptFile("/secret", "key"));
+
+    std::string data = pattern(300, 5);
+    model.replace(kExtent - 100, 300, data);
+    for (const char* path : {"/packed", "/secret"}) {
+        CHECK(vfs.writeAt(path, kExtent - 100, data));
+        CHECK(vfs.cat(path) == model);
+        CHECK(vfs.append(path, "!"));
+        CHECK(vfs.cat(path) == model + "!");
+    }
+}
@@ -0,0 +1,157 @@
+#include "Test.h"
+#include "../include/FileHandle.h"
+#include "../include/VirtualFileSystem.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace {
+
+std::string readAll(FileHandle& handle) {
+    std::string content(handle.size(), '\0');
+    content.resize(handle.pread(&content[0], content.size(), 0));
+    return content;
+}
+
+} // namespace
+
+TEST(openRespectsItsFlags) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.open("/missing") == nullptr);
+    CHECK(vfs.open("/dir", FileHandle::Read | FileHandle::Write) == nullptr);
+    CHECK(vfs.open("/nodir/file", FileHandle::Write | FileHandle::Create) == nullptr);
+
+    auto created = vfs.open("/new", FileHandle::Write | FileHandle::Create);
+    CHECK(created && created->isOpen());
+    CHECK(vfs.stat("/new").exists);
+
+    CHECK(vfs.write("/file", "old content"));
+    auto truncated = vfs.open("/file", FileHandle::Read | FileHandle::Write | FileHandle::Truncate);
+    CHECK(truncated && truncated->size() == 0);
+    CHECK(vfs.cat("/file").empty());
+
+    // A read-only handle can't write, and a write-only one can't read
+    CHECK(vfs.write("/file", "content"));
+    auto reader = vfs.open("/file", FileHandle::Read);
+    CHECK(reader->write("x") == 0);
+    CHECK(readAll(*reader) == "content");
+    auto writer = vfs.open("/file", FileHandle::Write);
+    char buffer[4];
+    CHECK(writer->read(buffer, sizeof(buffer)) == 0);
+}
+
+TEST(handleReadsAndWritesAtItsPosition) {
+    VirtualFileSystem vfs(1024 * 1024);
+    auto handle = vfs.open("/file", FileHandle::Read | FileHandle::Write | FileHandle::Create);
+    CHECK(handle->write("hello ") == 6);
+    CHECK(handle->write("world") == 5);
+    CHECK(handle->tell() == 11);
+    CHECK(vfs.cat("/file") == "hello world");
+
+    CHECK(handle->seek(0));
+    char buffer[5];
+    CHECK(handle->read(buffer, 5) == 5);
+    CHECK(std::string(buffer, 5) == "hello");
+    CHECK(handle->tell() == 5);
+
+    CHECK(handle->seek(1, FileHandle::SeekCur));
+    CHECK(handle->write("WORLD") == 5);
+    CHECK(vfs.cat("/file") == "hello WORLD");
+
+    CHECK(handle->seek(-5, FileHandle::SeekEnd));
+    CHECK(handle->tell() == 6);
+    CHECK(!handle->seek(-100, FileHandle::SeekCur));
+    CHECK(handle->tell() == 6);
+
+    // Reading at the end transfers nothing
+    CHECK(handle->seek(0, FileHandle::SeekEnd));
+    CHECK(handle->read(buffer, 5) == 0);
+}
+
+TEST(positionalIoLeavesThePositionAlone) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.write("/file", "0123456789"));
+    auto handle = vfs.open("/file", FileHandle::Read | FileHandle::Write);
+    CHECK(handle->seek(2));
+
+    char buffer[3];
+    CHECK(handle->pread(buffer, 3, 7) == 3);
+    CHECK(std::string(buffer, 3) == "789");
+    CHECK(handle->pread(buffer, 3, 9) == 1);
+    CHECK(handle->pwrite("ab", 2, 4) == 2);
+    CHECK(handle->tell() == 2);
+    CHECK(vfs.cat("/file") == "0123ab6789");
+}
+
+TEST(appendHandlesAlwaysWriteAtTheEnd) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.write("/log", "one\n"));
+    auto handle = vfs.open("/log", FileHandle::Write | FileHandle::Append);
+    CHECK(vfs.append("/log", "two\n"));
+    CHECK(handle->seek(0));
+    CHECK(handle->write("three\n") == 6);
+    CHECK(vfs.cat("/log") == "one\ntwo\nthree\n");
+}
+
+// Writes through a handle cross extent boundaries like any other write
+TEST(handleWritesSpanExtents) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    auto handle = vfs.open("/big", FileHandle::Read | FileHandle::Write | FileHandle::Create);
+    std::string chunk(FileNode::kExtentSize / 3 + 7, 'a');
+    std::string expected;
+    for (int i = 0; i < 10; ++i) {
+        std::fill(chunk.begin(), chunk.end(), static_cast<char>('a' + i));
+        CHECK(handle->write(chunk) == chunk.size());
+        expected += chunk;
+    }
+    CHECK(handle->size() == expected.size());
+    CHECK(readAll(*handle) == expected);
+    CHECK(vfs.cat("/big") == expected);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(handleFollowsItsFileThroughMoves) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.write("/a/file", "start"));
+    auto handle = vfs.open("/a/file", FileHandle::Read | FileHandle::Write | FileHandle::Append);
+
+    CHECK(vfs.move("/a/file", "/a/renamed"));
+    CHECK(vfs.move("/a", "/b"));
+    CHECK(handle->isOpen());
+    CHECK(handle->write("+more") == 5);
+    CHECK(vfs.cat("/b/renamed") == "start+more");
+}
+
+TEST(handlesCloseWhenTheirFileGoesAway) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.write("/dir/file", "x"));
+    CHECK(vfs.write("/other", "y"));
+    auto removed = vfs.open("/dir/file", FileHandle::Read);
+    auto kept = vfs.open("/other", FileHandle::Read);
+
+    CHECK(vfs.remove("/dir"));
+    CHECK(!removed->isOpen());
+    char buffer[1];
+    CHECK(removed->pread(buffer, 1, 0) == 0);
+    CHECK(!removed->seek(0));
+    CHECK(kept->isOpen());
+
+    kept->close();
+    CHECK(!kept->isOpen());
+    CHECK(kept->size() == 0);
+}
+
+TEST(handlesOutliveTheirVolumeClosed) {
+    std::unique_ptr<FileHandle> handle;
+    {
+        VirtualFileSystem vfs(1024 * 1024);
+        CHECK(vfs.write("/file", "x"));
+        handle = vfs.open("/file", FileHandle::Read | FileHandle::Write);
+        CHECK(handle->isOpen());
+    }
+    CHECK(!handle->isOpen());
+    CHECK(handle->write("y") == 0);
+}
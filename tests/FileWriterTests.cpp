@@ -0,0 +1,127 @@
+#include "Test.h"
+#include "../include/FileWriter.h"
+#include "../include/VirtualFileSystem.h"
+#include <memory>
+#include <string>
+
+namespace {
+
+constexpr size_t kExtent = FileNode::kExtentSize;
+
+std::string pattern(size_t length) {
+    std::string content(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+        content[i] = static_cast<char>('a' + (i * 13 + i / 97) % 26);
+    }
+    return content;
+}
+
+// Writes content in chunks of an awkward size, so they straddle extents
+void stream(FileWriter& writer, const std::string& content) {
+    const size_t chunk = kExtent / 3 + 11;
+    for (size_t offset = 0; offset < content.size(); offset += chunk) {
+        CHECK(writer.write(content.substr(offset, chunk)));
+    }
+}
+
+} // namespace
+
+TEST(writerCommitsOnClose) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(4 * kExtent + 321);
+    auto writer = vfs.createWriter("/big");
+    CHECK(writer && writer->isOpen());
+    stream(*writer, content);
+    CHECK(writer->size() == content.size());
+
+    CHECK(!vfs.stat("/big").exists);
+    CHECK(writer->close());
+    CHECK(!writer->isOpen());
+    CHECK(!writer->write("late"));
+
+    CHECK(vfs.cat("/big") == content);
+    CHECK(vfs.stat("/big").size == content.size());
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Readers see the old content until the writer closes, then all of the new
+TEST(writerReplacesExistingContentInOneStep) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.write("/f", "old content"));
+    std::string content = pattern(2 * kExtent + 5);
+
+    auto writer = vfs.createWriter("/f");
+    stream(*writer, content);
+    CHECK(vfs.cat("/f") == "old content");
+    CHECK(writer->close());
+    CHECK(vfs.cat("/f") == content);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(writerDiscardsAbortedContent) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.write("/kept", "kept"));
+    size_t used = vfs.getUsedSpace();
+
+    auto aborted = vfs.createWriter("/kept");
+    stream(*aborted, pattern(2 * kExtent));
+    aborted->abort();
+    CHECK(!aborted->close());
+    {
+        auto dropped = vfs.createWriter("/never");
+        stream(*dropped, pattern(kExtent + 1));
+    }
+
+    CHECK(vfs.cat("/kept") == "kept");
+    CHECK(!vfs.stat("/never").exists);
+    CHECK(vfs.getUsedSpace() == used);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(writerKeepsTheFilesEncoding) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.write("/f", "x"));
+    CHECK(vfs.compressFile("/f"));
+    CHECK(vfs.encryptFile("/f", "key"));
+    std::string content = pattern(3 * kExtent);
+
+    auto writer = vfs.createWriter("/f");
+    stream(*writer, content);
+    CHECK(writer->close());
+
+    FileStat stat = vfs.stat("/f");
+    CHECK(stat.compressed && stat.encrypted);
+    CHECK(vfs.cat("/f") == content);
+    std::string part;
+    CHECK(vfs.read("/f", kExtent - 10, 20, part) && part == content.substr(kExtent - 10, 20));
+    CHECK(vfs.verifyUsedSpace());
+}
+
+TEST(writerNeedsItsDirectory) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.createWriter("/missing/f") == nullptr);
+    CHECK(vfs.createWriter("/dir") == nullptr);
+
+    // A relative path is fixed when the writer is created, not when it closes
+    CHECK(vfs.cd("/dir"));
+    auto relative = vfs.createWriter("f");
+    CHECK(vfs.cd("/"));
+    CHECK(relative->write("data"));
+    CHECK(relative->close());
+    CHECK(vfs.cat("/dir/f") == "data");
+
+    auto writer = vfs.createWriter("/dir/g");
+    CHECK(writer->write("data"));
+    CHECK(vfs.remove("/dir"));
+    CHECK(!writer->close());
+    CHECK(!vfs.stat("/dir").exists);
+
+    std::unique_ptr<FileWriter> orphan;
+    {
+        VirtualFileSystem gone(1024 * 1024);
+        orphan = gone.createWriter("/f");
+        CHECK(orphan->write("data"));
+    }
+    CHECK(!orphan->close());
+}
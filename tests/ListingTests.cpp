@@ -0,0 +1,157 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::map<std::string, DirEntry> byName(const std::vector<DirEntry>& entries) {
+    std::map<std::string, DirEntry> result;
+    for (const DirEntry& entry : entries) {
+        CHECK(result.emplace(entry.name, entry).second);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(listFillsEveryFieldOfAnEntry) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string text(5000, 't');
+    CHECK(vfs.mkdir("/dir"));
+    CHECK(vfs.mkdir("/dir/sub"));
+    CHECK(vfs.write("/dir/sub/deep", "not listed"));
+    CHECK(vfs.write("/dir/plain", "hello"));
+    CHECK(vfs.write("/dir/packed", text));
+    CHECK(vfs.compressFile("/dir/packed"));
+    CHECK(vfs.write("/dir/secret", "hidden"));
+    CHECK(vfs.encryptFile("/dir/secret", "key"));
+    CHECK(vfs.write("/dir/plain", "hello again"));
+
+    auto entries = byName(vfs.list("/dir"));
+    CHECK(entries.size() == 4);
+
+    const DirEntry& sub = entries["sub"];
+    CHECK(sub.isDirectory && !sub.isMountPoint);
+    CHECK(sub.size == 0 && sub.versions == 0);
+
+    const DirEntry& plain = entries["plain"];
+    CHECK(!plain.isDirectory);
+    CHECK(plain.size == 11 && plain.storedSize == 11);
+    CHECK(plain.versions == vfs.getFileVersionCount("/dir/plain"));
+    CHECK(plain.versions > 0);
+    CHECK(plain.modified != 0);
+
+    const DirEntry& packed = entries["packed"];
+    CHECK(packed.compressed && !packed.encrypted);
+    CHECK(packed.size == text.size() && packed.storedSize < text.size());
+
+    const DirEntry& secret = entries["secret"];
+    CHECK(secret.encrypted && !secret.compressed);
+    CHECK(secret.size == 6);
+}
+
+// ls() is the same listing with directories marked by a trailing slash
+TEST(listAgreesWithLs) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/d"));
+    CHECK(vfs.write("/f", "x"));
+    CHECK(vfs.cd("/d"));
+    CHECK(vfs.write("inner", "y"));
+
+    auto names = vfs.ls("/");
+    auto entries = vfs.list("/");
+    CHECK(names.size() == entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        CHECK(names[i] == entries[i].name + (entries[i].isDirectory ? "/" : ""));
+    }
+
+    // No path lists the cwd
+    auto here = vfs.list();
+    CHECK(here.size() == 1 && here[0].name == "inner");
+}
+
+TEST(listOnlyListsDirectories) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.write("/f", "x"));
+    CHECK(vfs.mkdir("/empty"));
+    CHECK(vfs.list("/f").empty());
+    CHECK(vfs.list("/missing").empty());
+    CHECK(vfs.list("/empty").empty());
+}
+
+TEST(listMarksMountPointsAndListsInsideThem) {
+    std::string image = "listing_test.bin";
+    {
+        VirtualFileSystem source(1024 * 1024);
+        CHECK(source.write("/inside", "abc"));
+        CHECK(source.saveToDisk(image));
+    }
+
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/local"));
+    CHECK(vfs.mountVolume(image, "/mnt"));
+    auto entries = byName(vfs.list("/"));
+    CHECK(entries["mnt"].isMountPoint);
+    CHECK(!entries["local"].isMountPoint);
+
+    auto inside = vfs.list("/mnt");
+    CHECK(inside.size() == 1 && inside[0].name == "inside" && inside[0].size == 3);
+
+    CHECK(vfs.unmountVolume("/mnt"));
+    std::remove(image.c_str());
+}
+
+// Entries own their names, so removing, renaming or relocating the nodes
+// they came from can't change or invalidate them
+TEST(listedEntriesOutliveTheirNodes) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    for (int i = 0; i < 50; ++i) {
+        CHECK(vfs.write("/dir/file" + std::to_string(i), "x"));
+    }
+    std::vector<DirEntry> entries = vfs.list("/dir");
+
+    CHECK(vfs.move("/dir/file0", "/dir/renamed"));
+    CHECK(vfs.remove("/dir"));
+    vfs.compactNodes();
+    CHECK(entries.size() == 50);
+    std::set<std::string> names;
+    for (const DirEntry& entry : entries) {
+        names.insert(entry.name);
+    }
+    CHECK(names.size() == 50);
+    CHECK(names.count("file0") == 1 && names.count("file49") == 1);
+}
+
+TEST(listRunsAlongsideRenames) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    for (int i = 0; i < 20; ++i) {
+        CHECK(vfs.write("/dir/a" + std::to_string(i), "x"));
+    }
+
+    std::atomic<size_t> bad{0};
+    test::parallel(4, [&](size_t index) {
+        for (int round = 0; round < 200; ++round) {
+            if (index == 0) {
+                std::string from = round % 2 ? "/dir/b" : "/dir/a";
+                std::string to = round % 2 ? "/dir/a" : "/dir/b";
+                for (int i = 0; i < 20; ++i) {
+                    vfs.move(from + std::to_string(i), to + std::to_string(i));
+                }
+                continue;
+            }
+            for (const DirEntry& entry : vfs.list("/dir")) {
+                if (entry.name.size() < 2 || (entry.name[0] != 'a' && entry.name[0] != 'b') || entry.size != 1) {
+                    bad++;
+                }
+            }
+        }
+    });
+    CHECK(bad.load() == 0);
+}
@@ -0,0 +1,104 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <atomic>
+#include <string>
+
+namespace {
+
+constexpr size_t kThreads = 8;
+
+size_t countFiles(VirtualFileSystem& vfs, const std::string& directory) {
+    size_t files = 0;
+    for (const DirEntry& entry : vfs.list(directory)) {
+        files += entry.isDirectory ? 0 : 1;
+    }
+    return files;
+}
+
+} // namespace
+
+// Moves run both ways between the same two directories, so threads lock
+// them in opposite path order; the documented ordering must keep them
+// from deadlocking, and no file may be lost or duplicated
+TEST(opposingMovesNeitherDeadlockNorLoseFiles) {
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    CHECK(vfs.mkdir("/left"));
+    CHECK(vfs.mkdir("/right"));
+    const size_t perThread = 16;
+    for (size_t t = 0; t < kThreads; ++t) {
+        for (size_t i = 0; i < perThread; ++i) {
+            std::string name = "f" + std::to_string(t) + "_" + std::to_string(i);
+            CHECK(vfs.write((t % 2 ? "/left/" : "/right/") + name, name));
+        }
+    }
+
+    test::parallel(kThreads, [&](size_t index) {
+        for (int round = 0; round < 40; ++round) {
+            bool fromLeft = (index + round) % 2 == 1;
+            std::string from = fromLeft ? "/left/" : "/right/";
+            std::string to = fromLeft ? "/right/" : "/left/";
+            for (size_t i = 0; i < perThread; ++i) {
+                std::string name = "f" + std::to_string(index) + "_" + std::to_string(i);
+                vfs.move(from + name, to + name);
+            }
+        }
+    });
+
+    CHECK(countFiles(vfs, "/left") + countFiles(vfs, "/right") == kThreads * perThread);
+    for (size_t t = 0; t < kThreads; ++t) {
+        std::string name = "f" + std::to_string(t) + "_0";
+        std::string content = vfs.cat("/left/" + name) + vfs.cat("/right/" + name);
+        CHECK(content == name);
+    }
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Whole directories move between parents while others copy out of them
+TEST(directoryMovesAndCopiesInterleaveSafely) {
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    for (size_t t = 0; t < kThreads; ++t) {
+        std::string dir = "/p" + std::to_string(t);
+        CHECK(vfs.mkdir(dir));
+        CHECK(vfs.mkdir(dir + "/box"));
+        CHECK(vfs.write(dir + "/box/data", std::string(1000 + t, 'd')));
+    }
+
+    std::atomic<size_t> badCopies{0};
+    test::parallel(kThreads, [&](size_t index) {
+        std::string here = "/p" + std::to_string(index);
+        std::string next = "/p" + std::to_string((index + 1) % kThreads);
+        for (int round = 0; round < 50; ++round) {
+            // Boxes travel around the ring of parents
+            vfs.move(here + "/box", next + "/box" + std::to_string(index) + "_" + std::to_string(round));
+            vfs.move(next + "/box" + std::to_string(index) + "_" + std::to_string(round), here + "/box");
+
+            std::string copy = here + "/copy" + std::to_string(round % 3);
+            vfs.remove(copy);
+            if (vfs.copy(here + "/box", copy) && vfs.cat(copy + "/data").size() != 1000 + index) {
+                badCopies++;
+            }
+        }
+    });
+
+    CHECK(badCopies.load() == 0);
+    for (size_t t = 0; t < kThreads; ++t) {
+        CHECK(vfs.cat("/p" + std::to_string(t) + "/box/data") == std::string(1000 + t, 'd'));
+    }
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// A directory can't move below itself, but it can be copied there, since
+// the copy is taken before it is linked in
+TEST(directoriesCannotMoveBelowThemselves) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(!vfs.move("/a", "/a/b/a"));
+    CHECK(!vfs.move("/a", "/a/a"));
+    CHECK(vfs.stat("/a/b").isDirectory);
+
+    CHECK(vfs.copy("/a", "/a/b/copy"));
+    CHECK(vfs.stat("/a/b/copy/b").isDirectory);
+    CHECK(!vfs.stat("/a/b/copy/b/copy").exists);
+    CHECK(vfs.verifyUsedSpace());
+}
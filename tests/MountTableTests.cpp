@@ -0,0 +1,116 @@
+#include "Test.h"
+#include "../include/MountTable.h"
+#include "../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <string>
+
+namespace {
+
+// The volume a path is routed to: the deepest mount point along it
+VirtualFileSystem* route(const MountTable& table, const std::string& text) {
+    VfsPath path(text);
+    MountTable::Cursor cursor = table.root();
+    VirtualFileSystem* volume = nullptr;
+    for (size_t i = 0; i < path.size(); ++i) {
+        cursor = path.isParentRef(i) ? table.up(cursor) : table.advance(cursor, path[i], path.hash(i));
+        if (VirtualFileSystem* here = table.volumeAt(cursor)) {
+            volume = here;
+        }
+    }
+    return volume;
+}
+
+std::string makeImage(const std::string& image, const std::string& file, const std::string& content) {
+    VirtualFileSystem source(1024 * 1024);
+    CHECK(source.write(file, content));
+    CHECK(source.saveToDisk(image));
+    return image;
+}
+
+} // namespace
+
+TEST(mountTableMatchesWholeComponents) {
+    VirtualFileSystem data;
+    VirtualFileSystem logs;
+    MountTable table;
+    CHECK(table.empty());
+    table.insert(VfsPath("/data"), &data);
+    table.insert(VfsPath("/data/logs"), &logs);
+    CHECK(!table.empty());
+
+    CHECK(route(table, "/data") == &data);
+    CHECK(route(table, "/data/file") == &data);
+    CHECK(route(table, "/data/logs/today") == &logs);
+    CHECK(route(table, "/database/file") == nullptr);
+    CHECK(route(table, "/other") == nullptr);
+}
+
+TEST(mountTableCursorClimbsBackWithParentRefs) {
+    VirtualFileSystem data;
+    MountTable table;
+    table.insert(VfsPath("/data"), &data);
+
+    MountTable::Cursor cursor = table.advance(table.root(), "data", FileNode::hashName("data"));
+    CHECK(table.volumeAt(cursor) == &data);
+    cursor = table.advance(cursor, "deep", FileNode::hashName("deep"));
+    cursor = table.advance(cursor, "deeper", FileNode::hashName("deeper"));
+    CHECK(cursor.offDepth == 2);
+    CHECK(table.volumeAt(cursor) == nullptr);
+    cursor = table.up(table.up(cursor));
+    CHECK(table.volumeAt(cursor) == &data);
+    CHECK(table.hasMountsAt(table.root()));
+}
+
+TEST(mountTableEraseKeepsOtherMounts) {
+    VirtualFileSystem outer;
+    VirtualFileSystem inner;
+    MountTable table;
+    table.insert(VfsPath("/a"), &outer);
+    table.insert(VfsPath("/a/b/c"), &inner);
+
+    table.erase(VfsPath("/a"));
+    CHECK(route(table, "/a/file") == nullptr);
+    CHECK(route(table, "/a/b/c/file") == &inner);
+    CHECK(table.hasMountsAt(table.root()));
+
+    table.erase(VfsPath("/a/b/c"));
+    CHECK(table.empty());
+    CHECK(!table.hasMountsAt(table.root()));
+    CHECK(route(table, "/a/b/c/file") == nullptr);
+}
+
+TEST(vfsRoutesPathsIntoMountedVolumes) {
+    std::string image = makeImage("mount_test.bin", "/inside", "from the image");
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/database"));
+    CHECK(vfs.write("/database/local", "local"));
+    CHECK(vfs.mountVolume(image, "/data"));
+
+    CHECK(vfs.isMountPoint("/data"));
+    CHECK(!vfs.isMountPoint("/database"));
+    CHECK(vfs.cat("/data/inside") == "from the image");
+    CHECK(vfs.cat("/database/local") == "local");
+    CHECK(vfs.write("/data/added", "added"));
+
+    // Relative paths and ".." reach into the volume, but the cwd stays local
+    CHECK(vfs.cd("/database"));
+    CHECK(vfs.cat("../data/inside") == "from the image");
+    CHECK(!vfs.cd("/data"));
+    CHECK(vfs.cd("/"));
+
+    // Nothing can be mounted on or inside a mounted volume
+    CHECK(!vfs.mountVolume(image, "/data"));
+    CHECK(!vfs.mountVolume(image, "/data/nested"));
+    CHECK(vfs.listMountedVolumes() == std::vector<std::string>{"/data"});
+
+    // Unmounting saves the volume and uncovers the local directory
+    CHECK(vfs.unmountVolume("/data"));
+    CHECK(!vfs.isMountPoint("/data"));
+    CHECK(!vfs.stat("/data/inside").exists);
+    CHECK(vfs.listMountedVolumes().empty());
+
+    VirtualFileSystem reloaded(1024 * 1024);
+    CHECK(reloaded.loadFromDisk(image));
+    CHECK(reloaded.cat("/added") == "added");
+    std::remove(image.c_str());
+}
@@ -0,0 +1,112 @@
+#include "Test.h"
+#include "../include/Epoch.h"
+#include "../include/FileNode.h"
+#include "../include/NameTable.h"
+#include "../include/NodeArena.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+NameTable::NameId acquire(NameTable& names, const std::string& name) {
+    return names.acquire(name, FileNode::hashName(name));
+}
+
+} // namespace
+
+TEST(nameTableStoresEachNameOnce) {
+    NameTable names;
+    NameTable::NameId first = acquire(names, "readme.txt");
+    NameTable::NameId second = acquire(names, "readme.txt");
+    NameTable::NameId other = acquire(names, "notes.txt");
+    CHECK(first == second);
+    CHECK(first != other);
+    CHECK(names.size() == 2);
+    CHECK(names.text(first) == "readme.txt");
+    CHECK(names.hash(first) == FileNode::hashName("readme.txt"));
+    CHECK(names.length(other) == 9);
+}
+
+TEST(nameTableDropsANameWithItsLastReference) {
+    NameTable names;
+    NameTable::NameId id = acquire(names, "shared");
+    acquire(names, "shared");
+    names.retain(id);
+
+    names.release(id);
+    names.release(id);
+    CHECK(names.size() == 1);
+    CHECK(names.text(id) == "shared");
+    names.release(id);
+    CHECK(names.size() == 0);
+
+    // The freed id is handed out again, for whatever name comes next
+    NameTable::NameId reused = acquire(names, "different");
+    CHECK(reused == id);
+    CHECK(names.text(reused) == "different");
+}
+
+TEST(nameTableSeparatesNamesWithTheSameHash) {
+    NameTable names;
+    NameTable::NameId a = names.acquire("alpha", 7);
+    NameTable::NameId b = names.acquire("beta", 7);
+    CHECK(a != b);
+    CHECK(names.acquire("alpha", 7) == a);
+    CHECK(names.text(b) == "beta");
+
+    names.release(a);
+    names.release(a);
+    CHECK(names.acquire("beta", 7) == b);
+    CHECK(names.size() == 1);
+}
+
+// Entries live in fixed chunks that are never moved, so a reference to a
+// name's text stays valid while the table grows
+TEST(nameTableTextStaysPutAcrossChunks) {
+    NameTable names;
+    NameTable::NameId first = acquire(names, "first");
+    const std::string* text = &names.text(first);
+
+    std::vector<NameTable::NameId> ids;
+    for (int i = 0; i < 10000; ++i) {
+        ids.push_back(acquire(names, "name" + std::to_string(i)));
+    }
+    CHECK(&names.text(first) == text);
+    CHECK(names.size() == 10001);
+    for (int i = 0; i < 10000; ++i) {
+        CHECK(names.text(ids[i]) == "name" + std::to_string(i));
+    }
+}
+
+TEST(nameTableConcurrentAcquireAndRelease) {
+    NameTable names;
+    test::parallel(8, [&](size_t index) {
+        for (int i = 0; i < 2000; ++i) {
+            // Half the names are shared by every thread, half are private
+            std::string name = i % 2 ? "shared" + std::to_string(i % 50)
+                                     : "t" + std::to_string(index) + "_" + std::to_string(i);
+            NameTable::NameId id = acquire(names, name);
+            if (names.text(id) != name) {
+                test::fail(__FILE__, __LINE__, "wrong text for " + name);
+            }
+            names.release(id);
+        }
+    });
+    CHECK(names.size() == 0);
+}
+
+TEST(nodesWithTheSameNameShareOneEntry) {
+    NodeArena arena;
+    {
+        std::unique_ptr<FileNode> dir(new (arena) FileNode(arena, "dir", true));
+        std::unique_ptr<FileNode> file(new (arena) FileNode(arena, "dir", false));
+        std::unique_ptr<FileNode> copy(new (arena) FileNode(arena, *file));
+        CHECK(arena.names().size() == 1);
+
+        copy->setName("renamed");
+        CHECK(arena.names().size() == 2);
+    }
+    Epoch::synchronize(&arena); // The old name of a renamed node is released late
+    CHECK(arena.names().size() == 0);
+}
@@ -0,0 +1,141 @@
+#include "Test.h"
+#include "../include/Epoch.h"
+#include "../include/FileNode.h"
+#include "../include/NodeArena.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST(nodeArenaReusesAndReleasesSlots) {
+    NodeArena arena;
+    std::vector<void*> slots;
+    for (int i = 0; i < 2000; ++i) {
+        slots.push_back(arena.allocate());
+    }
+    NodeArena::Stats full = arena.getStats();
+    CHECK(full.liveNodes == 2000);
+    CHECK(full.slabs > 1);
+    CHECK(full.bytesReserved == full.slabs * NodeArena::kSlabSize);
+
+    // A freed slot is handed out again before the arena grows
+    NodeArena::deallocate(slots.back());
+    slots.back() = arena.allocate();
+    CHECK(arena.getStats().slabs == full.slabs);
+
+    for (void* slot : slots) {
+        NodeArena::deallocate(slot);
+    }
+    NodeArena::Stats empty = arena.getStats();
+    CHECK(empty.liveNodes == 0);
+    CHECK(empty.slabs == 1); // The last slab is kept for the next node
+}
+
+TEST(nodeArenaCompactionReleasesEvacuatedSlabs) {
+    NodeArena arena;
+    std::vector<void*> slots;
+    for (int i = 0; i < 2000; ++i) {
+        slots.push_back(arena.allocate());
+    }
+    size_t slabs = arena.getStats().slabs;
+
+    // Leave every slab nearly empty
+    std::vector<void*> kept;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (i % 50 == 0) {
+            kept.push_back(slots[i]);
+        } else {
+            NodeArena::deallocate(slots[i]);
+        }
+    }
+    CHECK(arena.beginCompaction() == slabs);
+    CHECK(arena.isEvacuating(kept.front()));
+
+    // What the owner does for each live node: move it, free the old slot
+    std::vector<void*> moved;
+    for (void* slot : kept) {
+        moved.push_back(arena.allocate());
+        NodeArena::deallocate(slot);
+    }
+    CHECK(!arena.isEvacuating(moved.front()));
+    CHECK(arena.endCompaction() == slabs);
+    CHECK(arena.getStats().slabs == 1);
+    CHECK(arena.getStats().liveNodes == kept.size());
+
+    for (void* slot : moved) {
+        NodeArena::deallocate(slot);
+    }
+}
+
+// A node knows its arena from construction, not from where it lives, so
+// one on the stack works like one in a slab
+TEST(nodeOutsideAnArenaSlabUsesItsArena) {
+    NodeArena arena;
+    {
+        FileNode node(arena, "local.txt", false);
+        CHECK(node.getName() == "local.txt");
+        CHECK(arena.getAccountedBytes() == node.getFootprint());
+
+        node.setContent(std::string(1000, 'x'));
+        CHECK(node.getContent() == std::string(1000, 'x'));
+        CHECK(arena.getAccountedBytes() == node.getFootprint() + 1000);
+        CHECK(arena.getStats().liveNodes == 0);
+    }
+    CHECK(arena.getAccountedBytes() == 0);
+    CHECK(arena.names().size() == 0);
+    Epoch::synchronize(&arena);
+}
+
+TEST(nodeCopiesAreChargedToTheArenaTheyAreCopiedInto) {
+    NodeArena source;
+    NodeArena target;
+    std::unique_ptr<FileNode> dir(new (source) FileNode(source, "dir", true));
+    std::unique_ptr<FileNode> file(new (source) FileNode(source, "file", false));
+    file->setContent("payload");
+    dir->addChild(std::move(file));
+    size_t sourceBytes = source.getAccountedBytes();
+
+    std::unique_ptr<FileNode> copy(new (target) FileNode(target, *dir, "copy"));
+    CHECK(copy->getName() == "copy");
+    CHECK(copy->findChild("file")->getContent() == "payload");
+    CHECK(source.getAccountedBytes() == sourceBytes);
+    CHECK(target.getAccountedBytes() > 0);
+    CHECK(target.getStats().liveNodes == 2);
+    CHECK(target.names().size() == 2);
+
+    copy.reset();
+    CHECK(target.getAccountedBytes() == 0);
+    CHECK(target.getStats().liveNodes == 0);
+    dir.reset();
+    CHECK(source.getAccountedBytes() == 0);
+    Epoch::synchronize(&source);
+    Epoch::synchronize(&target);
+}
+
+// Destroying a subtree hands all its slots back in one batch, so the
+// arena's lock is taken a constant number of times, not once per node
+TEST(subtreesAreFreedInOneBatch) {
+    NodeArena arena;
+    std::unique_ptr<FileNode> root(new (arena) FileNode(arena, "root", true));
+    FileNode* directory = root.get();
+    for (int i = 0; i < 5000; ++i) {
+        if (i % 100 == 0) {
+            std::unique_ptr<FileNode> child(new (arena) FileNode(arena, "d" + std::to_string(i), true));
+            FileNode* next = child.get();
+            directory->addChild(std::move(child));
+            directory = next;
+        } else {
+            directory->addChild(std::unique_ptr<FileNode>(new (arena) FileNode(arena, "f" + std::to_string(i), false)));
+        }
+    }
+    NodeArena::Stats before = arena.getStats();
+    CHECK(before.liveNodes == 5001);
+    CHECK(before.slabs > 10);
+
+    root.reset();
+    Epoch::synchronize(&arena);
+    NodeArena::Stats after = arena.getStats();
+    CHECK(after.liveNodes == 0);
+    CHECK(after.slabs == 1);
+    CHECK(after.releaseLocks - before.releaseLocks <= 2); // The descendants, then the root
+    CHECK(arena.getAccountedBytes() == 0);
+}
@@ -0,0 +1,109 @@
+#include "Test.h"
+#include "../include/FileNode.h"
+#include "../include/VirtualFileSystem.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+} // namespace
+
+TEST(nodePathMatchesTheBuiltString) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/alpha"));
+    CHECK(vfs.mkdir("/alpha/beta"));
+    CHECK(vfs.write("/alpha/beta/gamma.txt", "x"));
+
+    NodePath root = vfs.resolvePath("/")->getPathHandle();
+    CHECK(root.str() == "/");
+    CHECK(root.length() == 1);
+    CHECK(root == "/" && root.compare("") == 1 && root.compare("/a") == -1);
+    CHECK(root.compare(".") == 1 && root.compare("a") == -1);
+
+    NodePath path = vfs.resolvePath("/alpha/beta/gamma.txt")->getPathHandle();
+    CHECK(path.str() == "/alpha/beta/gamma.txt");
+    CHECK(path.length() == path.str().size());
+    CHECK(vfs.resolvePath("/alpha/beta/gamma.txt")->getPath() == path.str());
+
+    std::ostringstream out;
+    out << path;
+    CHECK(out.str() == path.str());
+}
+
+// compare() orders like std::string::compare, including prefixes either way
+TEST(nodePathComparesLikeTheString) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/ab"));
+    CHECK(vfs.write("/ab/c", "x"));
+    NodePath path = vfs.resolvePath("/ab/c")->getPathHandle();
+
+    std::vector<std::string> others = {"", "/", "/ab", "/ab/", "/ab/c", "/ab/c/d", "/ab/b", "/ab/d",
+                                       "/a", "/abc", "/b", "/ab/cc", "/aa/c"};
+    for (const std::string& other : others) {
+        CHECK(sign(path.compare(other)) == sign(std::string("/ab/c").compare(other)));
+        CHECK((path == other) == (other == "/ab/c"));
+        CHECK((path < other) == (std::string("/ab/c") < other));
+        CHECK((other < path) == (other < std::string("/ab/c")));
+    }
+}
+
+// Deep paths are compared in a loop; every prefix and one-byte change of
+// the full path must order the same way as the string
+TEST(nodePathComparesDeepPaths) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    for (int i = 0; i < 500; ++i) {
+        CHECK(vfs.mkdir("d" + std::to_string(i % 10)));
+        CHECK(vfs.cd("d" + std::to_string(i % 10)));
+    }
+    std::string full = vfs.getCurrentPath();
+    NodePath path = vfs.resolvePath(full)->getPathHandle();
+    CHECK(path == full);
+
+    for (size_t at : {size_t(0), size_t(1), size_t(2), full.size() / 2, full.size() - 1}) {
+        std::string prefix = full.substr(0, at);
+        CHECK(path.compare(prefix) == 1);
+        for (char change : {'\0', '0', 'e', '~'}) {
+            std::string changed = full;
+            changed[at] = change;
+            CHECK(sign(path.compare(changed)) == sign(full.compare(changed)));
+        }
+    }
+    CHECK(path.compare(full + "/more") == -1);
+}
+
+TEST(nodePathFollowsTheNode) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/old"));
+    CHECK(vfs.write("/old/file", "x"));
+    NodePath path = vfs.resolvePath("/old/file")->getPathHandle();
+
+    CHECK(vfs.move("/old", "/new"));
+    CHECK(path == "/new/file");
+    CHECK(vfs.mkdir("/deeper"));
+    CHECK(vfs.move("/new/file", "/deeper/renamed"));
+    CHECK(path.str() == "/deeper/renamed");
+}
+
+// The cwd's path is cached and must change when an ancestor is renamed
+TEST(currentPathTracksMovesAndRemovals) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(vfs.cd("/a/b"));
+    CHECK(vfs.getCurrentPath() == "/a/b");
+
+    CHECK(vfs.move("/a", "/z"));
+    CHECK(vfs.getCurrentPath() == "/z/b");
+    CHECK(vfs.write("here", "x"));
+    CHECK(vfs.cat("/z/b/here") == "x");
+
+    CHECK(vfs.cd(".."));
+    CHECK(vfs.getCurrentPath() == "/z");
+    CHECK(vfs.remove("/z"));
+    CHECK(vfs.getCurrentPath() == "/");
+}
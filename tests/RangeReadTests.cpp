@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kExtent = FileNode::kExtentSize;
+
+std::string pattern(size_t length) {
+    std::string content(length, '\0');
+    for (size_t i = 0; i < length; ++i) {
+        content[i] = static_cast<char>('a' + (i * 11 + i / 509) % 26);
+    }
+    return content;
+}
+
+struct Range {
+    size_t offset;
+    size_t length;
+};
+
+// Ranges at and around every extent boundary, plus ones running past the end
+std::vector<Range> rangesOver(size_t size) {
+    std::vector<Range> ranges = {{0, 0}, {0, 1}, {0, size}, {0, size + 100}, {size - 1, 10}, {size, 10},
+                                 {size + 50, 10}};
+    for (size_t boundary = kExtent; boundary < size; boundary += kExtent) {
+        ranges.push_back({boundary - 1, 2});
+        ranges.push_back({boundary, kExtent});
+        ranges.push_back({boundary - 100, kExtent + 200});
+    }
+    return ranges;
+}
+
+void checkRanges(VirtualFileSystem& vfs, const std::string& path, const std::string& content) {
+    for (Range range : rangesOver(content.size())) {
+        std::string part = "stale";
+        CHECK(vfs.read(path, range.offset, range.length, part));
+        std::string expected = range.offset < content.size() ? content.substr(range.offset, range.length) : "";
+        if (part != expected) {
+            test::fail(__FILE__, __LINE__, path + ": wrong bytes at " + std::to_string(range.offset) + "+" +
+                                               std::to_string(range.length));
+        }
+    }
+}
+
+} // namespace
+
+TEST(rangeReadsOfPlainFiles) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(3 * kExtent + 123);
+    CHECK(vfs.write("/plain", content));
+    checkRanges(vfs, "/plain", content);
+}
+
+TEST(rangeReadsOfEncodedFiles) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(3 * kExtent + 123);
+
+    CHECK(vfs.write("/compressed", content));
+    CHECK(vfs.compressFile("/compressed"));
+    checkRanges(vfs, "/compressed", content);
+
+    CHECK(vfs.write("/encrypted", content));
+    CHECK(vfs.encryptFile("/encrypted", "key"));
+    checkRanges(vfs, "/encrypted", content);
+
+    CHECK(vfs.write("/both", content));
+    CHECK(vfs.compressFile("/both"));
+    CHECK(vfs.encryptFile("/both", "key"));
+    checkRanges(vfs, "/both", content);
+}
+
+// Ranges read what was last written, wherever in the file that was
+TEST(rangeReadsAfterPartialWrites) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content = pattern(2 * kExtent + 10);
+    CHECK(vfs.write("/f", content));
+    CHECK(vfs.writeAt("/f", kExtent - 3, "XXXXXX"));
+    content.replace(kExtent - 3, 6, "XXXXXX");
+    CHECK(vfs.append("/f", "tail"));
+    content += "tail";
+    checkRanges(vfs, "/f", content);
+}
+
+TEST(rangeReadsNeedAFile) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/dir"));
+    std::string part;
+    CHECK(!vfs.read("/missing", 0, 10, part));
+    CHECK(!vfs.read("/dir", 0, 10, part));
+
+    CHECK(vfs.write("/empty", ""));
+    CHECK(vfs.read("/empty", 0, 10, part) && part.empty());
+}
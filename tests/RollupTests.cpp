@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+
+namespace {
+
+// Totals must always equal a recount of the subtree
+FileNode::Totals recount(const FileNode* node) {
+    FileNode::Totals totals;
+    if (node->isDirectory()) {
+        totals.directories = 1;
+        node->forEachChild([&](FileNode* child, const std::string&, size_t) {
+            FileNode::Totals sub = recount(child);
+            totals.logicalBytes += sub.logicalBytes;
+            totals.storedBytes += sub.storedBytes;
+            totals.files += sub.files;
+            totals.directories += sub.directories;
+        });
+    } else {
+        totals.files = 1;
+        totals.logicalBytes = node->getSize();
+        totals.storedBytes = node->getStoredSize();
+    }
+    return totals;
+}
+
+bool matchesRecount(VirtualFileSystem& vfs, const std::string& path) {
+    const FileNode* node = vfs.resolvePath(path);
+    FileNode::Totals kept = node->getTotals();
+    FileNode::Totals counted = recount(node);
+    return kept.logicalBytes == counted.logicalBytes && kept.storedBytes == counted.storedBytes &&
+           kept.files == counted.files && kept.directories == counted.directories;
+}
+
+} // namespace
+
+TEST(directoryStatRollsUpItsSubtree) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(vfs.write("/a/one", std::string(100, '1')));
+    CHECK(vfs.write("/a/b/two", std::string(250, '2')));
+
+    FileStat a = vfs.stat("/a");
+    CHECK(a.isDirectory);
+    CHECK(a.size == 350);
+    CHECK(a.files == 2);
+    CHECK(a.directories == 2);
+
+    FileStat b = vfs.stat("/a/b");
+    CHECK(b.size == 250);
+    CHECK(b.files == 1);
+    CHECK(b.directories == 1);
+}
+
+TEST(rollupsFollowEveryChange) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(vfs.mkdir("/c"));
+    CHECK(vfs.write("/a/b/f", std::string(1000, 'f')));
+    CHECK(vfs.stat("/").size == 1000);
+
+    CHECK(vfs.append("/a/b/f", std::string(24, 'g')));
+    CHECK(vfs.stat("/a").size == 1024);
+    CHECK(vfs.truncate("/a/b/f", 10));
+    CHECK(vfs.stat("/a").size == 10);
+
+    CHECK(vfs.compressFile("/a/b/f"));
+    CHECK(vfs.stat("/a").storedSize == vfs.stat("/a/b/f").storedSize);
+
+    CHECK(vfs.move("/a/b", "/c/b"));
+    CHECK(vfs.stat("/a").size == 0);
+    CHECK(vfs.stat("/a").directories == 1);
+    CHECK(vfs.stat("/c").size == 10);
+    CHECK(vfs.stat("/c").directories == 2);
+
+    CHECK(vfs.copy("/c", "/a/c"));
+    CHECK(vfs.stat("/a").files == 1);
+    CHECK(vfs.stat("/").size == 20);
+
+    CHECK(vfs.remove("/c"));
+    CHECK(vfs.stat("/").size == 10);
+    CHECK(vfs.stat("/").files == 1);
+
+    for (const char* path : {"/", "/a", "/a/c", "/a/c/b"}) {
+        CHECK(matchesRecount(vfs, path));
+    }
+}
+
+TEST(rollupsStayExactUnderConcurrentWriters) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.mkdir("/shared"));
+    test::parallel(8, [&](size_t index) {
+        std::string dir = "/shared/t" + std::to_string(index);
+        vfs.mkdir(dir);
+        for (int i = 0; i < 200; ++i) {
+            std::string file = dir + "/f" + std::to_string(i % 10);
+            vfs.write(file, std::string(i, 'x'));
+            if (i % 3 == 0) {
+                vfs.remove(file);
+            }
+        }
+    });
+    CHECK(matchesRecount(vfs, "/"));
+    CHECK(matchesRecount(vfs, "/shared"));
+}
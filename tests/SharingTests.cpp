@@ -0,0 +1,91 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t kExtent = FileNode::kExtentSize;
+
+std::vector<const char*> extentData(VirtualFileSystem& vfs, const std::string& path) {
+    std::vector<const char*> data;
+    for (const ContentView& view : vfs.resolvePath(path)->getContentViews()) {
+        data.push_back(view.data());
+    }
+    return data;
+}
+
+} // namespace
+
+// A copy shares the original's payloads instead of duplicating them, and
+// the volume charges a shared payload once
+TEST(copiesShareTheirPayloads) {
+    VirtualFileSystem vfs;
+    std::string content(4 * kExtent, 'c');
+    CHECK(vfs.write("/original", content));
+    size_t before = vfs.getUsedSpace();
+
+    CHECK(vfs.copy("/original", "/copy"));
+    CHECK(extentData(vfs, "/copy") == extentData(vfs, "/original"));
+    CHECK(vfs.getUsedSpace() - before < kExtent);
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Writing to one side replaces only the extents it touches, on that side
+TEST(writesToACopyLeaveTheOriginalAlone) {
+    VirtualFileSystem vfs;
+    std::string content(3 * kExtent, 'o');
+    CHECK(vfs.write("/original", content));
+    CHECK(vfs.copy("/original", "/copy"));
+    std::vector<const char*> shared = extentData(vfs, "/original");
+
+    CHECK(vfs.writeAt("/copy", kExtent + 10, "changed"));
+    CHECK(vfs.cat("/original") == content);
+    std::vector<const char*> copy = extentData(vfs, "/copy");
+    CHECK(copy[0] == shared[0]);
+    CHECK(copy[1] != shared[1]);
+    CHECK(copy[2] == shared[2]);
+    CHECK(extentData(vfs, "/original") == shared);
+
+    CHECK(vfs.write("/original", "replaced"));
+    CHECK(vfs.cat("/copy").substr(kExtent + 10, 7) == "changed");
+    CHECK(vfs.verifyUsedSpace());
+}
+
+// Directory copies share every file's payloads, and removing either side
+// gives back only what the other no longer uses
+TEST(directoryCopiesShareAndReleasePayloads) {
+    VirtualFileSystem vfs;
+    size_t empty = vfs.getUsedSpace();
+    CHECK(vfs.mkdir("/dir"));
+    for (int i = 0; i < 10; ++i) {
+        CHECK(vfs.write("/dir/f" + std::to_string(i), std::string(kExtent, static_cast<char>('a' + i))));
+    }
+    size_t one = vfs.getUsedSpace();
+
+    CHECK(vfs.copy("/dir", "/twin"));
+    CHECK(vfs.getUsedSpace() - one < 10 * kExtent);
+    CHECK(extentData(vfs, "/twin/f3") == extentData(vfs, "/dir/f3"));
+
+    CHECK(vfs.remove("/dir"));
+    CHECK(vfs.cat("/twin/f9") == std::string(kExtent, 'j'));
+    CHECK(vfs.getUsedSpace() - empty >= 10 * kExtent);
+    CHECK(vfs.remove("/twin"));
+    CHECK(vfs.getUsedSpace() == empty);
+}
+
+// A copy takes the version history along; restoring on one side leaves
+// the other alone
+TEST(copiesKeepTheirOwnVersionHistory) {
+    VirtualFileSystem vfs;
+    CHECK(vfs.write("/f", "one"));
+    CHECK(vfs.saveFileVersion("/f"));
+    CHECK(vfs.write("/f", "two"));
+    CHECK(vfs.copy("/f", "/g"));
+    CHECK(vfs.getFileVersionCount("/g") == vfs.getFileVersionCount("/f"));
+
+    CHECK(vfs.restoreFileVersion("/g", vfs.getFileVersionCount("/g") - 1));
+    CHECK(vfs.cat("/g") == "one");
+    CHECK(vfs.cat("/f") == "two");
+    CHECK(vfs.verifyUsedSpace());
+}
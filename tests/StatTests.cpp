@@ -0,0 +1,85 @@
+#include "Test.h"
+#include "../include/VirtualFileSystem.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST(statOfAMissingPath) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.write("/f", "x"));
+    FileStat missing = vfs.stat("/missing");
+    CHECK(!missing.exists);
+    CHECK(missing.size == 0 && missing.tags.empty());
+    CHECK(!vfs.stat("/f/below").exists);
+}
+
+TEST(statOfAFileGathersEveryAttribute) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    std::string content(4000, 'c');
+    CHECK(vfs.write("/f", "first"));
+    CHECK(vfs.write("/f", content));
+    CHECK(vfs.compressFile("/f", true, "huffman"));
+    CHECK(vfs.encryptFile("/f", "key", "xor"));
+
+    FileStat stat = vfs.stat("/f");
+    CHECK(stat.exists && !stat.isDirectory);
+    CHECK(stat.size == content.size());
+    CHECK(stat.storedSize < content.size());
+    CHECK(stat.compressed && stat.compressionAlgorithm == "huffman");
+    CHECK(stat.encrypted && stat.encryptionAlgorithm == "xor");
+    CHECK(stat.versions == vfs.getFileVersionCount("/f"));
+    CHECK(stat.modified != 0);
+    CHECK(stat.files == 0 && stat.directories == 0);
+
+    CHECK(vfs.write("/plain", "abc"));
+    FileStat plain = vfs.stat("/plain");
+    CHECK(!plain.compressed && plain.compressionAlgorithm.empty());
+    CHECK(!plain.encrypted && plain.encryptionAlgorithm.empty());
+    CHECK(plain.storedSize == 3);
+}
+
+// Tagged volumes take the locked route; both must give the same answer
+TEST(statIncludesTags) {
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/d"));
+    CHECK(vfs.write("/d/f", "x"));
+    FileStat before = vfs.stat("/d/f");
+    CHECK(before.tags.empty());
+
+    CHECK(vfs.addTag("/d/f", "red"));
+    CHECK(vfs.addTag("/d/f", "blue"));
+    FileStat after = vfs.stat("/d/f");
+    std::sort(after.tags.begin(), after.tags.end());
+    CHECK((after.tags == std::vector<std::string>{"blue", "red"}));
+    CHECK(after.size == before.size && after.versions == before.versions);
+    CHECK(vfs.stat("/d").tags.empty());
+
+    // Tags follow the file when it moves
+    CHECK(vfs.move("/d", "/e"));
+    CHECK(vfs.stat("/e/f").tags.size() == 2);
+}
+
+TEST(statResolvesRelativeAndMountedPaths) {
+    std::string image = "stat_test.bin";
+    {
+        VirtualFileSystem source(1024 * 1024);
+        CHECK(source.write("/inside", "12345"));
+        CHECK(source.saveToDisk(image));
+    }
+
+    VirtualFileSystem vfs(1024 * 1024);
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(vfs.write("/a/f", "xy"));
+    CHECK(vfs.cd("/a/b"));
+    CHECK(vfs.stat("../f").size == 2);
+    CHECK(vfs.stat(".").isDirectory);
+
+    CHECK(vfs.mountVolume(image, "/mnt"));
+    FileStat inside = vfs.stat("/mnt/inside");
+    CHECK(inside.exists && inside.size == 5);
+    CHECK(vfs.stat("/mnt").isDirectory);
+    CHECK(vfs.unmountVolume("/mnt"));
+    std::remove(image.c_str());
+}
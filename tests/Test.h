@@ -0,0 +1,41 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Minimal test harness for the core library. TEST defines a case and
+// registers it with the runner in TestMain.cpp; CHECK records a failure and
+// lets the case carry on, so one run reports every broken expectation.
+//
+//     TEST(nameTableReusesIds) {
+//         NameTable names;
+//         CHECK(names.size() == 0);
+//     }
+namespace test {
+
+using Body = void (*)();
+
+bool add(const char* name, Body body);
+void fail(const char* file, int line, const std::string& what);
+
+// Runs body on threads threads at once, each passed its index; the threads
+// start together so they actually overlap
+void parallel(size_t threads, const std::function<void(size_t)>& body);
+
+} // namespace test
+
+#define TEST(name)                                               \
+    static void name();                                          \
+    static const bool name##Registered = test::add(#name, name); \
+    static void name()
+
+#define CHECK(expr)                                   \
+    do {                                              \
+        if (!(expr)) {                                \
+            test::fail(__FILE__, __LINE__, #expr);    \
+        }                                             \
+    } while (0)
+
+#endif // TEST_H
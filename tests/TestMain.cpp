@@ -0,0 +1,75 @@
+#include "Test.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Case {
+    const char* name;
+    test::Body body;
+};
+
+std::vector<Case>& cases() {
+    static std::vector<Case> registered;
+    return registered;
+}
+
+std::atomic<size_t> failures{0};
+
+} // namespace
+
+bool test::add(const char* name, Body body) {
+    cases().push_back(Case{name, body});
+    return true;
+}
+
+void test::fail(const char* file, int line, const std::string& what) {
+    failures++;
+    std::cerr << file << ":" << line << ": CHECK failed: " << what << std::endl;
+}
+
+void test::parallel(size_t threads, const std::function<void(size_t)>& body) {
+    std::atomic<size_t> ready{0};
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            ready++;
+            while (ready.load() < threads) {
+                std::this_thread::yield();
+            }
+            body(i);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Runs every case, or those whose name contains the first argument
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    size_t run = 0;
+    size_t failed = 0;
+    
+    for (const Case& testCase : cases()) {
+        if (filter && !std::strstr(testCase.name, filter)) {
+            continue;
+        }
+        
+        size_t before = failures.load();
+        testCase.body();
+        run++;
+        if (failures.load() != before) {
+            failed++;
+            std::cout << "FAIL " << testCase.name << std::endl;
+        } else {
+            std::cout << "ok   " << testCase.name << std::endl;
+        }
+    }
+    
+    std::cout << run - failed << "/" << run << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
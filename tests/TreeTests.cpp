@@ -0,0 +1,183 @@
+#include "Test.h"
+#include "../include/TreeIterator.h"
+#include "../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <functional>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Deep enough that walking it with one call frame per level overflows
+// kSmallStack
+constexpr size_t kDeep = 3000;
+constexpr size_t kSmallStack = 64 * 1024;
+
+// Runs body on a thread with a stack of only kSmallStack bytes
+void runOnSmallStack(const std::function<void()>& body) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, kSmallStack);
+    pthread_t thread;
+    auto run = [](void* argument) -> void* {
+        (*static_cast<const std::function<void()>*>(argument))();
+        return nullptr;
+    };
+    CHECK(pthread_create(&thread, &attributes, run, const_cast<std::function<void()>*>(&body)) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+}
+
+// /a/{x, b/{y}, c}, /z
+void buildSmallTree(VirtualFileSystem& vfs) {
+    CHECK(vfs.mkdir("/a"));
+    CHECK(vfs.write("/a/x", "x"));
+    CHECK(vfs.mkdir("/a/b"));
+    CHECK(vfs.write("/a/b/y", "y"));
+    CHECK(vfs.mkdir("/a/c"));
+    CHECK(vfs.write("/z", "z"));
+}
+
+std::vector<std::string> walk(TreeIterator& iterator) {
+    std::vector<std::string> visited;
+    for (; !iterator.done(); iterator.next()) {
+        visited.push_back(iterator.path());
+    }
+    return visited;
+}
+
+// A chain of kDeep directories, each also holding a file, built through
+// relative paths so it takes linear time; returns the deepest path
+std::string buildDeepTree(VirtualFileSystem& vfs) {
+    for (size_t i = 0; i < kDeep; ++i) {
+        CHECK(vfs.write("f", "level " + std::to_string(i)));
+        CHECK(vfs.mkdir("d"));
+        CHECK(vfs.cd("d"));
+    }
+    std::string deepest = vfs.getCurrentPath();
+    CHECK(vfs.cd("/"));
+    return deepest;
+}
+
+size_t countNodes(const FileNode* root) {
+    size_t count = 0;
+    for (TreeIterator walk(root); !walk.done(); walk.next()) {
+        count++;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST(treeIteratorWalksDepthFirstInChildOrder) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    buildSmallTree(vfs);
+
+    TreeIterator iterator(vfs.resolvePath("/"));
+    iterator.trackPath();
+    CHECK((walk(iterator) == std::vector<std::string>{"/", "/a", "/a/x", "/a/b", "/a/b/y", "/a/c", "/z"}));
+}
+
+TEST(treeIteratorWalksBreadthFirst) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    buildSmallTree(vfs);
+
+    TreeIterator iterator(vfs.resolvePath("/"), TreeIterator::BreadthFirst);
+    iterator.trackPath();
+    CHECK((walk(iterator) == std::vector<std::string>{"/", "/a", "/z", "/a/x", "/a/b", "/a/c", "/a/b/y"}));
+}
+
+TEST(treeIteratorPrunesAndLimits) {
+    VirtualFileSystem vfs(16 * 1024 * 1024);
+    buildSmallTree(vfs);
+
+    std::vector<std::string> visited;
+    TreeIterator pruning(vfs.resolvePath("/a"));
+    pruning.trackPath("/mnt");
+    for (; !pruning.done(); pruning.next()) {
+        visited.push_back(pruning.path());
+        if (pruning.node()->getName() == "b") {
+            pruning.prune();
+        }
+    }
+    CHECK((visited == std::vector<std::string>{"/mnt", "/mnt/x", "/mnt/b", "/mnt/c"}));
+
+    TreeIterator shallow(vfs.resolvePath("/"));
+    shallow.trackPath();
+    shallow.setMaxDepth(1);
+    CHECK((walk(shallow) == std::vector<std::string>{"/", "/a", "/z"}));
+
+    TreeIterator directories(vfs.resolvePath("/"));
+    directories.trackPath();
+    directories.setDirectoriesOnly(true);
+    CHECK((walk(directories) == std::vector<std::string>{"/", "/a", "/a/b", "/a/c"}));
+}
+
+TEST(saveAndLoadKeepTheTree) {
+    std::string image = "tree_test.bin";
+    {
+        VirtualFileSystem vfs(16 * 1024 * 1024);
+        buildSmallTree(vfs);
+        CHECK(vfs.write("/a/packed", std::string(5000, 'p')));
+        CHECK(vfs.compressFile("/a/packed"));
+        CHECK(vfs.write("/a/secret", "hidden"));
+        CHECK(vfs.encryptFile("/a/secret", "key"));
+        CHECK(vfs.cd("/a/b"));
+        CHECK(vfs.saveToDisk(image));
+    }
+
+    VirtualFileSystem loaded(16 * 1024 * 1024);
+    CHECK(loaded.loadFromDisk(image));
+    std::remove(image.c_str());
+
+    TreeIterator iterator(loaded.resolvePath("/"));
+    iterator.trackPath();
+    CHECK((walk(iterator) == std::vector<std::string>{"/", "/a", "/a/x", "/a/b", "/a/b/y", "/a/c", "/a/packed",
+                                                      "/a/secret", "/z"}));
+    CHECK(loaded.cat("/a/b/y") == "y");
+    CHECK(loaded.cat("/a/packed") == std::string(5000, 'p'));
+    CHECK(loaded.isFileCompressed("/a/packed"));
+    CHECK(loaded.cat("/a/secret") == "hidden");
+    CHECK(loaded.isFileEncrypted("/a/secret"));
+    CHECK(loaded.getCurrentPath() == "/a/b");
+    CHECK(loaded.verifyUsedSpace());
+}
+
+// Loading, compacting and repacking a deep tree keep their state on the
+// heap, so they work on a thread with a small stack
+TEST(deepTreesSurviveLoadCompactionAndRepacking) {
+    std::string image = "deep_tree_test.bin";
+    std::string deepest;
+    {
+        VirtualFileSystem vfs(256 * 1024 * 1024);
+        deepest = buildDeepTree(vfs);
+        CHECK(vfs.cd(deepest));
+        CHECK(vfs.saveToDisk(image));
+    }
+
+    VirtualFileSystem loaded(256 * 1024 * 1024);
+    runOnSmallStack([&] { CHECK(loaded.loadFromDisk(image)); });
+    std::remove(image.c_str());
+    CHECK(loaded.getCurrentPath() == deepest);
+    CHECK(countNodes(loaded.resolvePath("/")) == 2 * kDeep + 1);
+    CHECK(loaded.cat(deepest.substr(0, deepest.size() - 2) + "/f") == "level " + std::to_string(kDeep - 1));
+    CHECK(loaded.verifyUsedSpace());
+
+    // Removing every file leaves the slabs half empty, so compaction moves
+    // the directories that are left
+    CHECK(loaded.cd("/"));
+    for (size_t i = 0; i < kDeep; ++i) {
+        CHECK(loaded.remove("f"));
+        CHECK(loaded.cd("d"));
+    }
+    CHECK(loaded.cd("/"));
+    runOnSmallStack([&] { CHECK(loaded.compactNodes() > 0); });
+    CHECK(countNodes(loaded.resolvePath("/")) == kDeep + 1);
+    CHECK(loaded.resolvePath(deepest) != nullptr);
+    CHECK(loaded.write(deepest + "/last", "still reachable"));
+
+    runOnSmallStack([&] { loaded.setDeduplication(true); });
+    CHECK(loaded.cat(deepest + "/last") == "still reachable");
+    CHECK(loaded.verifyUsedSpace());
+}
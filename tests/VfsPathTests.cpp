@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "../include/FileNode.h"
+#include "../include/VfsPath.h"
+#include <memory>
+#include <string>
+
+namespace {
+
+// A path with the given number of components, each of the given length
+std::string deepPath(size_t components, size_t length) {
+    std::string path;
+    for (size_t i = 0; i < components; ++i) {
+        path += "/" + std::string(length - 1, 'a' + i % 26) + std::to_string(i % 10);
+    }
+    return path;
+}
+
+} // namespace
+
+TEST(vfsPathDropsEmptyAndDotComponents) {
+    VfsPath path("//a/./b///c/.");
+    CHECK(path.isAbsolute());
+    CHECK(path.size() == 3);
+    CHECK(path[0] == "a");
+    CHECK(path[1] == "b");
+    CHECK(path[2] == "c");
+    CHECK(path.str() == "/a/b/c");
+}
+
+TEST(vfsPathKeepsParentRefsForTheResolver) {
+    VfsPath path("a/../c");
+    CHECK(!path.isAbsolute());
+    CHECK(path.size() == 3);
+    CHECK(path.isParentRef(1));
+    CHECK(!path.isParentRef(0));
+    CHECK(path.str() == "a/../c");
+}
+
+TEST(vfsPathRootAndCurrentDirectory) {
+    VfsPath root("/");
+    CHECK(root.isAbsolute());
+    CHECK(root.size() == 0);
+    CHECK(!root.empty());
+    CHECK(root.name().empty());
+    CHECK(root.str() == "/");
+
+    CHECK(VfsPath().empty());
+    CHECK(VfsPath("").empty());
+    CHECK(VfsPath(".").empty());
+    CHECK(VfsPath(static_cast<const char*>(nullptr)).empty());
+}
+
+TEST(vfsPathHashesMatchNodeNames) {
+    VfsPath path("/docs/readme.txt");
+    CHECK(path.hash(0) == FileNode::hashName("docs"));
+    CHECK(path.hash(1) == FileNode::hashName("readme.txt"));
+}
+
+TEST(vfsPathParentSuffixAndName) {
+    VfsPath path("/a/b/c");
+    CHECK(path.name() == "c");
+    CHECK(path.parent().str() == "/a/b");
+    CHECK(path.parent().parent().parent().str() == "/");
+    CHECK(path.suffix(1).str() == "/b/c");
+    CHECK(path.suffix(1).hash(0) == FileNode::hashName("b"));
+    CHECK(path.suffix(5).str() == "/");
+    CHECK(VfsPath("x/y").suffix(1).str() == "/y");
+}
+
+// Paths too long for the inline buffers go to the heap and must behave the
+// same, whichever limit they cross
+TEST(vfsPathLongPathsBehaveLikeShortOnes) {
+    std::string manyComponents = deepPath(VfsPath::kInlineComponents + 5, 2);
+    std::string longText = deepPath(3, VfsPath::kInlineText);
+    for (const std::string& text : {manyComponents, longText}) {
+        VfsPath path(text);
+        CHECK(path.str() == text);
+        std::string rebuilt;
+        for (size_t i = 0; i < path.size(); ++i) {
+            rebuilt += "/" + std::string(path[i]);
+            CHECK(path.hash(i) == FileNode::hashName(path[i]));
+        }
+        CHECK(rebuilt == text);
+        CHECK(path.parent().str() == text.substr(0, text.rfind('/')));
+        CHECK(path.suffix(1).str() == text.substr(text.find('/', 1)));
+    }
+}
+
+TEST(vfsPathExactlyAtTheInlineLimits) {
+    std::string text = deepPath(VfsPath::kInlineComponents, 2);
+    VfsPath path(text);
+    CHECK(path.size() == VfsPath::kInlineComponents);
+    CHECK(path.str() == text);
+
+    std::string full(VfsPath::kInlineText, 'x');
+    full[0] = '/';
+    CHECK(VfsPath(full).name() == full.substr(1));
+}
+
+// Copies and derived paths own or share their text, so they stay valid
+// after the path and the string they came from are gone
+TEST(vfsPathOutlivesItsSource) {
+    for (size_t components : {size_t(3), VfsPath::kInlineComponents * 2}) {
+        std::string expected = deepPath(components, 4);
+        auto source = std::make_unique<std::string>(expected);
+        auto original = std::make_unique<VfsPath>(*source);
+        VfsPath parent = original->parent();
+        VfsPath suffix = original->suffix(1);
+        VfsPath copy = *original;
+        source.reset();
+        original.reset();
+
+        CHECK(copy.str() == expected);
+        CHECK(parent.str() == expected.substr(0, expected.rfind('/')));
+        CHECK(suffix.str() == expected.substr(expected.find('/', 1)));
+    }
+}
@@ -0,0 +1,29 @@
+#include "Bench.h"
+#include "../../include/FileWriter.h"
+#include "../../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <string>
+
+// Cost of one extent-sized append as the file grows. Content snapshots
+// share every extent chunk an append leaves alone, so the time per append
+// should stay nearly flat instead of growing with the file.
+int main() {
+    std::printf("%-12s %18s %18s\n", "file MiB", "writer us/append", "append us/append");
+    
+    std::string block(FileNode::kExtentSize, 'x');
+    for (size_t megabytes : {16, 64, 256, 1024}) {
+        size_t appends = megabytes * 1024 * 1024 / block.size();
+        VirtualFileSystem vfs(4 * megabytes * 1024 * 1024);
+        
+        auto writer = vfs.createWriter("/streamed");
+        double streamed = bench::nanosPerOp(appends, [&](size_t) { writer->write(block); });
+        writer->close();
+        vfs.remove("/streamed");
+        
+        vfs.touch("/appended");
+        double appended = bench::nanosPerOp(appends, [&](size_t) { vfs.append("/appended", block); });
+        
+        std::printf("%-12zu %18.1f %18.1f\n", megabytes, streamed / 1000, appended / 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Helpers shared by the benchmarks in this directory. Each benchmark is a
+// program of its own that prints a small table; numbers are only
+// comparable between runs on the same machine and build.
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+// Nanoseconds per call of op, averaged over iterations calls
+inline double nanosPerOp(size_t iterations, const std::function<void(size_t)>& op) {
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        op(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+// Calls of op per second, summed over threads threads that each call it
+// in a loop for duration; op gets the thread's index and a call counter
+inline double opsPerSecond(size_t threads, std::chrono::milliseconds duration,
+                           const std::function<void(size_t, size_t)>& op) {
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            size_t calls = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                op(t, calls++);
+            }
+            total += calls;
+        });
+    }
+    
+    auto start = Clock::now();
+    std::this_thread::sleep_for(duration);
+    stop = true;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return static_cast<double>(total.load()) / elapsed.count();
+}
+
+} // namespace bench
+
+#endif // BENCH_H
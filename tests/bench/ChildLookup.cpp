@@ -0,0 +1,51 @@
+#include "Bench.h"
+#include "../../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Cost of resolving one child by name as the directory grows. Up to
+// ChildIndex::kFlatLimit entries a lookup scans; past it, it probes the
+// hash slots, so the time per lookup should stay flat from there on.
+int main() {
+    std::printf("%-10s %16s %16s %16s\n", "children", "hit ns/op", "miss ns/op", "stat ns/op");
+    
+    for (size_t count : {1, 4, 16, 32, 64, 256, 1024, 16384, 131072}) {
+        VirtualFileSystem vfs(1024 * 1024 * 1024);
+        vfs.mkdir("/dir");
+        
+        std::vector<BatchOp> ops;
+        for (size_t i = 0; i < count; ++i) {
+            ops.push_back(BatchOp{BatchOp::Type::Touch, "/dir/entry" + std::to_string(i), ""});
+        }
+        vfs.applyBatch(ops);
+        
+        const FileNode* dir = vfs.resolvePath("/dir");
+        std::vector<std::string> names;
+        std::vector<std::string> paths;
+        std::vector<std::string> absent;
+        for (size_t i = 0; i < 1024; ++i) {
+            names.push_back("entry" + std::to_string(i * 7919 % count));
+            paths.push_back("/dir/" + names.back());
+            absent.push_back("absent" + std::to_string(i));
+        }
+        
+        size_t iterations = 1000000;
+        size_t found = 0;
+        double hit = bench::nanosPerOp(iterations, [&](size_t i) {
+            found += dir->findChild(names[i % names.size()]) != nullptr;
+        });
+        double miss = bench::nanosPerOp(iterations, [&](size_t i) {
+            found += dir->findChild(absent[i % absent.size()]) != nullptr;
+        });
+        double stat = bench::nanosPerOp(iterations / 10, [&](size_t i) {
+            found += vfs.stat(paths[i % paths.size()]).exists;
+        });
+        
+        std::printf("%-10zu %16.1f %16.1f %16.1f\n", count, hit, miss, stat);
+        if (found == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
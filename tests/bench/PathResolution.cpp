@@ -0,0 +1,46 @@
+#include "Bench.h"
+#include "../../include/VirtualFileSystem.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Cost of turning a path string into a VfsPath and of resolving it, by
+// depth. Short paths parse into the object itself; the deepest rows cross
+// VfsPath::kInlineComponents and show what the heap fallback costs. The
+// per-component columns should stay roughly flat as depth grows.
+int main() {
+    std::printf("%-8s %-8s %14s %14s %16s %16s\n", "depth", "storage", "parse ns", "stat ns",
+                "parse ns/comp", "stat ns/comp");
+    
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    std::string path;
+    for (size_t depth = 1; depth <= 24; ++depth) {
+        path += "/d" + std::to_string(depth);
+        if (depth == 24) {
+            vfs.touch(path);
+        } else {
+            vfs.mkdir(path);
+        }
+        if (depth != 1 && depth != 2 && depth % 4 != 0) {
+            continue;
+        }
+        
+        size_t iterations = 1000000 / depth;
+        size_t seen = 0;
+        double parse = bench::nanosPerOp(iterations, [&](size_t) {
+            VfsPath parsed(path);
+            seen += parsed.size();
+        });
+        double stat = bench::nanosPerOp(iterations, [&](size_t) {
+            seen += vfs.stat(path).exists;
+        });
+        
+        bool inlined = depth <= VfsPath::kInlineComponents && path.size() <= VfsPath::kInlineText;
+        std::printf("%-8zu %-8s %14.1f %14.1f %16.1f %16.1f\n", depth, inlined ? "inline" : "heap", parse, stat,
+                    parse / depth, stat / depth);
+        if (seen == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
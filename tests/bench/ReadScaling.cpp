@@ -0,0 +1,61 @@
+#include "Bench.h"
+#include "../../include/VirtualFileSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Lock-free reads (cat, stat, list) from a growing number of threads
+// against one volume, with and without a writer busy in another directory.
+// Reads share no written cache line, so throughput should grow with the
+// thread count up to the number of cores.
+int main() {
+    VirtualFileSystem vfs(64 * 1024 * 1024);
+    vfs.mkdir("/data");
+    vfs.mkdir("/scratch");
+    for (int i = 0; i < 256; ++i) {
+        vfs.write("/data/file" + std::to_string(i), std::string(1024, 'x'));
+    }
+    
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%u hardware threads\n", static_cast<unsigned>(cores));
+    std::printf("%-8s %-10s %14s %14s %10s\n", "threads", "writer", "reads/s", "per thread", "speedup");
+    
+    for (bool writing : {false, true}) {
+        // The writer runs beside the measured readers and isn't counted
+        std::atomic<bool> stop{false};
+        std::thread writer;
+        if (writing) {
+            writer = std::thread([&] {
+                for (size_t call = 0; !stop.load(); ++call) {
+                    vfs.write("/scratch/f" + std::to_string(call % 64), "changing");
+                }
+            });
+        }
+        
+        double single = 0;
+        for (size_t threads = 1; threads <= 2 * cores && threads <= 32; threads *= 2) {
+            double rate = bench::opsPerSecond(threads, std::chrono::milliseconds(500),
+                [&](size_t thread, size_t call) {
+                    std::string path = "/data/file" + std::to_string((call * 7 + thread) % 256);
+                    switch (call % 3) {
+                        case 0: vfs.cat(path); break;
+                        case 1: vfs.stat(path); break;
+                        default: vfs.list("/data"); break;
+                    }
+                });
+            if (threads == 1) {
+                single = rate;
+            }
+            std::printf("%-8zu %-10s %14.0f %14.0f %9.2fx\n", threads, writing ? "yes" : "no",
+                        rate, rate / threads, rate / single);
+        }
+        
+        stop = true;
+        if (writer.joinable()) {
+            writer.join();
+        }
+    }
+    return 0;
+}